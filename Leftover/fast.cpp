@@ -10,9 +10,11 @@
 #include <iomanip>
 #include <cstring>
 
+#include "../frame_pool.h"
+
 // Structure pour une image en mémoire
 struct ImageData {
-    std::vector<unsigned char> data;
+    PooledFrame data; // emprunté au pool, rendu après écriture
     std::string filename;
     size_t size;
     std::chrono::system_clock::time_point timestamp;
@@ -39,10 +41,18 @@ private:
     // Stats
     std::chrono::system_clock::time_point start_time;
     size_t total_bytes_written = 0;
+
+    // Images en RAM : pool préalloué (plus de réallocation pendant la capture)
+    FramePool pool;
+    static constexpr size_t max_image_size = 24 * 1024 * 1024; // DNG 4608x2592 + marge
     
 public:
     ContinuousCaptureSystem(const std::string& dir, int num_images, int interval_ms = 2000)
         : output_dir(dir), target_images(num_images), capture_interval_ms(interval_ms) {}
+
+    bool initPool(size_t budget_mo) {
+        return pool.init(max_image_size, budget_mo * 1024 * 1024, 16);
+    }
     
     // Thread de capture - stocke en RAM
     void captureThread() {
@@ -65,21 +75,28 @@ public:
                 continue;
             }
             
-            // Lecture dans buffer mémoire
+            // Lecture directe dans un emplacement du pool (attend si l'écriture est en retard)
             ImageData img;
+            img.data = pool.borrow();
             img.timestamp = std::chrono::system_clock::now();
             img.filename = generateFilename(images_captured);
             
             const size_t chunk_size = 65536; // 64KB chunks
-            unsigned char chunk[chunk_size];
             size_t bytes_read;
             
-            while ((bytes_read = fread(chunk, 1, chunk_size, pipe)) > 0) {
-                img.data.insert(img.data.end(), chunk, chunk + bytes_read);
+            while (img.data.size < img.data.capacity() &&
+                   (bytes_read = fread(img.data.data() + img.data.size, 1,
+                                       std::min(chunk_size, img.data.capacity() - img.data.size), pipe)) > 0) {
+                img.data.size += bytes_read;
+            }
+            if (img.data.size == img.data.capacity()) {
+                std::cerr << "[CAPTURE] Image tronquée à " << img.data.capacity() << " octets" << std::endl;
+                unsigned char drain[4096];
+                while (fread(drain, 1, sizeof(drain), pipe) > 0) {}
             }
             
             pclose(pipe);
-            img.size = img.data.size();
+            img.size = img.data.size;
             
             // Ajouter à la file d'écriture
             {
@@ -228,6 +245,8 @@ int main(int argc, char* argv[]) {
     if (argc > 1) num_images = std::atoi(argv[1]);
     if (argc > 2) interval_ms = std::atoi(argv[2]);
     if (argc > 3) output_dir = argv[3];
+    size_t pool_mo = 100; // mémoire réservée aux images en attente d'écriture
+    if (argc > 4) pool_mo = std::atoi(argv[4]);
     
     // Vérifier/créer le dossier de sortie
     std::string mkdir_cmd = "mkdir -p " + output_dir;
@@ -241,6 +260,10 @@ int main(int argc, char* argv[]) {
     
     // Lancer le système de capture continue
     ContinuousCaptureSystem capture_system(output_dir, num_images, interval_ms);
+    if (!capture_system.initPool(pool_mo)) {
+        std::cerr << "✗ Erreur: impossible de réserver le pool d'images" << std::endl;
+        return 1;
+    }
     
     try {
         capture_system.start();
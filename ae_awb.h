@@ -0,0 +1,102 @@
+// Détection de convergence AE/AWB à partir des métadonnées des requêtes terminées
+//
+// Au démarrage la caméra tourne en automatique ; on considère que l'AE et l'AWB
+// ont convergé quand l'exposition totale (temps x gain) et les gains couleur
+// restent stables (à la tolérance près) sur plusieurs images consécutives.
+// Les valeurs retenues sont ensuite verrouillées dans une ControlList construite
+// une seule fois et réutilisée pour toutes les requêtes de déclenchement.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <libcamera/libcamera.h>
+#include <libcamera/control_ids.h>
+
+struct ExposureState {
+    int32_t exposureTime = 0;  // µs
+    float analogueGain = 0.0f;
+    float redGain = 0.0f;      // ColourGains[0]
+    float blueGain = 0.0f;     // ColourGains[1]
+    float lensPosition = -1.0f; // < 0 si non rapportée
+    bool valid = false;
+};
+
+class AeAwbConvergence {
+public:
+    AeAwbConvergence(int stableFrames = 3, float tolerance = 0.03f)
+        : stableFrames_(stableFrames), tolerance_(tolerance) {}
+
+    // Ajoute les métadonnées d'une image, renvoie true dès que la convergence est atteinte
+    bool update(const libcamera::ControlList &metadata) {
+        using namespace libcamera;
+
+        ExposureState current;
+        auto exposure = metadata.get(controls::ExposureTime);
+        auto gain = metadata.get(controls::AnalogueGain);
+        if (!exposure || !gain)
+            return converged();
+        current.exposureTime = *exposure;
+        current.analogueGain = *gain;
+
+        auto colourGains = metadata.get(controls::ColourGains);
+        if (colourGains) {
+            current.redGain = (*colourGains)[0];
+            current.blueGain = (*colourGains)[1];
+        }
+        auto lens = metadata.get(controls::LensPosition);
+        if (lens)
+            current.lensPosition = *lens;
+        current.valid = true;
+
+        if (last_.valid && close(last_, current))
+            stableCount_++;
+        else
+            stableCount_ = 0;
+        last_ = current;
+        frames_++;
+        return converged();
+    }
+
+    bool converged() const { return stableCount_ >= stableFrames_; }
+    const ExposureState &state() const { return last_; }
+    int frames() const { return frames_; }
+
+private:
+    bool near(float a, float b) const {
+        return std::fabs(a - b) <= tolerance_ * std::fmax(std::fabs(a), std::fabs(b));
+    }
+
+    bool close(const ExposureState &a, const ExposureState &b) const {
+        return near(a.exposureTime * a.analogueGain, b.exposureTime * b.analogueGain) &&
+               near(a.redGain, b.redGain) && near(a.blueGain, b.blueGain);
+    }
+
+    int stableFrames_;
+    float tolerance_;
+    int stableCount_ = 0;
+    int frames_ = 0;
+    ExposureState last_;
+};
+
+// Contrôles figés appliqués à chaque déclenchement (AE/AWB désactivés)
+inline libcamera::ControlList buildLockedControls(const ExposureState &state)
+{
+    using namespace libcamera;
+
+    ControlList locked;
+    locked.set(controls::AeEnable, false);
+    locked.set(controls::AwbEnable, false);
+    locked.set(controls::ExposureTime, state.exposureTime);
+    locked.set(controls::AnalogueGain, state.analogueGain);
+    if (state.redGain > 0.0f && state.blueGain > 0.0f) {
+        const float gains[2] = { state.redGain, state.blueGain };
+        locked.set(controls::ColourGains, Span<const float, 2>(gains));
+    }
+    if (state.lensPosition >= 0.0f) {
+        locked.set(controls::AfMode, controls::AfModeManual);
+        locked.set(controls::LensPosition, state.lensPosition);
+    }
+    return locked;
+}
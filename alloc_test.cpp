@@ -0,0 +1,204 @@
+// à compiler avec:  g++ -O2 -o alloc_test alloc_test.cpp -lpthread -std=c++17 $(pkg-config --cflags --libs libcamera)
+//
+// Vérifie sans caméra que le chemin d'écriture d'une image n'alloue rien :
+//   ./alloc_test [--frames=N] [--dir=dossier]      (dossier temporaire dans /tmp par défaut)
+//
+// Des baux sans requête libcamera (FrameLender::addMemory) traversent le même code que
+// dans native.cpp (capture_path.h) : nom formaté dans le bail, complétion, file circulaire
+// et threads d'écriture de deux cibles (storage_targets.h), métriques, .raw et .info écrits
+// par writeRawFrame, une ligne dans chaque copie du CSV (session_log.h), un enregistrement
+// dans l'index binaire (session_index.h) et des messages du journal asynchrone
+// (async_log.h). operator new est remplacé pour compter les allocations de tous les
+// threads : après les images de mise en route, le compteur doit rester à 0.
+// Code de sortie non nul si une allocation ou une vérification échoue.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "async_log.h"
+#include "capture_path.h"
+#include "frame_handle.h"
+#include "session_index.h"
+#include "session_log.h"
+#include "storage_targets.h"
+
+using namespace std;
+
+static atomic<bool> counting{false};
+static atomic<uint64_t> allocations{0};
+
+// Toutes les formes de new et delete passent par ces deux fonctions, hors ligne : le
+// compilateur ne voit jamais un free() appliqué au résultat d'un new
+__attribute__((noinline)) static void *countedAlloc(size_t size)
+{
+    if (counting.load(memory_order_relaxed))
+        allocations.fetch_add(1, memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) static void countedFree(void *p) noexcept { free(p); }
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "  ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, #cond);  \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+// Format d'une petite image IMX708 (SBGGR10_CSI2P) : 5 octets pour 4 pixels
+static const unsigned WIDTH = 1536;
+static const unsigned HEIGHT = 64;
+static const unsigned STRIDE = WIDTH * 5 / 4;
+static const int BUFFERS = 4;
+static const int WARMUP = 8;
+
+static SessionLog sessionLog;
+static SessionIndex sessionIndex;
+static StorageTargets targets;
+static CapturePath capturePath(targets, sessionLog, sessionIndex);
+
+// Déclenchement et complétion d'une image : bail emprunté, nommé, confié aux cibles
+static bool capture(FrameLender &lender, int pulse)
+{
+    FrameLease *lease;
+    while (!(lease = lender.take()))
+        this_thread::sleep_for(chrono::microseconds(200));
+    lease->pulse = pulse;
+    lease->clk = pulse / 10;
+    lease->tick = static_cast<uint32_t>(pulse) * 100000u;
+    lease->ppsTick = static_cast<uint32_t>(pulse / 10) * 1000000u;
+    formatFrameName(*lease);
+    if (pulse % 16 == 0)
+        LOG_INFO("Image {} confiée aux cibles", pulse);
+    return capturePath.complete(FrameHandle(lease), lender);
+}
+
+int main(int argc, char *argv[])
+{
+    string root;
+    int frames = 200;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--dir=", 0) == 0) {
+            root = arg.substr(6);
+        } else if (arg.rfind("--frames=", 0) == 0 && atoi(arg.c_str() + 9) > 0) {
+            frames = atoi(arg.c_str() + 9);
+        } else {
+            fprintf(stderr, "Usage: %s [--frames=N] [--dir=dossier]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (root.empty()) {
+        char templ[] = "/tmp/alloc_test.XXXXXX";
+        if (!mkdtemp(templ)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        root = templ;
+    } else {
+        mkdir(root.c_str(), 0777);
+    }
+    printf("Dossier de test : %s\n", root.c_str());
+
+    RawFrameFormat &format = capturePath.format;
+    format.width = WIDTH;
+    format.height = HEIGHT;
+    format.stride = STRIDE;
+    snprintf(format.format, sizeof(format.format), "SBGGR10_CSI2P");
+
+    // Tout ce qui alloue est fait avant la capture, comme dans native.cpp
+    vector<vector<uint8_t>> buffers(BUFFERS, vector<uint8_t>(STRIDE * HEIGHT));
+    FrameLender lender;
+    for (int b = 0; b < BUFFERS; b++) {
+        for (size_t i = 0; i < buffers[b].size(); i++)
+            buffers[b][i] = static_cast<uint8_t>((i * 7 + b * 31) & 0xFF);
+        lender.addMemory(buffers[b].data(), buffers[b].size());
+    }
+
+    DurabilityPolicy policy;
+    vector<string> dirs;
+    for (const char *name : {"/cible0/", "/cible1/"}) {
+        string dir = root + name;
+        mkdir(dir.c_str(), 0777);
+        if (!targets.add(dir, policy))
+            return 1;
+        dirs.push_back(dir);
+    }
+    if (!sessionLog.open(dirs) ||
+        !sessionIndex.open(sessionLog.paths(".idx"))) {
+        fprintf(stderr, "Impossible de créer l'index de session\n");
+        return 1;
+    }
+    targets.onBarrier = [] {
+        sessionLog.flush();
+        sessionIndex.flush();
+    };
+    asyncLog().start();
+    targets.start([](const FrameHandle &frame, StorageTarget &target) { return capturePath.write(frame, target); },
+                  STRIDE * HEIGHT, lender.count());
+
+    // Mise en route : premières écritures (tampons de stdio, journaux, pages des fichiers)
+    for (int pulse = 1; pulse <= WARMUP; pulse++)
+        CHECK(capture(lender, pulse));
+    lender.waitAllReturned();
+
+    counting = true;
+    for (int pulse = WARMUP + 1; pulse <= WARMUP + frames; pulse++)
+        CHECK(capture(lender, pulse));
+    lender.waitAllReturned();
+    targets.barrier();
+    counting = false;
+
+    targets.stop();
+    asyncLog().stop();
+    std::vector<std::string> indexPaths = sessionLog.paths(".idx");
+    sessionIndex.close();
+    sessionLog.close();
+
+    uint64_t written = 0;
+    for (const auto &target : targets.targets())
+        written += target->written.load();
+    printf("%d images écrites sur %zu cibles, %llu allocations après la mise en route\n", WARMUP + frames,
+           targets.size(), static_cast<unsigned long long>(allocations.load()));
+    CHECK(written == static_cast<uint64_t>(WARMUP + frames));
+    CHECK(capturePath.framesWritten == static_cast<uint64_t>(WARMUP + frames));
+    CHECK(capturePath.writeErrors == 0);
+    CHECK(targets.lost() == 0);
+    CHECK(allocations.load() == 0);
+
+    // Un index binaire à côté de chaque copie du CSV
+    CHECK(indexPaths.size() == dirs.size());
+    for (const std::string &path : indexPaths) {
+        SessionIndexReader index;
+        CHECK(index.open(path));
+        CHECK(index.find(static_cast<uint32_t>(WARMUP + frames)) != nullptr);
+    }
+
+    if (failures) {
+        printf("%d vérifications en échec\n", failures);
+        return 1;
+    }
+    printf("Toutes les vérifications sont passées\n");
+    return 0;
+}
@@ -0,0 +1,385 @@
+// Journal console asynchrone : les threads de capture ne formatent ni n'écrivent rien
+//
+// Chaque thread qui journalise reçoit sa propre file circulaire (un producteur, un
+// consommateur, sans verrou) d'enregistrements binaires de 128 octets : format (chaîne
+// littérale), arguments copiés tels quels, horodatage. Un thread de fond fusionne les
+// files dans l'ordre des horodatages, remplace les "{}" du format par les arguments et
+// écrit par blocs (stdout pour debug/info, stderr pour warn/error).
+//   - niveau minimal réglable (setLevel) ;
+//   - limitation de débit par point d'appel (LOG_* : au plus LOG_RATE_BURST messages
+//     par seconde, le nombre de messages supprimés est ajouté au suivant) ;
+//   - file pleine : le message est perdu et compté (dropped()), jamais d'attente.
+// Avant start(), et après stop(), les messages sont écrits directement (démarrage, usage).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include <unistd.h>
+
+#include "text_buffer.h"
+
+enum class LogLevel : uint8_t { Debug, Info, Warn, Error };
+
+static const int LOG_MAX_ARGS = 6;
+static const int LOG_TEXT_SIZE = 40;   // chaînes copiées dans l'enregistrement
+static const int LOG_RING_SIZE = 256;  // enregistrements par thread (puissance de 2)
+static const int LOG_MAX_THREADS = 8;
+static const uint32_t LOG_RATE_BURST = 10;
+
+inline bool parseLogLevel(const std::string &name, LogLevel &level)
+{
+    if (name == "debug")
+        level = LogLevel::Debug;
+    else if (name == "info")
+        level = LogLevel::Info;
+    else if (name == "warn")
+        level = LogLevel::Warn;
+    else if (name == "error")
+        level = LogLevel::Error;
+    else
+        return false;
+    return true;
+}
+
+struct LogRecord {
+    uint64_t time;            // ns depuis le démarrage du journal
+    const char *format;       // littéral : seul le pointeur est copié
+    uint32_t suppressed;      // messages supprimés au même point d'appel juste avant
+    LogLevel level;
+    uint8_t argc;
+    uint8_t types[LOG_MAX_ARGS];
+    union Value {
+        int64_t i;
+        uint64_t u;
+        double f;
+        struct { uint16_t offset, length; } text;
+    } values[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE];
+    uint8_t textUsed;
+};
+static_assert(sizeof(LogRecord) == 128, "enregistrement de journal de taille fixe");
+
+// File d'un thread : le producteur n'écrit que head_, le consommateur que tail_
+struct alignas(64) LogRing {
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    uint64_t droppedReported = 0; // côté consommateur
+    LogRecord records[LOG_RING_SIZE];
+};
+
+// Limitation de débit d'un point d'appel (une instance statique par LOG_*)
+class LogRate {
+public:
+    bool allow(uint64_t now, uint32_t &suppressed) {
+        uint64_t second = now / 1000000000ull;
+        uint64_t current = window_.load(std::memory_order_relaxed);
+        if (current != second && window_.compare_exchange_strong(current, second, std::memory_order_relaxed))
+            count_.store(0, std::memory_order_relaxed);
+        if (count_.fetch_add(1, std::memory_order_relaxed) < LOG_RATE_BURST) {
+            suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+private:
+    std::atomic<uint64_t> window_{~0ull};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+class AsyncLog {
+public:
+    enum ArgType : uint8_t { Int, UInt, Float, Text };
+
+    AsyncLog() : origin_(std::chrono::steady_clock::now()) {}
+    ~AsyncLog() { stop(); }
+
+    // Toute la mémoire des files est allouée ici, jamais en journalisant
+    void start(int pollMs = 10) {
+        if (running_.load())
+            return;
+        if (!rings_)
+            rings_.reset(new LogRing[LOG_MAX_THREADS]);
+        pollMs_ = pollMs;
+        stop_ = false;
+        running_ = true;
+        thread_ = std::thread([this] { run(); });
+    }
+
+    // Vide les files puis repasse en écriture directe
+    void stop() {
+        if (!running_.load())
+            return;
+        stop_ = true;
+        if (thread_.joinable())
+            thread_.join();
+        running_ = false;
+        flush();
+    }
+
+    // Écrit tout ce qui est en attente (avant un affichage synchrone, en fin de session)
+    void flush() {
+        std::lock_guard<std::mutex> lock(drainMtx_);
+        drainLocked();
+    }
+
+    void setLevel(LogLevel level) { level_ = level; }
+    bool enabled(LogLevel level) const { return level >= level_.load(std::memory_order_relaxed); }
+
+    // Messages perdus faute de place dans une file (ou de file libre pour le thread)
+    uint64_t dropped() const {
+        uint64_t total = unregistered_.load();
+        if (rings_)
+            for (int i = 0; i < LOG_MAX_THREADS; i++)
+                total += rings_[i].dropped.load();
+        return total;
+    }
+
+    // Appelé au démarrage du thread de fond (cœurs, priorité : thread_profile.h)
+    std::function<void()> threadInit;
+
+    uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin_).count();
+    }
+
+    template <typename... Args>
+    void log(LogLevel level, LogRate *rate, const char *format, const Args &...args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "trop d'arguments de journal");
+        if (!enabled(level))
+            return;
+        uint64_t t = now();
+        uint32_t suppressed = 0;
+        if (rate && !rate->allow(t, suppressed))
+            return;
+
+        if (!running_.load(std::memory_order_acquire)) {
+            LogRecord rec;
+            fill(rec, t, level, suppressed, format, args...);
+            writeDirect(rec);
+            return;
+        }
+        LogRing *ring = threadRing();
+        if (!ring) {
+            unregistered_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        uint32_t head = ring->head.load(std::memory_order_relaxed);
+        if (head - ring->tail.load(std::memory_order_acquire) >= LOG_RING_SIZE) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        fill(ring->records[head % LOG_RING_SIZE], t, level, suppressed, format, args...);
+        ring->head.store(head + 1, std::memory_order_release);
+    }
+
+private:
+    // Attribution d'une file au premier message du thread (sans allocation)
+    LogRing *threadRing() {
+        static thread_local int slot = -1;
+        if (slot < 0) {
+            int claimed = registered_.fetch_add(1, std::memory_order_relaxed);
+            if (claimed >= LOG_MAX_THREADS)
+                return nullptr;
+            slot = claimed;
+        }
+        return &rings_[slot];
+    }
+
+    template <typename... Args>
+    static void fill(LogRecord &rec, uint64_t t, LogLevel level, uint32_t suppressed, const char *format,
+                     const Args &...args) {
+        rec.time = t;
+        rec.format = format;
+        rec.suppressed = suppressed;
+        rec.level = level;
+        rec.argc = 0;
+        rec.textUsed = 0;
+        (put(rec, args), ...);
+    }
+
+    template <typename T>
+    static void put(LogRecord &rec, T v) {
+        static_assert(std::is_arithmetic<T>::value, "argument de journal non pris en charge");
+        LogRecord::Value &value = rec.values[rec.argc];
+        if constexpr (std::is_floating_point<T>::value) {
+            rec.types[rec.argc] = Float;
+            value.f = static_cast<double>(v);
+        } else if constexpr (std::is_signed<T>::value) {
+            rec.types[rec.argc] = Int;
+            value.i = static_cast<int64_t>(v);
+        } else {
+            rec.types[rec.argc] = UInt;
+            value.u = static_cast<uint64_t>(v);
+        }
+        rec.argc++;
+    }
+
+    // Chaînes : copiées (tronquées) dans l'enregistrement, l'appelant peut les libérer
+    static void put(LogRecord &rec, const char *s) {
+        size_t n = std::min<size_t>(strlen(s), LOG_TEXT_SIZE - rec.textUsed);
+        memcpy(rec.text + rec.textUsed, s, n);
+        rec.types[rec.argc] = Text;
+        rec.values[rec.argc].text = {rec.textUsed, static_cast<uint16_t>(n)};
+        rec.textUsed = static_cast<uint8_t>(rec.textUsed + n);
+        rec.argc++;
+    }
+    static void put(LogRecord &rec, char *s) { put(rec, static_cast<const char *>(s)); }
+    static void put(LogRecord &rec, bool b) { put(rec, b ? "oui" : "non"); }
+
+    static void format(TextBuffer &out, const LogRecord &rec) {
+        char stamp[24];
+        int n = snprintf(stamp, sizeof(stamp), "[%10.3f] ", rec.time / 1e9);
+        out.add(stamp, n > 0 ? static_cast<size_t>(n) : 0);
+        int arg = 0;
+        for (const char *p = rec.format; *p; p++) {
+            if (p[0] == '{' && p[1] == '}' && arg < rec.argc) {
+                const LogRecord::Value &v = rec.values[arg];
+                switch (rec.types[arg]) {
+                case Int: out.addInt(v.i); break;
+                case UInt: out.addUInt(v.u); break;
+                case Float: out.addFloat(v.f); break;
+                case Text: out.add(rec.text + v.text.offset, v.text.length); break;
+                }
+                arg++;
+                p++;
+            } else {
+                out.add(*p);
+            }
+        }
+        if (rec.suppressed)
+            out.add(" (").addUInt(rec.suppressed).add(" messages semblables supprimés)");
+        out.add('\n');
+    }
+
+    static int fdFor(LogLevel level) { return level >= LogLevel::Warn ? STDERR_FILENO : STDOUT_FILENO; }
+
+    static void writeOut(int fd, const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t n = ::write(fd, data, size);
+            if (n <= 0)
+                return;
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+    }
+
+    static void writeDirect(const LogRecord &rec) {
+        FixedText<512> line;
+        format(line, rec);
+        writeOut(fdFor(rec.level), line.c_str(), line.size());
+    }
+
+    void run() {
+        if (threadInit)
+            threadInit();
+        while (!stop_.load()) {
+            flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(pollMs_));
+        }
+    }
+
+    // Fusion des files par horodatage ; sorties regroupées par descripteur
+    void drainLocked() {
+        if (!rings_)
+            return;
+        int count = std::min(registered_.load(), LOG_MAX_THREADS);
+        uint32_t ends[LOG_MAX_THREADS];
+        for (int i = 0; i < count; i++)
+            ends[i] = rings_[i].head.load(std::memory_order_acquire);
+
+        while (true) {
+            LogRing *next = nullptr;
+            for (int i = 0; i < count; i++) {
+                LogRing &r = rings_[i];
+                uint32_t tail = r.tail.load(std::memory_order_relaxed);
+                if (tail != ends[i] &&
+                    (!next || r.records[tail % LOG_RING_SIZE].time <
+                                  next->records[next->tail.load(std::memory_order_relaxed) % LOG_RING_SIZE].time))
+                    next = &r;
+            }
+            if (!next)
+                break;
+            uint32_t tail = next->tail.load(std::memory_order_relaxed);
+            const LogRecord &rec = next->records[tail % LOG_RING_SIZE];
+            int fd = fdFor(rec.level);
+            if (fd != pendingFd_)
+                flushPending();
+            pendingFd_ = fd;
+            if (pending_.size() + 512 > sizeof(pendingStorage_))
+                flushPending();
+            format(pending_, rec);
+            next->tail.store(tail + 1, std::memory_order_release);
+        }
+
+        uint64_t unregistered = unregistered_.load();
+        uint64_t lost = unregistered - unregisteredReported_;
+        unregisteredReported_ = unregistered;
+        for (int i = 0; i < count; i++) {
+            uint64_t d = rings_[i].dropped.load();
+            lost += d - rings_[i].droppedReported;
+            rings_[i].droppedReported = d;
+        }
+        if (lost > 0) {
+            flushPending();
+            FixedText<96> line;
+            line.add("[journal] ").addUInt(lost).add(" messages perdus (file pleine)\n");
+            writeOut(STDERR_FILENO, line.c_str(), line.size());
+        }
+        flushPending();
+    }
+
+    void flushPending() {
+        if (pending_.size() > 0)
+            writeOut(pendingFd_, pending_.c_str(), pending_.size());
+        pending_.clear();
+    }
+
+    std::chrono::steady_clock::time_point origin_;
+    std::unique_ptr<LogRing[]> rings_;
+    std::atomic<int> registered_{0};
+    std::atomic<uint64_t> unregistered_{0};
+    uint64_t unregisteredReported_ = 0;
+    std::atomic<LogLevel> level_{LogLevel::Info};
+
+    std::mutex drainMtx_;
+    char pendingStorage_[16384];
+    TextBuffer pending_{pendingStorage_, sizeof(pendingStorage_)};
+    int pendingFd_ = STDOUT_FILENO;
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> stop_{false};
+    int pollMs_ = 10;
+    std::thread thread_;
+};
+
+// Journal du programme de capture
+inline AsyncLog &asyncLog()
+{
+    static AsyncLog log;
+    return log;
+}
+
+#define ASYNC_LOG_AT(level, ...)                                  \
+    do {                                                          \
+        static LogRate logRate_;                                  \
+        asyncLog().log(level, &logRate_, __VA_ARGS__);            \
+    } while (0)
+
+#define LOG_DEBUG(...) ASYNC_LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) ASYNC_LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARN(...) ASYNC_LOG_AT(LogLevel::Warn, __VA_ARGS__)
+#define LOG_ERROR(...) ASYNC_LOG_AT(LogLevel::Error, __VA_ARGS__)
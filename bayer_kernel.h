@@ -0,0 +1,127 @@
+// Noyau fusionné de conversion CSI2P -> RGB 16-bit, en une seule passe par paire de lignes
+//
+// Dépaquetage 10-bit, soustraction du noir, gain saturé, dématriçage plus proche voisin
+// (comme demosaicPair de nat_convert) et statistiques sont faits sur les mêmes octets, encore
+// en cache : l'image est lue une fois depuis le mapping et écrite une fois dans la bande de
+// sortie. Noir, gain et passage en 16 bits sont réunis dans une table de 1024 entrées (2 Ko).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "raw_reader.h"
+
+struct FusedParams {
+    BayerLayout layout;
+    uint16_t lut[1024]; // valeur 10-bit -> sortie 16-bit
+};
+
+// Sans noir et avec un gain de 1, la sortie est exactement la valeur << 6 (comme convert.py)
+inline void buildFusedParams(FusedParams &p, const std::string &pattern, unsigned black, float gain)
+{
+    p.layout = bayerLayout(pattern);
+    for (unsigned v = 0; v < 1024; v++) {
+        unsigned base = v > black ? v - black : 0;
+        p.lut[v] = static_cast<uint16_t>(std::min(static_cast<float>(base << 6) * gain, 65535.0f));
+    }
+}
+
+// Statistiques des valeurs 10-bit brutes (avant noir et gain)
+struct RawStats {
+    unsigned min = 1023;
+    unsigned max = 0;
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    uint64_t clipped = 0; // pixels à 1023
+
+    void merge(const RawStats &o) {
+        min = std::min(min, o.min);
+        max = std::max(max, o.max);
+        sum += o.sum;
+        count += o.count;
+        clipped += o.clipped;
+    }
+
+    double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+};
+
+// Un quad Bayer 2x2 (valeurs 10-bit q[ligne][colonne]) vers 2 x 2 pixels RGB
+inline void fusedQuad(const uint16_t q[2][2], const FusedParams &p, uint16_t *outTop, uint16_t *outBottom)
+{
+    const BayerLayout &l = p.layout;
+    uint16_t r = p.lut[q[l.r[0]][l.r[1]]];
+    uint16_t b = p.lut[q[l.b[0]][l.b[1]]];
+    uint16_t g1 = p.lut[q[l.g1[0]][l.g1[1]]];
+    uint16_t g2 = p.lut[q[l.g2[0]][l.g2[1]]];
+    uint16_t g = static_cast<uint16_t>((static_cast<uint32_t>(g1) + g2) / 2);
+    uint16_t *outs[2] = {outTop, outBottom};
+    for (int dy = 0; dy < 2; dy++) {
+        for (int dx = 0; dx < 2; dx++) {
+            uint16_t *o = outs[dy] + dx * 3;
+            o[0] = r;
+            o[1] = dy == l.g1[0] && dx == l.g1[1] ? g1 : dy == l.g2[0] && dx == l.g2[1] ? g2 : g;
+            o[2] = b;
+        }
+    }
+}
+
+// Paire de lignes CSI2P (top, bottom) vers deux lignes RGB 16-bit de width pixels
+inline void fusedCsi2pPair(const uint8_t *top, const uint8_t *bottom, unsigned width, const FusedParams &p,
+                           uint16_t *outTop, uint16_t *outBottom, RawStats &stats)
+{
+    const uint8_t *src[2] = {top, bottom};
+    unsigned mn = stats.min, mx = stats.max;
+    uint64_t sum = 0, clipped = 0;
+
+    // 4 pixels (5 octets) de chaque ligne = 2 quads
+    unsigned groups = width / 4;
+    uint16_t v[2][4];
+    for (unsigned g = 0; g < groups; g++) {
+        for (int r = 0; r < 2; r++) {
+            const uint8_t *s = src[r] + g * 5;
+            uint8_t low = s[4];
+            for (int k = 0; k < 4; k++) {
+                uint16_t x = static_cast<uint16_t>(s[k] << 2 | ((low >> (2 * k)) & 0x3));
+                v[r][k] = x;
+                sum += x;
+                mn = std::min<unsigned>(mn, x);
+                mx = std::max<unsigned>(mx, x);
+                clipped += x == 1023;
+            }
+        }
+        for (int h = 0; h < 2; h++) {
+            uint16_t q[2][2] = {{v[0][h * 2], v[0][h * 2 + 1]}, {v[1][h * 2], v[1][h * 2 + 1]}};
+            size_t x = (static_cast<size_t>(g) * 4 + h * 2) * 3;
+            fusedQuad(q, p, outTop + x, outBottom + x);
+        }
+    }
+
+    // Fin de ligne (largeur non multiple de 4) : une colonne impaire reste sans quad
+    unsigned rest = width % 4;
+    if (rest) {
+        for (int r = 0; r < 2; r++) {
+            const uint8_t *s = src[r] + groups * 5;
+            for (unsigned k = 0; k < rest; k++) {
+                uint16_t x = static_cast<uint16_t>(s[k] << 2 | ((s[4] >> (2 * k)) & 0x3));
+                v[r][k] = x;
+                sum += x;
+                mn = std::min<unsigned>(mn, x);
+                mx = std::max<unsigned>(mx, x);
+                clipped += x == 1023;
+            }
+        }
+        for (unsigned h = 0; h * 2 + 1 < rest; h++) {
+            uint16_t q[2][2] = {{v[0][h * 2], v[0][h * 2 + 1]}, {v[1][h * 2], v[1][h * 2 + 1]}};
+            size_t x = (static_cast<size_t>(groups) * 4 + h * 2) * 3;
+            fusedQuad(q, p, outTop + x, outBottom + x);
+        }
+    }
+
+    stats.min = mn;
+    stats.max = mx;
+    stats.sum += sum;
+    stats.count += static_cast<uint64_t>(width) * 2;
+    stats.clipped += clipped;
+}
@@ -0,0 +1,99 @@
+// Sauvegarde de la dernière calibration exposition / balance des blancs
+//
+// En fin de session, les valeurs figées (exposition, gain, gains couleur, position
+// de l'objectif) sont écrites dans un petit fichier texte "clé=valeur" (même format
+// que les .info). Au démarrage suivant, elles servent de point de départ : une seule
+// image de contrôle suffit si sa luminosité moyenne est plausible, sinon on repasse
+// par la convergence AE/AWB complète.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <string>
+
+#include "ae_awb.h"
+
+inline bool loadCalibration(const std::string &path, ExposureState &state)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    ExposureState loaded;
+    std::string line;
+    try {
+        while (std::getline(in, line)) {
+            size_t eq = line.find('=');
+            if (eq == std::string::npos)
+                continue;
+            std::string key = line.substr(0, eq);
+            std::string value = line.substr(eq + 1);
+            if (key == "exposure_us")
+                loaded.exposureTime = std::stoi(value);
+            else if (key == "analogue_gain")
+                loaded.analogueGain = std::stof(value);
+            else if (key == "red_gain")
+                loaded.redGain = std::stof(value);
+            else if (key == "blue_gain")
+                loaded.blueGain = std::stof(value);
+            else if (key == "lens_position")
+                loaded.lensPosition = std::stof(value);
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    if (loaded.exposureTime <= 0 || loaded.analogueGain <= 0.0f)
+        return false;
+    loaded.valid = true;
+    state = loaded;
+    return true;
+}
+
+inline bool saveCalibration(const std::string &path, const ExposureState &state)
+{
+    // Écriture dans un fichier temporaire puis rename : jamais de fichier à moitié écrit
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out)
+            return false;
+        out << "exposure_us=" << state.exposureTime << "\n";
+        out << "analogue_gain=" << state.analogueGain << "\n";
+        out << "red_gain=" << state.redGain << "\n";
+        out << "blue_gain=" << state.blueGain << "\n";
+        out << "lens_position=" << state.lensPosition << "\n";
+        if (!out)
+            return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// Luminosité moyenne (sur 8 bits) d'une image RAW 10-bit CSI2P, sur une grille sous-échantillonnée.
+// Seuls les octets de poids fort sont lus (les 4 premiers de chaque groupe de 5).
+inline double meanLevelCsi2p(const uint8_t *data, unsigned width, unsigned height, unsigned stride,
+                             unsigned step = 16)
+{
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    unsigned groups = width / 4;
+    for (unsigned y = 0; y < height; y += step) {
+        const uint8_t *row = data + static_cast<size_t>(y) * stride;
+        for (unsigned g = 0; g < groups; g += step / 4) {
+            const uint8_t *p = row + g * 5;
+            sum += p[0] + p[1] + p[2] + p[3];
+            count += 4;
+        }
+    }
+    return count ? static_cast<double>(sum) / count : 0.0;
+}
+
+// Une image de contrôle est acceptée si elle n'est ni noire ni saturée
+inline bool plausibleLevel(double mean)
+{
+    return mean >= 20.0 && mean <= 200.0;
+}
@@ -0,0 +1,160 @@
+// Session libcamera persistante : caméra acquise, configurée, buffers alloués et
+// mappés une seule fois, une requête par buffer.
+//
+// Partagée par native.cpp et main.cpp : les photos sont prises en mettant en file
+// une requête libre du prêteur (FrameLender), sans relancer de processus ni
+// reconfigurer le capteur à chaque impulsion.
+
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <libcamera/libcamera.h>
+
+#include "frame_handle.h"
+
+class CameraSession {
+public:
+    ~CameraSession() { close(); }
+
+    // Acquiert la première caméra et la configure en RAW width x height
+    bool open(unsigned width, unsigned height, const libcamera::PixelFormat &format,
+              unsigned bufferCount,
+              libcamera::StreamRole role = libcamera::StreamRole::StillCapture) {
+        using namespace libcamera;
+
+        cm_ = std::make_unique<CameraManager>();
+        if (cm_->start()) {
+            std::cerr << "Échec du démarrage du CameraManager" << std::endl;
+            cm_.reset();
+            return false;
+        }
+
+        auto cameras = cm_->cameras();
+        if (cameras.empty()) {
+            std::cout << "Aucune caméra détectée." << std::endl;
+            close();
+            return false;
+        }
+
+        camera_ = cm_->get(cameras[0]->id());
+        if (!camera_ || camera_->acquire()) {
+            std::cerr << "Échec de l'acquisition de la caméra" << std::endl;
+            camera_.reset();
+            close();
+            return false;
+        }
+        acquired_ = true;
+
+        config_ = camera_->generateConfiguration({ role });
+        if (!config_) {
+            std::cerr << "Échec de génération de la configuration" << std::endl;
+            close();
+            return false;
+        }
+
+        StreamConfiguration &streamConfig = config_->at(0);
+        streamConfig.size.width = width;
+        streamConfig.size.height = height;
+        streamConfig.pixelFormat = format;
+        // Plusieurs buffers pour qu'une photo puisse être prise pendant l'écriture de la précédente
+        streamConfig.bufferCount = bufferCount;
+
+        config_->validate();
+        std::cout << "Configuration validée: " << streamConfig.toString() << std::endl;
+
+        if (camera_->configure(config_.get())) {
+            std::cerr << "Échec de configuration de la caméra" << std::endl;
+            close();
+            return false;
+        }
+
+        stream_ = streamConfig.stream();
+        allocator_ = std::make_unique<FrameBufferAllocator>(camera_);
+        if (allocator_->allocate(stream_) < 0) {
+            std::cerr << "Impossible d'allouer les buffers" << std::endl;
+            close();
+            return false;
+        }
+
+        // Une requête par buffer, créées une seule fois ; chaque buffer est mappé une seule fois
+        for (const std::unique_ptr<FrameBuffer> &buffer : allocator_->buffers(stream_)) {
+            std::unique_ptr<Request> request = camera_->createRequest();
+            if (!request || request->addBuffer(stream_, buffer.get()) < 0 ||
+                !lender.add(request.get(), buffer.get())) {
+                std::cerr << "Erreur: Problème lors de la création de la requête." << std::endl;
+                close();
+                return false;
+            }
+            requests_.push_back(std::move(request));
+        }
+        return true;
+    }
+
+    // Démarre le flux ; onComplete est appelé dans le thread libcamera
+    bool start(std::function<void(libcamera::Request *)> onComplete) {
+        onComplete_ = std::move(onComplete);
+        camera_->requestCompleted.connect(this, &CameraSession::requestComplete);
+        connected_ = true;
+        if (camera_->start()) {
+            std::cerr << "Échec du démarrage de la caméra" << std::endl;
+            return false;
+        }
+        started_ = true;
+        return true;
+    }
+
+    // Arrête le flux : les requêtes en vol reviennent annulées
+    void stop() {
+        if (started_) {
+            camera_->stop();
+            started_ = false;
+        }
+    }
+
+    void close() {
+        stop();
+        if (connected_) {
+            camera_->requestCompleted.disconnect(this);
+            connected_ = false;
+        }
+        requests_.clear();
+        allocator_.reset();
+        config_.reset();
+        if (camera_) {
+            if (acquired_)
+                camera_->release();
+            acquired_ = false;
+            camera_.reset();
+        }
+        if (cm_) {
+            cm_->stop();
+            cm_.reset();
+        }
+    }
+
+    libcamera::Camera *camera() const { return camera_.get(); }
+    libcamera::StreamConfiguration &streamConfig() const { return config_->at(0); }
+
+    FrameLender lender;
+
+private:
+    void requestComplete(libcamera::Request *request) {
+        if (onComplete_)
+            onComplete_(request);
+    }
+
+    std::unique_ptr<libcamera::CameraManager> cm_;
+    std::shared_ptr<libcamera::Camera> camera_;
+    std::unique_ptr<libcamera::CameraConfiguration> config_;
+    std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
+    std::vector<std::unique_ptr<libcamera::Request>> requests_;
+    libcamera::Stream *stream_ = nullptr;
+    std::function<void(libcamera::Request *)> onComplete_;
+    bool acquired_ = false;
+    bool connected_ = false;
+    bool started_ = false;
+};
@@ -0,0 +1,204 @@
+// Chemin d'une image de la complétion de sa requête jusqu'au support
+//
+// Côté complétion : relais dans le pool quand toutes les requêtes caméra sont prêtées,
+// aperçu, puis répartition entre les cibles. Côté thread d'écriture : métriques, .raw et
+// .info, ligne du CSV de session et enregistrement de l'index binaire. Le même code sert à
+// native.cpp et à alloc_test.cpp, qui vérifie sans caméra qu'il n'alloue rien.
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+
+#include "async_log.h"
+#include "frame_handle.h"
+#include "frame_metrics.h"
+#include "preview.h"
+#include "raw_writer.h"
+#include "session_index.h"
+#include "session_log.h"
+#include "storage_targets.h"
+#include "text_buffer.h"
+
+// Le nom reprend l'impulsion, la clock externe et le tick relevés au déclenchement :
+// photo_PPPP_CCCC_TTTTTTTTTTTT, formaté une fois dans le bail (sans extension)
+inline void formatFrameName(FrameLease &frame)
+{
+    TextBuffer name(frame.name, sizeof(frame.name));
+    name.add("photo_").addInt(frame.pulse, 4).add('_').addInt(frame.clk, 4).add('_').addUInt(frame.tick, 12);
+}
+
+// Horodatage de l'image dans son .info
+inline void appendFrameInfo(TextBuffer &info, const FrameLease &lease)
+{
+    info.line("pulse", lease.pulse);
+    info.line("clk", lease.clk);
+    info.line("tick", lease.tick);
+    info.line("pps_tick", lease.ppsTick);
+    if (lease.holdover)
+        info.line("holdover", 1);
+    info.line("time_error_us", lease.timeErrorUs);
+    info.line("sequence", lease.sequence);
+    info.line("sensor_timestamp", static_cast<unsigned long long>(lease.sensorTimestamp));
+}
+
+class CapturePath {
+public:
+    static constexpr int REVOKED_SLOTS = 16;
+
+    CapturePath(StorageTargets &targets, SessionLog &log, SessionIndex &index)
+        : targets_(targets), log_(log), index_(index) {}
+
+    // Réglages, fixés avant le démarrage des threads d'écriture
+    RawFrameFormat format;                        // géométrie du buffer, relevée après configuration
+    unsigned metricsBudgetUs = 2000;              // budget CPU des métriques par image, 0 = désactivées
+    FrameLender *staging = nullptr;               // relais du pool (--pool-mo), nullptr = aucun
+    PreviewStage *preview = nullptr;              // aperçus (--preview), nullptr = aucun
+    std::function<void(TextBuffer &)> appendInfo; // lignes ajoutées au .info (exposition figée)
+
+    // Compteurs de la session en cours
+    std::atomic<uint64_t> framesWritten{0};
+    std::atomic<uint64_t> writeErrors{0};
+    std::atomic<uint64_t> bytesWritten{0};
+    std::atomic<uint64_t> framesFlagged{0};
+    std::atomic<uint64_t> metricsSkipped{0};
+    std::atomic<uint64_t> framesStaged{0};
+    std::atomic<double> sharpnessRef{0.0}; // netteté habituelle de la session
+
+    void resetStats() {
+        framesWritten = 0;
+        writeErrors = 0;
+        bytesWritten = 0;
+        framesFlagged = 0;
+        metricsSkipped = 0;
+        framesStaged = 0;
+        sharpnessRef = 0.0;
+        for (auto &pulse : revoked_)
+            pulse = 0;
+    }
+
+    // Impulsion révoquée par le filtre alors que sa photo était déjà partie (thread des
+    // fronts) : son image sera marquée revoked=1 dans le .info et ENTRY_REVOKED dans l'index.
+    // Les dernières REVOKED_SLOTS sont gardées, bien plus que les images en vol
+    void revokeLate(int pulse) {
+        revoked_[revokedNext_.fetch_add(1, std::memory_order_relaxed) % REVOKED_SLOTS].store(pulse);
+    }
+
+    bool revokedLate(int pulse) const {
+        for (const auto &slot : revoked_)
+            if (slot.load() == pulse)
+                return true;
+        return false;
+    }
+
+    // Complétion : pas d'écriture ici, l'image est prêtée aux threads d'écriture. `camera`
+    // est le prêteur de la requête, dont la disponibilité décide du relais dans le pool
+    bool complete(FrameHandle frame, FrameLender &camera) {
+        if (staging && staging->count() > 0 && camera.available() == 0) {
+            // Plus aucune requête libre : copie en mémoire verrouillée, requête rendue
+            if (FrameLease *copy = staging->takeCopy(frame.lease())) {
+                frame = FrameHandle(copy);
+                framesStaged++;
+            }
+        }
+        if (preview) {
+            FixedText<sizeof(frame->name) + 8> name;
+            name.add(frame->name).add(previewExtension());
+            preview->submit(frame, name.c_str());
+        }
+        if (!targets_.dispatch(std::move(frame))) {
+            LOG_ERROR("Erreur: aucune cible d'écriture disponible");
+            return false;
+        }
+        return true;
+    }
+
+    // Écriture d'une image sur la cible choisie par la répartition (StorageTargets::WriteFn) ;
+    // en cas d'échec StorageTargets renvoie l'image vers une autre cible
+    bool write(const FrameHandle &frame, StorageTarget &target) {
+        if (frame.size() == 0) {
+            LOG_ERROR("Erreur: Buffer vide");
+            return true;
+        }
+        if (format.width == 0) {
+            LOG_ERROR("Erreur: format d'image non disponible");
+            return true;
+        }
+
+        // Métriques avant l'écriture, seulement si aucune image n'attend derrière celle-ci
+        FrameMetrics metrics;
+        const char *alert = "";
+        if (metricsBudgetUs > 0 && target.depth.load() == 0) {
+            computeFrameMetrics(frame.data(), frame.size(), format.width, format.height, format.stride,
+                                metricsBudgetUs, metrics);
+            alert = classifyFrame(metrics, sharpnessRef.load());
+            if (strcmp(alert, "ok") == 0) {
+                // Moyenne glissante partagée par les threads d'écriture : mise à jour atomique
+                double ref = sharpnessRef.load();
+                double next;
+                do {
+                    next = ref > 0.0 ? 0.9 * ref + 0.1 * metrics.sharpness : metrics.sharpness;
+                } while (!sharpnessRef.compare_exchange_weak(ref, next));
+            } else if (metrics.valid) {
+                framesFlagged++;
+                LOG_WARN("Alerte: image {} {} (luminosité {}, saturés {} %, netteté {})", frame->pulse, alert,
+                         metrics.mean, metrics.clipped * 100, metrics.sharpness);
+            }
+        } else {
+            metricsSkipped++;
+        }
+
+        const FrameLease &lease = frame.lease();
+        bool revoked = lease.pulse > 0 && revokedLate(lease.pulse);
+        FixedText<4096> info;
+        appendFrameInfo(info, lease);
+        if (revoked)
+            info.line("revoked", 1);
+        if (appendInfo)
+            appendInfo(info);
+        appendMetricsInfo(info, metrics, alert);
+
+        // Écrit directement depuis le mapping du buffer (aucune copie en espace utilisateur)
+        FixedText<PATH_MAX> rawpath;
+        rawpath.add(target.dir).add(lease.name).add(".raw");
+        uint64_t checksum = 0;
+        if (!rawpath.ok() || !writeRawFrame(rawpath.c_str(), frame.data(), frame.size(), format, target.durability,
+                                            target.journal, info.c_str(), &checksum)) {
+            writeErrors++;
+            return false;
+        }
+        framesWritten++;
+        bytesWritten += frame.size();
+
+        FixedText<sizeof(lease.name) + 4> filename;
+        filename.add(lease.name).add(".raw");
+        log_.record(lease, target.id, target.dir, filename.c_str(), frame.size(), metrics, alert);
+
+        SessionIndexEntry entry = {};
+        entry.pulse = lease.pulse;
+        entry.clk = lease.clk;
+        entry.tick = lease.tick;
+        entry.ppsTick = lease.ppsTick;
+        entry.sequence = lease.sequence;
+        entry.sensorTimestamp = lease.sensorTimestamp;
+        entry.size = frame.size();
+        entry.checksum = checksum;
+        entry.target = static_cast<uint16_t>(target.id);
+        entry.flags = (metrics.valid ? ENTRY_METRICS : 0) |
+                      (metrics.valid && strcmp(alert, "ok") != 0 ? ENTRY_FLAGGED : 0) |
+                      (lease.holdover ? ENTRY_HOLDOVER : 0) | (revoked ? ENTRY_REVOKED : 0);
+        memcpy(entry.name, filename.c_str(), filename.size() + 1);
+        index_.record(entry);
+        return true;
+    }
+
+private:
+    StorageTargets &targets_;
+    SessionLog &log_;
+    SessionIndex &index_;
+    std::atomic<int> revoked_[REVOKED_SLOTS] = {};
+    std::atomic<unsigned> revokedNext_{0};
+};
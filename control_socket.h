@@ -0,0 +1,180 @@
+// Socket de contrôle local (Unix domain socket) du démon de capture
+//
+// Protocole texte, une commande par connexion : le client envoie une ligne,
+// le démon répond puis ferme la connexion. Utilisé par native.cpp (--daemon)
+// et par le client natctl.cpp.
+// Le socket appartient au démon (root) et à un groupe (gpio par défaut), en 0660 :
+// seuls root et les membres du groupe peuvent lancer ou arrêter une capture.
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+
+#include <grp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static const char *const DEFAULT_CONTROL_SOCKET = "/run/nat.sock";
+static const char *const DEFAULT_CONTROL_GROUP = "gpio";
+static const int CONTROL_READ_TIMEOUT_MS = 1000; // un client muet ne bloque pas le démon
+
+class ControlServer {
+public:
+    ~ControlServer() { close(); }
+
+    // Sans le groupe demandé, le socket reste réservé au propriétaire (0600)
+    bool open(const std::string &path, const std::string &groupName = DEFAULT_CONTROL_GROUP) {
+        if (path.size() >= sizeof(sockaddr_un::sun_path))
+            return false;
+
+        fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0)
+            return false;
+
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str()); // socket restée d'une exécution précédente
+
+        // Créé en 0600, puis ouvert au groupe une fois le propriétaire fixé
+        mode_t previous = umask(0177);
+        bool bound = bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        umask(previous);
+        if (!bound || listen(fd_, 4) < 0) {
+            close();
+            return false;
+        }
+        path_ = path;
+
+        group_.clear();
+        const struct group *gr = groupName.empty() ? nullptr : getgrnam(groupName.c_str());
+        if (gr && chown(path.c_str(), geteuid(), gr->gr_gid) == 0 && chmod(path.c_str(), 0660) == 0)
+            group_ = groupName;
+        return true;
+    }
+
+    // Groupe autorisé à piloter le démon (vide : propriétaire seulement)
+    const std::string &group() const { return group_; }
+
+    // Traite les commandes jusqu'à ce que stop passe à true (vérifié toutes les 200 ms)
+    void serve(const std::function<std::string(const std::string &)> &handler,
+               const std::atomic<bool> &stop) {
+        while (!stop.load()) {
+            pollfd pfd = { fd_, POLLIN, 0 };
+            int ret = poll(&pfd, 1, 200);
+            if (ret <= 0)
+                continue;
+
+            int client = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0)
+                continue;
+
+            // Un client qui ne lit pas sa réponse ne bloque pas non plus l'écriture
+            timeval timeout = { CONTROL_READ_TIMEOUT_MS / 1000, (CONTROL_READ_TIMEOUT_MS % 1000) * 1000 };
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+            std::string command;
+            if (!readLine(client, command, CONTROL_READ_TIMEOUT_MS)) {
+                ::close(client);
+                continue;
+            }
+            std::string reply = handler(command);
+            if (reply.empty() || reply.back() != '\n')
+                reply += '\n';
+            writeAll(client, reply);
+            ::close(client);
+        }
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        if (!path_.empty()) {
+            unlink(path_.c_str());
+            path_.clear();
+        }
+    }
+
+    // Ligne de commande (256 octets au plus) reçue avant l'échéance ; false si le client
+    // n'envoie rien, ferme sans saut de ligne ou dépasse le délai
+    static bool readLine(int fd, std::string &line, int timeoutMs) {
+        using namespace std::chrono;
+        auto deadline = steady_clock::now() + milliseconds(timeoutMs);
+        line.clear();
+        char buf[256];
+        while (line.size() < sizeof(buf)) {
+            int remaining = static_cast<int>(duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+            if (remaining <= 0)
+                return false;
+            pollfd pfd = { fd, POLLIN, 0 };
+            int ret = poll(&pfd, 1, remaining);
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret <= 0)
+                return false;
+            ssize_t n = ::read(fd, buf, sizeof(buf) - line.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return !line.empty();
+            const char *end = static_cast<const char *>(memchr(buf, '\n', n));
+            line.append(buf, end ? end - buf : n);
+            if (end)
+                return true;
+        }
+        return true;
+    }
+
+    static bool writeAll(int fd, const std::string &data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            done += n;
+        }
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    std::string path_;
+    std::string group_;
+};
+
+// Côté client : envoie une commande et renvoie la réponse (vide en cas d'erreur)
+inline bool sendControlCommand(const std::string &path, const std::string &command, std::string &reply)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    bool ok = ControlServer::writeAll(fd, command + "\n");
+    reply.clear();
+    char buf[512];
+    ssize_t n;
+    while (ok && (n = ::read(fd, buf, sizeof(buf))) > 0)
+        reply.append(buf, n);
+    ::close(fd);
+    return ok;
+}
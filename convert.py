@@ -7,7 +7,10 @@ import numpy as np
 import sys
 import os
 import glob
-from PIL import Image
+import mmap
+import struct
+import zlib
+from concurrent.futures import ProcessPoolExecutor
 
 def lire_info(fichier_info):
     """Lit le fichier .info"""
@@ -22,67 +25,27 @@ def lire_info(fichier_info):
     except FileNotFoundError:
         return None
 
-def unpack_10bit_csi2p(data, width, height, stride):
-    """Dépaquette 10-bit CSI2P vers uint16"""
+# Nombre de lignes traitées à la fois : la mémoire d'un worker ne dépend pas de la taille de l'image
+# (bande RGB 16-bit de 32 lignes en 4608 px = 0.9 MB)
+BANDE_LIGNES = 32
 
-    
-    packed = np.frombuffer(data, dtype=np.uint8)
-    unpacked = np.zeros((height, width), dtype=np.uint16)
-    
-    # ------------------ CALCUL CRITIQUE ------------------
-    # 4 pixels sont codés dans 5 octets (un groupe).
-    # Calculer le nombre de groupes de 5 octets nécessaires pour la largeur totale des pixels.
-    num_groups = width // 4
-    if width % 4 != 0:
-        num_groups += 1 # Gérer les pixels restants s'il y en a
-
-    # La longueur des données réelles empaquetées pour les pixels (sans le padding)
-    packed_data_length = num_groups * 5
-    # ----------------------------------------------------
-    
-    packed_line_length = stride # Ceci est la taille totale de la ligne, y compris le padding
-    
-    print(f"   • Groupes/Ligne: {num_groups}. Données/Ligne: {packed_data_length} octets.")
-    print(f"   • Stride (total ligne): {packed_line_length} octets.")
-    
-    for row in range(height):
-        row_offset = row * packed_line_length # Début de la ligne empaquetée
-        
-        # Parcourir uniquement les groupes de données utiles (jusqu'à num_groups)
-        for group in range(num_groups):
-            # L'offset est basé sur la position dans la ligne empaquetée
-            offset = row_offset + group * 5
-            
-            # Vérification de sécurité (essentielle)
-            if offset + 4 >= len(packed) or (group * 4) >= width:
-                break
-            
-            b0, b1, b2, b3, b4 = packed[offset:offset+5]
-            
-            # Reconstruire 4 pixels 10-bit (Cette logique est correcte pour CSI2P)
-            p0 = (b0 << 2) | ((b4 >> 0) & 0x3)
-            p1 = (b1 << 2) | ((b4 >> 2) & 0x3)
-            p2 = (b2 << 2) | ((b4 >> 4) & 0x3)
-            p3 = (b3 << 2) | ((b4 >> 6) & 0x3)
-            
-            col = group * 4
-            
-            # Appliquer les pixels, en faisant attention aux bords
-            pixels_to_write = [p0, p1, p2, p3]
-            
-            # Écrire uniquement le nombre de pixels qui existent réellement dans le groupe final
-            unpacked[row, col : col + min(4, width - col)] = pixels_to_write[:min(4, width - col)]
-            
-    # ... (Le reste de la fonction est inchangé, incluant la normalisation 10-bit -> 16-bit)
-    stats_min, stats_max, stats_mean = unpacked.min(), unpacked.max(), unpacked.mean()
-    print(f"   Valeurs 10-bit: Min={stats_min}, Max={stats_max}, Moy={stats_mean:.1f}")
-    
-    # Normaliser vers 16-bit (multiplier par 64 pour 10bit→16bit)
-    unpacked = (unpacked << 6).astype(np.uint16)
-    
-    print(f"  Normalisé 16-bit: Min={unpacked.min()}, Max={unpacked.max()}, Moy={unpacked.mean():.1f}")
-    
-    return unpacked
+def depaqueter_bande_csi2p(bande, width):
+    """Dépaquette une bande de lignes 10-bit CSI2P (tableau uint8 lignes x stride) vers uint16 10-bit"""
+    # 4 pixels sont codés dans 5 octets (un groupe) ; le reste de la ligne est du padding
+    num_groups = (width + 3) // 4
+    groupes = bande[:, :num_groups * 5].reshape(bande.shape[0], num_groups, 5)
+
+    pixels = groupes[:, :, :4].astype(np.uint16)
+    pixels <<= 2
+    bas = groupes[:, :, 4:5]
+    pixels |= (bas >> np.array([0, 2, 4, 6], dtype=np.uint8)) & 0x3
+
+    return pixels.reshape(bande.shape[0], num_groups * 4)[:, :width]
+
+def unpack_10bit_csi2p(data, width, height, stride):
+    """Dépaquette 10-bit CSI2P vers uint16 (image entière, normalisée sur 16 bits)"""
+    packed = np.frombuffer(data, dtype=np.uint8, count=height * stride).reshape(height, stride)
+    return depaqueter_bande_csi2p(packed, width) << 6
 
 def test_offset(bayer_array, h_offset=0, v_offset=0):
     """Décalage (roll) cyclique pour tester l'alignement"""
@@ -90,104 +53,130 @@ def test_offset(bayer_array, h_offset=0, v_offset=0):
         print(f"  Décalage cyclique appliqué: H={h_offset}, V={v_offset}")
     return np.roll(bayer_array, (v_offset, h_offset), axis=(0, 1))
 
+# Position (ligne, colonne) de R, G1, G2 et B dans un quad 2x2 selon le motif
+POSITIONS_BAYER = {
+    'BGGR': ((1, 1), (0, 1), (1, 0), (0, 0)),
+    'RGGB': ((0, 0), (0, 1), (1, 0), (1, 1)),
+    'GRBG': ((0, 1), (0, 0), (1, 1), (1, 0)),
+    'GBRG': ((1, 0), (0, 0), (1, 1), (0, 1)),
+}
+
+def debayer_bande(bayer, pattern, rgb):
+    """
+    Debayering nearest-neighbor d'une bande (nombre pair de lignes) dans `rgb` (lignes x largeur x 3)
+    R et B sont répétés sur le quad, le vert est la moyenne des deux verts là où il manque
+    """
+    (ry, rx), (g1y, g1x), (g2y, g2x), (by, bx) = POSITIONS_BAYER.get(pattern, POSITIONS_BAYER['RGGB'])
+
+    rouge = bayer[ry::2, rx::2]
+    bleu = bayer[by::2, bx::2]
+    g1 = bayer[g1y::2, g1x::2]
+    g2 = bayer[g2y::2, g2x::2]
+    g_moyen = ((g1.astype(np.uint32) + g2) // 2).astype(np.uint16)
+
+    for dy in (0, 1):
+        for dx in (0, 1):
+            rgb[dy::2, dx::2, 0] = rouge
+            rgb[dy::2, dx::2, 2] = bleu
+            rgb[dy::2, dx::2, 1] = g_moyen
+    rgb[g1y::2, g1x::2, 1] = g1
+    rgb[g2y::2, g2x::2, 1] = g2
+    return rgb
+
 def debayer_simple_rapide(bayer, pattern='RGGB'):
     """
     Debayering simple et robuste (nearest-neighbor avec amélioration)
     Retourne une image RGB 16-bit
     """
     print(f"  Debayering {pattern}...")
-    
     height, width = bayer.shape
-    rgb = np.zeros((height, width, 3), dtype=np.uint16)
-    
-    if pattern == 'BGGR':
-        # Pattern BGGR: B(0,0) G(0,1) / G(1,0) R(1,1)
-        
-        # Bleu: lignes paires, colonnes paires
-        rgb[0::2, 0::2, 2] = bayer[0::2, 0::2]
-        # Interpolation simple (répétition + moyenne)
-        rgb[0::2, 1::2, 2] = bayer[0::2, 0::2]
-        rgb[1::2, 0::2, 2] = bayer[0::2, 0::2]
-        rgb[1::2, 1::2, 2] = bayer[0::2, 0::2]
-        
-        # Vert G1: lignes paires, colonnes impaires
-        # Vert G2: lignes impaires, colonnes paires
-        rgb[0::2, 1::2, 1] = bayer[0::2, 1::2]
-        rgb[1::2, 0::2, 1] = bayer[1::2, 0::2]
-        # Moyenne pour les autres positions
-        rgb[0::2, 0::2, 1] = (bayer[0::2, 1::2].astype(np.uint32) + 
-                               bayer[1::2, 0::2].astype(np.uint32)) // 2
-        rgb[1::2, 1::2, 1] = (bayer[0::2, 1::2].astype(np.uint32) + 
-                               bayer[1::2, 0::2].astype(np.uint32)) // 2
-        
-        # Rouge: lignes impaires, colonnes impaires
-        rgb[1::2, 1::2, 0] = bayer[1::2, 1::2]
-        rgb[1::2, 0::2, 0] = bayer[1::2, 1::2]
-        rgb[0::2, 1::2, 0] = bayer[1::2, 1::2]
-        rgb[0::2, 0::2, 0] = bayer[1::2, 1::2]
-        
-    elif pattern == 'RGGB':
-        # Pattern RGGB: R(0,0) G(0,1) / G(1,0) B(1,1)
-        
-        # Rouge
-        rgb[0::2, 0::2, 0] = bayer[0::2, 0::2]
-        rgb[0::2, 1::2, 0] = bayer[0::2, 0::2]
-        rgb[1::2, 0::2, 0] = bayer[0::2, 0::2]
-        rgb[1::2, 1::2, 0] = bayer[0::2, 0::2]
-        
-        # Vert
-        rgb[0::2, 1::2, 1] = bayer[0::2, 1::2]
-        rgb[1::2, 0::2, 1] = bayer[1::2, 0::2]
-        rgb[0::2, 0::2, 1] = (bayer[0::2, 1::2].astype(np.uint32) + 
-                               bayer[1::2, 0::2].astype(np.uint32)) // 2
-        rgb[1::2, 1::2, 1] = (bayer[0::2, 1::2].astype(np.uint32) + 
-                               bayer[1::2, 0::2].astype(np.uint32)) // 2
-        
-        # Bleu
-        rgb[1::2, 1::2, 2] = bayer[1::2, 1::2]
-        rgb[1::2, 0::2, 2] = bayer[1::2, 1::2]
-        rgb[0::2, 1::2, 2] = bayer[1::2, 1::2]
-        rgb[0::2, 0::2, 2] = bayer[1::2, 1::2]
-    
-    elif pattern == 'GRBG':
-        # Pattern GRBG: G(0,0) R(0,1) / B(1,0) G(1,1)
-        
-        rgb[0::2, 0::2, 1] = bayer[0::2, 0::2]
-        rgb[1::2, 1::2, 1] = bayer[1::2, 1::2]
-        rgb[0::2, 1::2, 1] = bayer[0::2, 0::2]
-        rgb[1::2, 0::2, 1] = bayer[1::2, 1::2]
-        
-        rgb[0::2, 1::2, 0] = bayer[0::2, 1::2]
-        rgb[0::2, 0::2, 0] = bayer[0::2, 1::2]
-        rgb[1::2, :, 0] = bayer[0::2, 1::2]
-        
-        rgb[1::2, 0::2, 2] = bayer[1::2, 0::2]
-        rgb[1::2, 1::2, 2] = bayer[1::2, 0::2]
-        rgb[0::2, :, 2] = bayer[1::2, 0::2]
-    
-    elif pattern == 'GBRG':
-        # Pattern GBRG: G(0,0) B(0,1) / R(1,0) G(1,1)
-        
-        rgb[0::2, 0::2, 1] = bayer[0::2, 0::2]
-        rgb[1::2, 1::2, 1] = bayer[1::2, 1::2]
-        rgb[0::2, 1::2, 1] = bayer[0::2, 0::2]
-        rgb[1::2, 0::2, 1] = bayer[1::2, 1::2]
-        
-        rgb[0::2, 1::2, 2] = bayer[0::2, 1::2]
-        rgb[0::2, 0::2, 2] = bayer[0::2, 1::2]
-        rgb[1::2, :, 2] = bayer[0::2, 1::2]
-        
-        rgb[1::2, 0::2, 0] = bayer[1::2, 0::2]
-        rgb[1::2, 1::2, 0] = bayer[1::2, 0::2]
-        rgb[0::2, :, 0] = bayer[1::2, 0::2]
-    
+    rgb = debayer_bande(bayer, pattern, np.empty((height, width, 3), dtype=np.uint16))
     print(f"   Debayering terminé")
     print(f"   RGB Min={rgb.min()}, Max={rgb.max()}, Moy={rgb.mean():.1f}")
-    
     return rgb
 
+class TiffEnBandes:
+    """
+    Écrit un TIFF RGB 16-bit bande par bande (une bande = une strip) : l'image complète
+    n'est jamais en mémoire. Compression Deflate (zlib) avec prédicteur horizontal,
+    sans perte et lue par Metashape, Photoshop, GIMP...
+    """
+
+    def __init__(self, chemin, largeur, hauteur, lignes_par_bande, niveau=6):
+        self.f = open(chemin, 'wb')
+        self.largeur = largeur
+        self.hauteur = hauteur
+        self.lignes_par_bande = lignes_par_bande
+        self.niveau = niveau
+        self.offsets = []
+        self.tailles = []
+        self.f.write(b'II*\x00\x00\x00\x00\x00')  # en-tête, offset de l'IFD écrit à la fin
+
+    def ecrire_bande(self, rgb):
+        # Prédicteur horizontal : différences entre pixels voisins, par canal (modulo 2^16)
+        diff = rgb.astype('<u2')
+        diff[:, 1:, :] -= rgb[:, :-1, :]
+        donnees = zlib.compress(diff.tobytes(), self.niveau)
+        self.offsets.append(self.f.tell())
+        self.tailles.append(len(donnees))
+        self.f.write(donnees)
+
+    def fermer(self):
+        n = len(self.offsets)
+        position = self.f.tell()
+        if position % 2:
+            self.f.write(b'\x00')
+            position += 1
+
+        # Données hors IFD : BitsPerSample (3 valeurs), offsets et tailles des strips
+        bits = position
+        offsets_pos = bits + 6
+        tailles_pos = offsets_pos + 4 * n
+        self.f.write(struct.pack('<3H', 16, 16, 16))
+        self.f.write(struct.pack(f'<{n}I', *self.offsets))
+        self.f.write(struct.pack(f'<{n}I', *self.tailles))
+
+        # (tag, type, nombre, valeur) ; type 3 = SHORT, 4 = LONG
+        tags = [
+            (256, 4, 1, self.largeur),
+            (257, 4, 1, self.hauteur),
+            (258, 3, 3, bits),
+            (259, 3, 1, 8),                 # Deflate
+            (262, 3, 1, 2),                 # RGB
+            (273, 4, n, offsets_pos if n > 1 else self.offsets[0]),
+            (277, 3, 1, 3),
+            (278, 4, 1, self.lignes_par_bande),
+            (279, 4, n, tailles_pos if n > 1 else self.tailles[0]),
+            (284, 3, 1, 1),                 # pixels entrelacés
+            (317, 3, 1, 2),                 # prédicteur horizontal
+        ]
+        ifd = self.f.tell()
+        self.f.write(struct.pack('<H', len(tags)))
+        for tag, typ, nombre, valeur in tags:
+            if typ == 3 and nombre == 1:
+                self.f.write(struct.pack('<HHIHH', tag, typ, nombre, valeur, 0))
+            else:
+                self.f.write(struct.pack('<HHII', tag, typ, nombre, valeur))
+        self.f.write(struct.pack('<I', 0))
+        self.f.seek(4)
+        self.f.write(struct.pack('<I', ifd))
+        self.f.close()
+
+def lire_bande(donnees, format_raw, largeur, stride, ligne, lignes):
+    """Bande de `lignes` lignes de Bayer 16-bit depuis le fichier mappé"""
+    if format_raw == 'csi2p':
+        bande = np.frombuffer(donnees, dtype=np.uint8, count=lignes * stride,
+                              offset=ligne * stride).reshape(lignes, stride)
+        return depaqueter_bande_csi2p(bande, largeur) << 6
+    if format_raw == '16':
+        return np.frombuffer(donnees, dtype=np.uint16, count=lignes * largeur,
+                             offset=ligne * largeur * 2).reshape(lignes, largeur).copy()
+    bande = np.frombuffer(donnees, dtype=np.uint8, count=lignes * largeur,
+                          offset=ligne * largeur).reshape(lignes, largeur)
+    return bande.astype(np.uint16) << 8
+
 def convertir_raw_vers_tiff(fichier_raw, fichier_sortie=None, boost_exposure=1.0):
-    """Convertit .raw en TIFF 16-bit RGB"""
+    """Convertit .raw en TIFF 16-bit RGB, en flux par bandes de lignes (mémoire bornée)"""
     
     fichier_info = fichier_raw + ".info"
     
@@ -214,29 +203,7 @@ def convertir_raw_vers_tiff(fichier_raw, fichier_sortie=None, boost_exposure=1.0
     print(f"   • Résolution: {largeur}x{hauteur}")
     print(f"   • Format: {format_pixel}")
     print(f"   • Stride: {stride} bytes")
-    # Lire fichier RAW
-    try:
-        with open(fichier_raw, 'rb') as f:
-            data = f.read()
-    except FileNotFoundError:
-        print(f"Fichier introuvable")
-        return False
-    
-    # Déterminer pattern Bayer (Correction du point 1)
-    if len(format_pixel) >= 5 and format_pixel[0] == 'S':
-        # Extrait les 4 lettres du motif (ex: SBGGR10_CSI2P -> BGGR)
-        pattern = format_pixel[1:5].upper()
-    else:
-        pattern = 'RGGB' # Fallback le plus commun pour les capteurs Pi
-    
-    # Forcer un pattern spécifique pour les tests
-    #pattern = 'GRBG' 
 
-    #print(f"   • Pattern Bayer forcé: {pattern}")
-    
-    taille = len(data)
-    print(f"   • Taille: {taille / (1024*1024):.2f} MB")
-    
     # Déterminer le pattern Bayer à partir du format_pixel (e.g., SBGGR10_CSI2P -> BGGR)
     # Le format commence par 'S' (Sensor), suivi du pattern.
     if len(format_pixel) >= 5 and format_pixel[0] == 'S':
@@ -246,66 +213,78 @@ def convertir_raw_vers_tiff(fichier_raw, fichier_sortie=None, boost_exposure=1.0
     
     pattern = pattern.upper()
     print(f"   • Pattern Bayer détecté: {pattern}")
-    
-    print(f"   • Pattern Bayer: {pattern}")
+
+    # Fichier RAW mappé en mémoire : seules les pages de la bande en cours sont lues
+    try:
+        with open(fichier_raw, 'rb') as f:
+            taille = os.fstat(f.fileno()).st_size
+            if taille == 0:
+                print(f"Fichier vide")
+                return False
+            donnees = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except FileNotFoundError:
+        print(f"Fichier introuvable")
+        return False
+
+    print(f"   • Taille: {taille / (1024*1024):.2f} MB")
     
     # Traiter selon format
     pixels_attendus = largeur * hauteur
-    bayer_array = None
-    
-    if 'CSI2P' in format_pixel or '10_CSI2P' in format_pixel:
-        bayer_array = unpack_10bit_csi2p(data, largeur, hauteur, stride)
+    if 'CSI2P' in format_pixel and taille >= hauteur * stride:
+        format_raw = 'csi2p'
+        print(f"   • Groupes/Ligne: {(largeur + 3) // 4}. Stride (total ligne): {stride} octets.")
     elif taille == pixels_attendus * 2:
+        format_raw = '16'
         print(f"   📦 Format: 16-bit RAW")
-        bayer_array = np.frombuffer(data, dtype=np.uint16).reshape((hauteur, largeur))
     elif taille == pixels_attendus:
+        format_raw = '8'
         print(f"   📦 Format: 8-bit RAW")
-        bayer_array = np.frombuffer(data, dtype=np.uint8).reshape((hauteur, largeur))
-        bayer_array = (bayer_array.astype(np.uint16) << 8)
     else:
         print(f"❌ Format non reconnu (taille: {taille}, attendu: {pixels_attendus})")
+        donnees.close()
         return False
-    
-    if bayer_array is None:
-        return False
-    
-    # Tester décalages (optionnel)
-    #h_offset_test = 2
-    #v_offset_test = 0
-    
-    #if h_offset_test != 0 or v_offset_test != 0:
-    #    bayer_array = test_offset(bayer_array, h_offset=h_offset_test, v_offset=v_offset_test)
-    
-    # ------------------------------------------------------------
-    
-    # Appliquer boost d'exposition si nécessaire
+
     if boost_exposure != 1.0:
         print(f"   💡 Boost exposition: x{boost_exposure}")
-        bayer_array = np.clip(bayer_array.astype(np.uint32) * boost_exposure, 
-                               0, 65535).astype(np.uint16)
-        print(f"   📊 Après boost: Min={bayer_array.min()}, Max={bayer_array.max()}")
-    
-    
-    # Debayering
-    rgb = debayer_simple_rapide(bayer_array, pattern)
-
-    # Debayering
-    rgb = debayer_simple_rapide(bayer_array, pattern)
     
     # Générer nom fichier
     if fichier_sortie is None:
         base = os.path.splitext(fichier_raw)[0]
         fichier_sortie = base + ".tif"
     
-    # Sauvegarder en TIFF 16-bit
-    print(f"   💾 Sauvegarde TIFF 16-bit...")
-    
-    # PIL supporte TIFF 16-bit en mode 'I;16' (grayscale) ou RGB via numpy
-    # Convertir en format PIL accepte
-    img = Image.fromarray(rgb, mode='RGB')
-    
-    # Sauvegarder avec compression LZW (sans perte)
-    img.save(fichier_sortie, format='TIFF', compression='lzw')
+    print(f"   💾 Conversion par bandes de {BANDE_LIGNES} lignes vers TIFF 16-bit...")
+
+    # Tampons réutilisés d'une bande à l'autre
+    rgb = np.empty((BANDE_LIGNES, largeur, 3), dtype=np.uint16)
+    boost = np.empty((BANDE_LIGNES, largeur), dtype=np.float32)
+    stats_min, stats_max, stats_somme = 65535, 0, 0
+
+    tiff = TiffEnBandes(fichier_sortie, largeur, hauteur, BANDE_LIGNES)
+    try:
+        for ligne in range(0, hauteur, BANDE_LIGNES):
+            lignes = min(BANDE_LIGNES, hauteur - ligne)
+            bayer = lire_bande(donnees, format_raw, largeur, stride, ligne, lignes)
+
+            stats_min = min(stats_min, int(bayer.min()))
+            stats_max = max(stats_max, int(bayer.max()))
+            stats_somme += int(bayer.sum(dtype=np.uint64))
+
+            # Appliquer boost d'exposition si nécessaire
+            if boost_exposure != 1.0:
+                b = boost[:lignes]
+                np.multiply(bayer, np.float32(boost_exposure), out=b)
+                np.clip(b, 0, 65535, out=b)
+                bayer = b.astype(np.uint16)
+
+            # Une bande impaire (dernière) est complétée en répétant sa dernière ligne
+            if lignes % 2:
+                bayer = np.vstack([bayer, bayer[-1:]])
+            tiff.ecrire_bande(debayer_bande(bayer, pattern, rgb[:bayer.shape[0]])[:lignes])
+    finally:
+        tiff.fermer()
+        donnees.close()
+
+    print(f"   Valeurs 16-bit: Min={stats_min}, Max={stats_max}, Moy={stats_somme / pixels_attendus:.1f}")
     
     taille_sortie = os.path.getsize(fichier_sortie)
     print(f"\n{'='*70}")
@@ -317,8 +296,8 @@ def convertir_raw_vers_tiff(fichier_raw, fichier_sortie=None, boost_exposure=1.0
     
     return True
 
-def convertir_batch(dossier=".", boost_exposure=1.0):
-    """Convertit tous les .raw d'un dossier"""
+def convertir_batch(dossier=".", boost_exposure=1.0, jobs=1):
+    """Convertit tous les .raw d'un dossier (jobs conversions en parallèle, quelques MB chacune)"""
     
     fichiers = sorted(glob.glob(os.path.join(dossier, "*.raw")))
     
@@ -332,17 +311,28 @@ def convertir_batch(dossier=".", boost_exposure=1.0):
     print(f"Dossier: {os.path.abspath(dossier)}")
     print(f"Fichiers trouvés: {len(fichiers)}")
     print(f"Boost exposition: x{boost_exposure}")
+    print(f"Conversions en parallèle: {jobs}")
     print(f"{'='*70}\n")
     
     succes = 0
     echecs = 0
     
-    for i, fichier in enumerate(fichiers, 1):
-        print(f"[{i}/{len(fichiers)}] ", end='')
-        if convertir_raw_vers_tiff(fichier, boost_exposure=boost_exposure):
-            succes += 1
-        else:
-            echecs += 1
+    if jobs > 1:
+        with ProcessPoolExecutor(max_workers=jobs) as pool:
+            resultats = pool.map(convertir_raw_vers_tiff, fichiers, [None] * len(fichiers),
+                                 [boost_exposure] * len(fichiers))
+            for ok in resultats:
+                if ok:
+                    succes += 1
+                else:
+                    echecs += 1
+    else:
+        for i, fichier in enumerate(fichiers, 1):
+            print(f"[{i}/{len(fichiers)}] ", end='')
+            if convertir_raw_vers_tiff(fichier, boost_exposure=boost_exposure):
+                succes += 1
+            else:
+                echecs += 1
     
     print(f"\n{'='*70}")
     print(f"RÉSUMÉ")
@@ -352,6 +342,13 @@ def convertir_batch(dossier=".", boost_exposure=1.0):
     print(f"{'='*70}\n")
 
 if __name__ == "__main__":
+    # --jobs=N : nombre de conversions simultanées en mode --batch
+    jobs = 1
+    for arg in list(sys.argv[1:]):
+        if arg.startswith("--jobs="):
+            jobs = max(1, int(arg[7:]))
+            sys.argv.remove(arg)
+
     if len(sys.argv) < 2:
         print("="*70)
         print("CONVERTISSEUR RAW → TIFF 16-bit")
@@ -365,17 +362,19 @@ if __name__ == "__main__":
         print("  python3 convert_to_tiff.py capture_0001.raw 10")
         print("  python3 convert_to_tiff.py --batch images/")
         print("  python3 convert_to_tiff.py --batch images/ 15")
+        print("  python3 convert_to_tiff.py --jobs=4 --batch images/")
         print("\n Notes:")
         print("  • Le fichier .raw.info doit exister")
         print("  • boost: multiplie la luminosité (défaut=1.0)")
         print("  • TIFF 16-bit = qualité maximale, compatible partout")
+        print("  • Conversion par bandes : quelques MB de mémoire par conversion")
         print("="*70)
         sys.exit(1)
     
     if sys.argv[1] == "--batch":
         dossier = sys.argv[2] if len(sys.argv) > 2 and sys.argv[2] != sys.argv[-1] else "."
         boost = float(sys.argv[-1]) if len(sys.argv) > 2 and sys.argv[-1].replace('.','').isdigit() else 1.0
-        convertir_batch(dossier, boost)
+        convertir_batch(dossier, boost, jobs)
     else:
         fichier = sys.argv[1]
         boost = float(sys.argv[2]) if len(sys.argv) > 2 else 1.0
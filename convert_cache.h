@@ -0,0 +1,118 @@
+// Registre des conversions terminées de nat_convert, pour ne jamais refaire le même travail
+//
+// Une ligne par conversion réussie dans un fichier texte en ajout seul :
+//   mode <TAB> chemin <TAB> taille <TAB> mtime_ns <TAB> empreinte
+// Le mode décrit la sortie (ex. "dng:7"), une même image pouvant être convertie de
+// plusieurs façons. Une entrée est à jour si la taille et la date correspondent ; si seule
+// la date a changé (copie, resynchronisation), l'empreinte du contenu tranche. Le fichier
+// est relu au démarrage, la dernière ligne d'un chemin l'emportant ; une ligne tronquée
+// par une coupure est ignorée.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class ConvertCache {
+public:
+    ConvertCache() = default;
+    ConvertCache(const ConvertCache &) = delete;
+    ConvertCache &operator=(const ConvertCache &) = delete;
+    ~ConvertCache() { close(); }
+
+    bool open(const std::string &path) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        path_ = path;
+        entries_.clear();
+        if (FILE *in = fopen(path.c_str(), "r")) {
+            char line[4096];
+            while (fgets(line, sizeof(line), in)) {
+                std::string s(line);
+                if (s.empty() || s.back() != '\n')
+                    continue; // ligne incomplète
+                s.pop_back();
+                size_t t[4];
+                size_t pos = 0;
+                bool ok = true;
+                for (int i = 0; i < 4 && ok; i++) {
+                    t[i] = s.find('\t', pos);
+                    ok = t[i] != std::string::npos;
+                    pos = t[i] + 1;
+                }
+                if (!ok)
+                    continue;
+                Entry e;
+                if (sscanf(s.c_str() + t[1] + 1, "%llu\t%lld\t%llx", &e.size, &e.mtimeNs, &e.hash) != 3)
+                    continue;
+                entries_[s.substr(0, t[1])] = e;
+            }
+            fclose(in);
+        }
+        out_ = fopen(path.c_str(), "a");
+        return out_ != nullptr;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (out_)
+            fclose(out_);
+        out_ = nullptr;
+    }
+
+    // true si `path` a déjà été converti dans ce mode ; `hash` n'est appelé que si la date a changé
+    bool done(const std::string &mode, const std::string &path, uint64_t size, int64_t mtimeNs,
+              const std::function<uint64_t()> &hash) {
+        Entry e;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            auto it = entries_.find(key(mode, path));
+            if (it == entries_.end() || it->second.size != size)
+                return false;
+            e = it->second;
+        }
+        if (e.mtimeNs == mtimeNs)
+            return true;
+        uint64_t h = hash();
+        if (h != e.hash)
+            return false;
+        record(mode, path, size, mtimeNs, h); // même contenu : la nouvelle date suffira la prochaine fois
+        return true;
+    }
+
+    void record(const std::string &mode, const std::string &path, uint64_t size, int64_t mtimeNs, uint64_t hash) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        Entry &e = entries_[key(mode, path)];
+        e.size = size;
+        e.mtimeNs = mtimeNs;
+        e.hash = hash;
+        if (out_) {
+            fprintf(out_, "%s\t%s\t%llu\t%lld\t%llx\n", mode.c_str(), path.c_str(), e.size, e.mtimeNs, e.hash);
+            fflush(out_);
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return entries_.size();
+    }
+
+    const std::string &path() const { return path_; }
+
+private:
+    struct Entry {
+        unsigned long long size = 0;
+        long long mtimeNs = 0;
+        unsigned long long hash = 0;
+    };
+
+    static std::string key(const std::string &mode, const std::string &path) { return mode + '\t' + path; }
+
+    mutable std::mutex mtx_;
+    std::string path_;
+    std::unordered_map<std::string, Entry> entries_;
+    FILE *out_ = nullptr;
+};
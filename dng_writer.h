@@ -0,0 +1,125 @@
+// Écriture d'une image Bayer en DNG (sans dématriçage)
+//
+// Le DNG est un TIFF dont l'IFD principal contient la mosaïque brute (CFA, 1 échantillon
+// 16-bit par pixel) et les informations nécessaires au développement : motif Bayer,
+// niveaux de noir et de blanc, matrice couleur, balance des blancs à la prise de vue,
+// temps d'exposition et gain. La compression standard est le JPEG sans perte
+// (lossless_jpeg.h), les bandes étant compressées en parallèle par TiffWriter.
+//
+// La matrice couleur est une approximation (XYZ D65 -> sRGB linéaire), l'IMX708
+// n'ayant pas de profil publié ; la balance des blancs reprend les gains figés au vol.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "raw_reader.h"
+#include "tiff_writer.h"
+
+struct DngMetadata {
+    std::string make = "Raspberry Pi";
+    std::string model = "Camera Module 3";
+    std::string pattern = "BGGR";
+    uint32_t blackLevel = 64;    // IMX708 en 10 bits
+    uint32_t whiteLevel = 1023;
+    double exposureUs = 0.0;     // 0 = inconnu
+    double analogueGain = 0.0;
+    double redGain = 0.0;        // gains couleur de la balance des blancs figée
+    double blueGain = 0.0;
+    std::string description;
+    std::string dateTime;        // "AAAA:MM:JJ HH:MM:SS"
+};
+
+// Lit la ligne y de la mosaïque (valeurs entre noir et blanc)
+using DngRowFn = std::function<bool(unsigned y, uint16_t *dst)>;
+
+inline bool writeDng(const std::string &path, unsigned width, unsigned height, const DngRowFn &readRow,
+                     const DngMetadata &meta, TiffCompression compression = TiffCompression::LosslessJpeg,
+                     unsigned threads = 1)
+{
+    // Le JPEG sans perte est la seule compression d'entiers reconnue par tous les lecteurs DNG
+    if (compression != TiffCompression::None && compression != TiffCompression::LosslessJpeg)
+        return false;
+
+    TiffWriter::Image image;
+    image.width = width;
+    image.height = height;
+    image.samples = 1;
+    image.photometric = 32803; // CFA
+    image.compression = compression;
+    image.predictor = false;
+
+    TiffWriter tiff;
+    if (!tiff.open(path, image))
+        return false;
+
+    tiff.addLong(254, 0); // image principale
+    if (!meta.description.empty())
+        tiff.addAscii(270, meta.description);
+    tiff.addAscii(271, meta.make);
+    tiff.addAscii(272, meta.model);
+    tiff.addAscii(305, "nat_convert");
+    if (meta.dateTime.size() == 19)
+        tiff.addAscii(306, meta.dateTime);
+
+    // Motif CFA : 0 = rouge, 1 = vert, 2 = bleu
+    BayerLayout layout = bayerLayout(meta.pattern);
+    uint16_t dim[2] = {2, 2};
+    uint8_t cfa[4];
+    cfa[layout.r[0] * 2 + layout.r[1]] = 0;
+    cfa[layout.g1[0] * 2 + layout.g1[1]] = 1;
+    cfa[layout.g2[0] * 2 + layout.g2[1]] = 1;
+    cfa[layout.b[0] * 2 + layout.b[1]] = 2;
+    tiff.addTag(33421, TIFF_SHORT, 2, dim, sizeof(dim));
+    tiff.addTag(33422, TIFF_BYTE, 4, cfa, sizeof(cfa));
+
+    if (meta.exposureUs > 0.0) {
+        uint32_t exposure[2] = {static_cast<uint32_t>(std::lround(meta.exposureUs)), 1000000};
+        tiff.addTag(33434, TIFF_RATIONAL, 1, exposure, sizeof(exposure));
+    }
+    if (meta.analogueGain > 0.0)
+        tiff.addShort(34855, static_cast<uint16_t>(std::lround(meta.analogueGain * 100)));
+
+    uint8_t version[4] = {1, 4, 0, 0};
+    uint8_t backward[4] = {1, 1, 0, 0};
+    tiff.addTag(50706, TIFF_BYTE, 4, version, sizeof(version));
+    tiff.addTag(50707, TIFF_BYTE, 4, backward, sizeof(backward));
+    tiff.addAscii(50708, meta.make + " " + meta.model);
+    uint8_t planeColor[3] = {0, 1, 2};
+    tiff.addTag(50710, TIFF_BYTE, 3, planeColor, sizeof(planeColor));
+    tiff.addShort(50711, 1); // CFA rectangulaire
+    tiff.addLong(50714, meta.blackLevel);
+    tiff.addLong(50717, meta.whiteLevel);
+
+    // ColorMatrix1 : XYZ -> caméra, approchée par XYZ (D65) -> sRGB linéaire
+    static const double xyzToCamera[9] = {3.2406, -1.5372, -0.4986,
+                                          -0.9689, 1.8758, 0.0415,
+                                          0.0557, -0.2040, 1.0570};
+    int32_t matrix[18];
+    for (int i = 0; i < 9; i++) {
+        matrix[2 * i] = static_cast<int32_t>(std::lround(xyzToCamera[i] * 10000));
+        matrix[2 * i + 1] = 10000;
+    }
+    tiff.addTag(50721, TIFF_SRATIONAL, 9, matrix, sizeof(matrix));
+    tiff.addShort(50778, 21); // illuminant D65
+
+    if (meta.redGain > 0.0 && meta.blueGain > 0.0) {
+        uint32_t neutral[6] = {static_cast<uint32_t>(std::lround(1e6 / meta.redGain)), 1000000,
+                               1000000, 1000000,
+                               static_cast<uint32_t>(std::lround(1e6 / meta.blueGain)), 1000000};
+        tiff.addTag(50728, TIFF_RATIONAL, 3, neutral, sizeof(neutral));
+    }
+
+    auto fill = [&](unsigned y0, unsigned rows, uint16_t *dst) -> bool {
+        for (unsigned r = 0; r < rows; r++) {
+            if (!readRow(y0 + r, dst + static_cast<size_t>(r) * width))
+                return false;
+        }
+        return true;
+    };
+    bool ok = tiff.writeStrips(fill, threads);
+    return tiff.close() && ok;
+}
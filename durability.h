@@ -0,0 +1,226 @@
+// Politique de durabilité des fichiers écrits (remplace le "sync" global)
+//
+//   none   : rien n'est forcé, le noyau écrit quand il veut (risque de perte au débranchement)
+//   file   : fdatasync() de chaque fichier avant de passer au suivant (lent sur clé USB)
+//   behind : écriture différée -- sync_file_range() lance l'écriture de chaque fichier
+//            sans attendre, puis une barrière (fdatasync des fichiers en attente et du
+//            journal + fsync du dossier) est faite toutes les N images ou T ms.
+//
+// Avec "behind", au plus N images (ou T ms d'images) peuvent être perdues si la
+// batterie est retirée. Le retard de durabilité réel est mesuré et rapporté.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+enum class DurabilityMode { None, File, Behind };
+
+struct DurabilityPolicy {
+    DurabilityMode mode = DurabilityMode::Behind;
+    int barrierFrames = 5;    // barrière au plus toutes les N images...
+    int barrierMs = 2000;     // ... ou toutes les T ms
+};
+
+inline bool parseDurabilityMode(const std::string &name, DurabilityMode &mode)
+{
+    if (name == "none")
+        mode = DurabilityMode::None;
+    else if (name == "file")
+        mode = DurabilityMode::File;
+    else if (name == "behind")
+        mode = DurabilityMode::Behind;
+    else
+        return false;
+    return true;
+}
+
+class DurabilityTracker {
+public:
+    static constexpr int MAX_PENDING = 64;        // images
+    static constexpr int MAX_PENDING_FDS = 4 * MAX_PENDING;
+
+    DurabilityTracker() = default;
+    DurabilityTracker(const DurabilityTracker &) = delete;
+    DurabilityTracker &operator=(const DurabilityTracker &) = delete;
+    ~DurabilityTracker() { barrier(); closeDir(); }
+
+    void configure(const DurabilityPolicy &policy, const std::string &directory) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        barrierLocked();
+        closeDir();
+        policy_ = policy;
+        policy_.barrierFrames = std::clamp(policy_.barrierFrames, 1, MAX_PENDING);
+        dirFd_ = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    // Fichier toujours ouvert (journal) synchronisé à chaque barrière, jamais fermé ici
+    void setJournal(int fd) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        journalFd_ = fd;
+    }
+
+    // Un fichier vient d'être entièrement écrit : le tracker prend possession du fd
+    // et le ferme quand ses données sont durables (ou tout de suite en mode none).
+    // Les fichiers d'une même image sont suivis d'un appel à frameDone().
+    void fileWritten(int fd) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        switch (policy_.mode) {
+        case DurabilityMode::None:
+            close(fd);
+            return;
+        case DurabilityMode::File:
+            fdatasync(fd);
+            close(fd);
+            syncDir();
+            return;
+        case DurabilityMode::Behind:
+            // Lance l'écriture sur le support sans attendre la fin
+            sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+            if (pendingFdCount_ == MAX_PENDING_FDS)
+                barrierLocked();
+            if (pendingFdCount_ == 0)
+                oldestPending_ = std::chrono::steady_clock::now();
+            pendingFds_[pendingFdCount_++] = fd;
+            return;
+        }
+    }
+
+    void frameDone() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (policy_.mode == DurabilityMode::File) {
+            // Journal et rename de l'image courante
+            if (journalFd_ >= 0)
+                fdatasync(journalFd_);
+            syncDir();
+            if (onBarrier)
+                onBarrier();
+            return;
+        }
+        if (policy_.mode != DurabilityMode::Behind || pendingFdCount_ == 0)
+            return;
+        pendingCount_++;
+        pendingFrames_.store(pendingCount_, std::memory_order_relaxed);
+        pollLocked();
+    }
+
+    // À appeler régulièrement (même sans nouvelle image) pour respecter la borne en temps
+    void poll() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        pollLocked();
+    }
+
+    // Rend durables tous les fichiers en attente (fin de session, arrêt)
+    void barrier() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        barrierLocked();
+    }
+
+    void resetStats() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        lastLagMs_ = maxLagMs_ = 0;
+        maxLagFrames_ = 0;
+        barriers_ = 0;
+    }
+
+    // Lecture depuis un autre thread (statistiques)
+    int pendingFrames() const { return pendingFrames_.load(std::memory_order_relaxed); }
+    int64_t lastLagMs() const { return lastLagMs_.load(std::memory_order_relaxed); }
+    int64_t maxLagMs() const { return maxLagMs_.load(std::memory_order_relaxed); }
+    int maxLagFrames() const { return maxLagFrames_.load(std::memory_order_relaxed); }
+    uint64_t barriers() const { return barriers_.load(std::memory_order_relaxed); }
+    const DurabilityPolicy &policy() const { return policy_; }
+
+    // Après chaque barrière effective (et chaque image en mode file), appelé sous le verrou
+    // du tracker depuis le thread qui l'a déclenchée : ne doit pas rappeler le tracker
+    std::function<void()> onBarrier;
+
+private:
+    void pollLocked() {
+        if (pendingFdCount_ == 0)
+            return;
+        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - oldestPending_).count();
+        if (pendingCount_ >= policy_.barrierFrames || pendingCount_ >= MAX_PENDING ||
+            age >= policy_.barrierMs)
+            barrierLocked();
+    }
+
+    void barrierLocked() {
+        if (pendingFdCount_ == 0)
+            return;
+        for (int i = 0; i < pendingFdCount_; i++) {
+            fdatasync(pendingFds_[i]);
+            close(pendingFds_[i]);
+        }
+        if (journalFd_ >= 0)
+            fdatasync(journalFd_);
+        syncDir();
+
+        auto lag = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - oldestPending_).count();
+        lastLagMs_.store(lag, std::memory_order_relaxed);
+        if (lag > maxLagMs_.load(std::memory_order_relaxed))
+            maxLagMs_.store(lag, std::memory_order_relaxed);
+        if (pendingCount_ > maxLagFrames_.load(std::memory_order_relaxed))
+            maxLagFrames_.store(pendingCount_, std::memory_order_relaxed);
+        pendingCount_ = 0;
+        pendingFdCount_ = 0;
+        pendingFrames_.store(0, std::memory_order_relaxed);
+        barriers_.fetch_add(1, std::memory_order_relaxed);
+        if (onBarrier)
+            onBarrier();
+    }
+
+    void syncDir() {
+        // Les nouvelles entrées de répertoire doivent aussi survivre à une coupure
+        if (dirFd_ >= 0)
+            fsync(dirFd_);
+    }
+
+    void closeDir() {
+        if (dirFd_ >= 0)
+            close(dirFd_);
+        dirFd_ = -1;
+    }
+
+    std::mutex mtx_;
+    DurabilityPolicy policy_;
+    int dirFd_ = -1;
+    int journalFd_ = -1;
+    int pendingFds_[MAX_PENDING_FDS];
+    int pendingFdCount_ = 0;
+    int pendingCount_ = 0; // images complètes en attente
+    std::chrono::steady_clock::time_point oldestPending_;
+
+    std::atomic<int> pendingFrames_{0};
+    std::atomic<int64_t> lastLagMs_{0};
+    std::atomic<int64_t> maxLagMs_{0};
+    std::atomic<int> maxLagFrames_{0};
+    std::atomic<uint64_t> barriers_{0};
+};
+
+// Nombre d'images finales dont l'enregistrement de journal peut être sur le support
+// sans leurs données après une coupure : recover() doit les relire en entier.
+// 0 = pas de borne (none : tout le dossier est relu)
+inline int unsyncedFrameBound(const DurabilityPolicy &policy)
+{
+    switch (policy.mode) {
+    case DurabilityMode::None:
+        return 0;
+    case DurabilityMode::File:
+        return 1; // données synchronisées avant l'enregistrement : seule l'image en cours
+    case DurabilityMode::Behind:
+        // images en attente de barrière, plus celle en cours d'écriture
+        return std::clamp(policy.barrierFrames, 1, DurabilityTracker::MAX_PENDING) + 1;
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Filtre anti-parasites des lignes d'impulsion et de PPS, à partir des ticks des fronts
+//
+// Un front montant est accepté ou rejeté dès son arrivée, avec ce qui est déjà connu :
+//   - période : il suit le dernier front accepté d'au moins minPeriodUs ;
+//   - niveau bas : la ligne était basse depuis au moins minWidthUs (rebond d'un front) ;
+//   - PPS : il tombe à un nombre entier de périodes attendues (1 s) du dernier front
+//     accepté, à toleranceUs près ; un écart de plusieurs périodes (PPS perdu) est
+//     accepté et compté à part, avec une tolérance élargie de la dérive possible.
+// Un front valide ne subit donc aucun retard. La largeur d'une impulsion n'est connue
+// qu'au front descendant, et un front descendant suivi d'un front montant moins de
+// minWidthUs plus tard n'est qu'une oscillation du début de l'impulsion, qui continue.
+// Une impulsion acceptée plus courte que minWidthUs n'est donc révoquée qu'une fois la
+// ligne restée basse minWidthUs : settle() le constate au front suivant ou au délai de
+// garde de la source (TRIGGER_TIMEOUT), et l'appelant annule son effet s'il le peut
+// encore. undecided() dit si la dernière impulsion acceptée peut encore être révoquée,
+// et decisionTick() quand elle ne le pourra plus.
+// Un seul thread (celui de la source de fronts) appelle settle/rising/falling.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct EdgeFilterConfig {
+    uint32_t minWidthUs = 0;       // largeur haute (et basse) minimale, 0 = pas de contrôle
+    uint32_t minPeriodUs = 0;      // écart minimal entre deux fronts montants acceptés
+    uint32_t expectedPeriodUs = 0; // période attendue (PPS), 0 = libre
+    uint32_t toleranceUs = 0;      // écart admis autour des multiples de la période attendue
+};
+
+enum class EdgeVerdict { Accepted, Rejected, Revoked, None };
+
+struct EdgeFilterStats {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> rejectedPeriod{0}; // trop proche du précédent (ou hors période PPS)
+    std::atomic<uint64_t> rejectedLow{0};    // ligne pas restée basse assez longtemps
+    std::atomic<uint64_t> revokedWidth{0};   // impulsion trop courte, vue au front descendant
+    std::atomic<uint64_t> gaps{0};           // PPS : une ou plusieurs périodes manquantes
+
+    uint64_t rejected() const { return rejectedPeriod + rejectedLow + revokedWidth; }
+
+    void reset() {
+        accepted = rejectedPeriod = rejectedLow = revokedWidth = gaps = 0;
+    }
+};
+
+class EdgeFilter {
+public:
+    void configure(const EdgeFilterConfig &config) {
+        config_ = config;
+        reset();
+    }
+
+    // Nouvelle session : pas d'historique (le premier front est toujours accepté).
+    // Peut être appelé depuis un autre thread : l'historique est effacé au front suivant
+    void reset() {
+        stats.reset();
+        resetRequested_ = true;
+    }
+
+    // À appeler avant rising/falling : révoque l'impulsion trop courte dont la ligne est
+    // restée basse au moins minWidthUs (Revoked), sinon None
+    EdgeVerdict settle(uint32_t tick) {
+        applyReset();
+        if (!shortFall_ || high_ || tick - fallTick_ < config_.minWidthUs)
+            return EdgeVerdict::None;
+        // Impulsion acceptée mais trop courte : l'historique revient au précédent
+        shortFall_ = false;
+        lastAccepted_ = previousAccepted_;
+        haveAccepted_ = hadPrevious_;
+        stats.accepted--;
+        stats.revokedWidth++;
+        return EdgeVerdict::Revoked;
+    }
+
+    EdgeVerdict rising(uint32_t tick) {
+        settle(tick); // déjà fait par l'appelant, sans effet la seconde fois
+        if (high_)
+            return EdgeVerdict::None; // deux fronts montants de suite : rien à décider
+        high_ = true;
+        if (shortFall_) {
+            // Oscillation du front montant : l'impulsion acceptée continue
+            shortFall_ = false;
+            pending_ = true;
+            return EdgeVerdict::None;
+        }
+        riseTick_ = tick;
+        pending_ = false;
+
+        if (config_.minWidthUs && haveFall_ && tick - fallTick_ < config_.minWidthUs) {
+            stats.rejectedLow++;
+            return EdgeVerdict::Rejected;
+        }
+        if (haveAccepted_) {
+            uint32_t since = tick - lastAccepted_;
+            if (since < config_.minPeriodUs) {
+                stats.rejectedPeriod++;
+                return EdgeVerdict::Rejected;
+            }
+            if (config_.expectedPeriodUs) {
+                uint32_t periods = (since + config_.expectedPeriodUs / 2) / config_.expectedPeriodUs;
+                uint32_t nearest = periods * config_.expectedPeriodUs;
+                uint32_t error = since > nearest ? since - nearest : nearest - since;
+                // Après un trou, la dérive du quartz local s'ajoute (100 ppm par période)
+                uint32_t allowed = config_.toleranceUs + (periods > 1 ? (periods - 1) * (config_.expectedPeriodUs / 10000) : 0);
+                if (periods == 0 || error > allowed) {
+                    stats.rejectedPeriod++;
+                    return EdgeVerdict::Rejected;
+                }
+                if (periods > 1)
+                    stats.gaps++;
+            }
+        }
+        previousAccepted_ = lastAccepted_;
+        hadPrevious_ = haveAccepted_;
+        lastAccepted_ = tick;
+        haveAccepted_ = true;
+        pending_ = true;
+        stats.accepted++;
+        return EdgeVerdict::Accepted;
+    }
+
+    // Ne révoque jamais directement : une impulsion trop courte attend settle()
+    EdgeVerdict falling(uint32_t tick) {
+        applyReset();
+        if (!high_)
+            return EdgeVerdict::None;
+        high_ = false;
+        fallTick_ = tick;
+        haveFall_ = true;
+        shortFall_ = pending_ && config_.minWidthUs && tick - riseTick_ < config_.minWidthUs;
+        pending_ = false;
+        return EdgeVerdict::None;
+    }
+
+    // Vrai tant que la dernière impulsion acceptée peut être révoquée : ligne haute depuis
+    // moins de minWidthUs, ou retombée trop tôt sans être restée basse minWidthUs
+    bool undecided(uint32_t tick) const {
+        if (!config_.minWidthUs)
+            return false;
+        return shortFall_ || (pending_ && high_ && tick - riseTick_ < config_.minWidthUs);
+    }
+
+    // Tick où l'impulsion en cours sera tranchée, si aucun front ne vient d'ici là
+    uint32_t decisionTick() const {
+        return (shortFall_ ? fallTick_ : riseTick_) + config_.minWidthUs;
+    }
+
+    // Tick du dernier front accepté (après une révocation : celui d'avant)
+    uint32_t lastAccepted() const { return lastAccepted_; }
+    const EdgeFilterConfig &config() const { return config_; }
+
+    EdgeFilterStats stats;
+
+private:
+    void applyReset() {
+        if (!resetRequested_.exchange(false, std::memory_order_acquire))
+            return;
+        pending_ = shortFall_ = false;
+        haveAccepted_ = haveFall_ = false;
+    }
+
+    EdgeFilterConfig config_;
+    std::atomic<bool> resetRequested_{false};
+    bool high_ = false;
+    bool pending_ = false;     // front montant accepté, largeur pas encore connue
+    bool shortFall_ = false;   // retombée trop tôt : oscillation ou impulsion à révoquer
+    bool haveAccepted_ = false, hadPrevious_ = false, haveFall_ = false;
+    uint32_t riseTick_ = 0, fallTick_ = 0;
+    uint32_t lastAccepted_ = 0, previousAccepted_ = 0;
+};
+
+// "largeur_us,période_us" (impulsions) ou "largeur_us,tolérance_us" (PPS) ; "off" désactive
+inline bool parseEdgeFilter(const std::string &spec, EdgeFilterConfig &config, bool pps)
+{
+    if (spec == "off") {
+        config = EdgeFilterConfig();
+        return true;
+    }
+    unsigned a, b;
+    char extra;
+    if (sscanf(spec.c_str(), "%u,%u%c", &a, &b, &extra) != 2)
+        return false;
+    config.minWidthUs = a;
+    if (pps) {
+        config.expectedPeriodUs = 1000000;
+        config.toleranceUs = b;
+        config.minPeriodUs = 0;
+    } else {
+        config.minPeriodUs = b;
+    }
+    return true;
+}
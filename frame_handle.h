@@ -0,0 +1,216 @@
+// Prêt sans copie des FrameBuffer libcamera aux étages en aval (écriture, etc.)
+//
+// Chaque buffer caméra est mappé une seule fois au démarrage. Quand une requête
+// se termine, le buffer est "prêté" sous forme de FrameHandle : les étages en aval
+// lisent directement la mémoire mappée, sans memcpy. Le compteur de références est
+// intrusif (pas d'allocation par image) ; quand le dernier FrameHandle est relâché,
+// la requête est rendue au prêteur et peut être remise en file pour une nouvelle photo.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include <libcamera/libcamera.h>
+
+class FrameLender;
+
+// Informations attachées à une image prêtée (remplies au déclenchement puis à la complétion)
+struct FrameLease {
+    libcamera::Request *request = nullptr;
+    const uint8_t *data = nullptr; // mapping permanent du plan 0
+    size_t size = 0;
+    size_t mapLength = 0;
+    size_t capacity = 0;    // bail mémoire (addMemory) : taille de la zone
+
+    int pulse = 0;          // numéro d'impulsion au déclenchement
+    int clk = 0;            // clock externe (PPS) au déclenchement
+    uint32_t tick = 0;      // tick interne au déclenchement
+    uint32_t ppsTick = 0;   // tick interne du dernier front PPS (fraction de seconde)
+    bool holdover = false;  // PPS absent : clk et ppsTick extrapolés
+    uint32_t timeErrorUs = 0; // incertitude estimée sur l'heure
+    uint64_t sensorTimestamp = 0;
+    unsigned sequence = 0;
+    char name[48] = {};     // "photo_..." sans extension, formaté au déclenchement
+    bool calibration = false; // requête de convergence AE/AWB, jamais écrite
+
+    std::atomic<int> refs{0};
+    FrameLender *owner = nullptr;
+};
+
+// Poignée à compteur de références sur une image prêtée
+class FrameHandle {
+public:
+    FrameHandle() = default;
+    explicit FrameHandle(FrameLease *lease) : lease_(lease) { acquire(); }
+    FrameHandle(const FrameHandle &other) : lease_(other.lease_) { acquire(); }
+    FrameHandle(FrameHandle &&other) noexcept : lease_(other.lease_) { other.lease_ = nullptr; }
+    ~FrameHandle() { reset(); }
+
+    FrameHandle &operator=(const FrameHandle &other) {
+        if (this != &other) {
+            reset();
+            lease_ = other.lease_;
+            acquire();
+        }
+        return *this;
+    }
+
+    FrameHandle &operator=(FrameHandle &&other) noexcept {
+        if (this != &other) {
+            reset();
+            lease_ = other.lease_;
+            other.lease_ = nullptr;
+        }
+        return *this;
+    }
+
+    void reset();
+
+    explicit operator bool() const { return lease_ != nullptr; }
+    const FrameLease *operator->() const { return lease_; }
+    const FrameLease &lease() const { return *lease_; }
+    const uint8_t *data() const { return lease_->data; }
+    size_t size() const { return lease_->size; }
+
+private:
+    void acquire() {
+        if (lease_)
+            lease_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    FrameLease *lease_ = nullptr;
+};
+
+// Propriétaire des baux : un par requête, créé au démarrage
+class FrameLender {
+public:
+    ~FrameLender() {
+        for (FrameLease &lease : leases_) {
+            if (lease.data && lease.mapLength)
+                munmap(const_cast<uint8_t *>(lease.data), lease.mapLength);
+        }
+    }
+
+    // Enregistre une requête et mappe son buffer une fois pour toutes
+    bool add(libcamera::Request *request, libcamera::FrameBuffer *buffer) {
+        const libcamera::FrameBuffer::Plane &plane = buffer->planes()[0];
+        size_t mapLength = plane.offset + plane.length;
+        void *mem = mmap(nullptr, mapLength, PROT_READ, MAP_SHARED, plane.fd.get(), 0);
+        if (mem == MAP_FAILED)
+            return false;
+
+        leases_.emplace_back();
+        FrameLease &lease = leases_.back();
+        lease.request = request;
+        lease.data = static_cast<const uint8_t *>(mem) + plane.offset;
+        lease.size = plane.length;
+        lease.mapLength = mapLength;
+        lease.owner = this;
+        free_.push_back(&lease);
+        return true;
+    }
+
+    // Bail sans caméra sur une mémoire fournie par l'appelant (pool de copies, bancs
+    // d'essai) : pas de requête à remettre en file, la mémoire n'est pas libérée ici
+    void addMemory(uint8_t *data, size_t size) {
+        leases_.emplace_back();
+        FrameLease &lease = leases_.back();
+        lease.data = data;
+        lease.size = size;
+        lease.capacity = size;
+        lease.owner = this;
+        free_.push_back(&lease);
+    }
+
+    // Prend une requête libre pour un déclenchement, nullptr si toutes sont prêtées
+    FrameLease *take() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (free_.empty())
+            return nullptr;
+        FrameLease *lease = free_.back();
+        free_.pop_back();
+        return lease;
+    }
+
+    // Copie une image dans un bail mémoire libre, avec ses informations de prise de vue :
+    // la requête d'origine peut être rendue tout de suite. nullptr si aucun ne convient
+    FrameLease *takeCopy(const FrameLease &from) {
+        FrameLease *lease = take();
+        if (!lease)
+            return nullptr;
+        if (lease->request || from.size > lease->capacity) {
+            giveBack(lease);
+            return nullptr;
+        }
+        // Zone fournie en écriture à addMemory
+        memcpy(const_cast<uint8_t *>(lease->data), from.data, from.size);
+        lease->size = from.size;
+        lease->pulse = from.pulse;
+        lease->clk = from.clk;
+        lease->tick = from.tick;
+        lease->ppsTick = from.ppsTick;
+        lease->holdover = from.holdover;
+        lease->timeErrorUs = from.timeErrorUs;
+        lease->sensorTimestamp = from.sensorTimestamp;
+        lease->sequence = from.sequence;
+        memcpy(lease->name, from.name, sizeof(lease->name));
+        lease->calibration = false;
+        return lease;
+    }
+
+    // Nombre de baux libres (aucune requête en vol ni image en écriture)
+    size_t available() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return free_.size();
+    }
+
+    // Retrouve le bail d'une requête terminée
+    FrameLease *find(const libcamera::Request *request) {
+        for (FrameLease &lease : leases_) {
+            if (lease.request == request)
+                return &lease;
+        }
+        return nullptr;
+    }
+
+    // Rend une requête au prêteur (dernier FrameHandle relâché, requête annulée...)
+    void giveBack(FrameLease *lease) {
+        if (lease->request)
+            lease->request->reuse(libcamera::Request::ReuseBuffers);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            free_.push_back(lease);
+        }
+        cv_.notify_all();
+    }
+
+    // Attend que tous les baux soient revenus (fin de session)
+    void waitAllReturned() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return free_.size() == leases_.size(); });
+    }
+
+    size_t count() const { return leases_.size(); }
+
+private:
+    std::deque<FrameLease> leases_; // deque : adresses stables
+    std::vector<FrameLease *> free_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+inline void FrameHandle::reset()
+{
+    if (lease_ && lease_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        lease_->owner->giveBack(lease_);
+    lease_ = nullptr;
+}
@@ -0,0 +1,312 @@
+// Journal d'écriture des images, pour retrouver un dossier cohérent après une coupure
+//
+// Protocole pour chaque image :
+//   1. écriture des données dans "X.raw.part" (O_TRUNC : jamais de reste d'un ancien fichier)
+//   2. écriture de "X.raw.info" (avec longueur et somme de contrôle)
+//   3. ajout d'un enregistrement de taille fixe dans journal.bin (nom, longueur, somme)
+//   4. rename("X.raw.part", "X.raw") : un .raw visible est toujours une image validée
+//
+// Au démarrage, recover() parcourt le dossier : les .part dont l'enregistrement existe
+// et dont la somme est bonne sont renommés (réparés), les autres fichiers incomplets ou
+// non journalisés sont déplacés dans "recuperation/" (jamais supprimés). Seules les
+// dernières images du journal, celles qui pouvaient encore attendre une barrière de
+// durabilité (unsyncedFrameBound, durability.h), sont relues entièrement ; les autres
+// sont vérifiées par leur taille : le scan reste rapide même avec des milliers d'images.
+// La borne est celle des options courantes : relancer avec la même politique --sync.
+// Une fois le dossier vérifié et synchronisé (syncfs), recover() ajoute un point de
+// contrôle au journal : les images d'avant ne sont plus relues (borne de --sync=none).
+// Les .raw plus anciens que le journal (écrits avant sa mise en place) sont adoptés
+// s'ils correspondent à leur .info (taille, somme si elle y figure), pas mis de côté.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char *const JOURNAL_NAME = "journal.bin";
+static const char *const RECOVERY_DIR = "recuperation";
+
+// Somme de contrôle rapide (type Fletcher sur des mots de 64 bits), limitée par la bande passante mémoire
+inline uint64_t frameChecksum(const uint8_t *data, size_t size)
+{
+    uint64_t a = 0x9E3779B97F4A7C15ULL;
+    uint64_t b = size;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; i++) {
+        uint64_t w;
+        memcpy(&w, data + i * 8, 8);
+        a += w;
+        b += a;
+    }
+    for (size_t i = words * 8; i < size; i++) {
+        a += data[i];
+        b += a;
+    }
+    return a ^ (b * 0xFF51AFD7ED558CCDULL);
+}
+
+struct JournalRecord {
+    uint32_t magic;      // 'NATJ'
+    uint32_t version;
+    uint64_t length;
+    uint64_t checksum;
+    char name[96];       // nom du .raw, relatif au dossier
+    uint64_t recordSum;  // somme de l'enregistrement lui-même (enregistrement tronqué = rejeté)
+};
+static_assert(sizeof(JournalRecord) == 128, "enregistrement de journal de taille fixe");
+
+static const uint32_t JOURNAL_MAGIC = 0x4A54414E; // "NATJ"
+static const uint32_t CHECKPOINT_MAGIC = 0x4B54414E; // "NATK" : tout ce qui précède est vérifié et durable
+static const uint32_t ADOPTED_VERSION = 2; // .raw antérieur au journal : somme inconnue si 0
+
+inline uint64_t recordSum(const JournalRecord &rec)
+{
+    return frameChecksum(reinterpret_cast<const uint8_t *>(&rec), offsetof(JournalRecord, recordSum));
+}
+
+struct RecoveryReport {
+    int verified = 0;   // images validées
+    int repaired = 0;   // .part complets renommés
+    int quarantined = 0; // fichiers déplacés dans recuperation/
+    int adopted = 0;    // .raw antérieurs au journal, vérifiés d'après leur .info
+};
+
+class FrameJournal {
+public:
+    ~FrameJournal() { close(); }
+
+    bool open(const std::string &directory) {
+        close();
+        dir_ = directory;
+        if (!dir_.empty() && dir_.back() != '/')
+            dir_ += '/';
+        fd_ = ::open((dir_ + JOURNAL_NAME).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+        return fd_ >= 0;
+    }
+
+    void close() {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    int fd() const { return fd_; }
+
+    // Valide une image (étape 3) ; le rename (étape 4) est fait par l'appelant
+    bool commit(const char *name, uint64_t length, uint64_t checksum) {
+        size_t n = strlen(name);
+        if (fd_ < 0 || n >= sizeof(JournalRecord::name))
+            return false;
+        JournalRecord rec = {};
+        rec.magic = JOURNAL_MAGIC;
+        rec.version = 1;
+        rec.length = length;
+        rec.checksum = checksum;
+        memcpy(rec.name, name, n);
+        rec.recordSum = recordSum(rec);
+        return ::write(fd_, &rec, sizeof(rec)) == static_cast<ssize_t>(sizeof(rec));
+    }
+
+    // Remet le dossier dans un état cohérent ; verifyLast = nombre d'images finales relues
+    // en entier (unsyncedFrameBound), 0 = toutes
+    static RecoveryReport recover(const std::string &directory, int verifyLast) {
+        RecoveryReport report;
+        std::string dir = directory;
+        if (!dir.empty() && dir.back() != '/')
+            dir += '/';
+
+        // Lecture du journal ; un enregistrement final tronqué ou invalide est coupé
+        std::vector<JournalRecord> records;
+        std::string journalPath = dir + JOURNAL_NAME;
+        size_t validRecords = 0;
+        size_t checkpoint = 0; // images couvertes par le dernier point de contrôle
+        int jfd = ::open(journalPath.c_str(), O_RDWR | O_CLOEXEC);
+        // Naissance du journal : un .raw modifié avant ne peut pas y figurer
+        bool haveJournal = jfd >= 0;
+        struct statx sx = {};
+        bool haveBirth = haveJournal && statx(jfd, "", AT_EMPTY_PATH, STATX_BTIME, &sx) == 0 &&
+                         (sx.stx_mask & STATX_BTIME);
+        if (jfd >= 0) {
+            JournalRecord rec;
+            while (::read(jfd, &rec, sizeof(rec)) == static_cast<ssize_t>(sizeof(rec)) &&
+                   (rec.magic == JOURNAL_MAGIC || rec.magic == CHECKPOINT_MAGIC) && rec.recordSum == recordSum(rec)) {
+                validRecords++;
+                if (rec.magic == CHECKPOINT_MAGIC)
+                    checkpoint = records.size();
+                else
+                    records.push_back(rec);
+            }
+            if (ftruncate(jfd, validRecords * sizeof(JournalRecord)) != 0)
+                std::cerr << "Journal: impossible de tronquer " << journalPath << std::endl;
+        }
+
+        std::unordered_map<std::string, size_t> index;
+        for (size_t i = 0; i < records.size(); i++) {
+            records[i].name[sizeof(records[i].name) - 1] = '\0';
+            index[records[i].name] = i;
+        }
+        size_t firstFullCheck = verifyLast > 0 && records.size() > static_cast<size_t>(verifyLast)
+                                    ? records.size() - verifyLast : 0;
+        firstFullCheck = std::max(firstFullCheck, checkpoint);
+
+        std::vector<std::string> names;
+        DIR *d = opendir(dir.c_str());
+        if (!d) {
+            if (jfd >= 0)
+                ::close(jfd);
+            return report;
+        }
+        while (dirent *e = readdir(d))
+            names.push_back(e->d_name);
+        closedir(d);
+
+        std::vector<JournalRecord> adopted;
+
+        for (const std::string &name : names) {
+            bool part = endsWith(name, ".raw.part");
+            if (!part && !endsWith(name, ".raw"))
+                continue;
+
+            std::string rawName = part ? name.substr(0, name.size() - 5) : name;
+            auto it = index.find(rawName);
+            bool ok = false;
+            if (it != index.end()) {
+                const JournalRecord &rec = records[it->second];
+                bool fullCheck = part || it->second >= firstFullCheck;
+                ok = fileMatches(dir + name, rec, fullCheck);
+            }
+
+            JournalRecord legacy;
+            if (!ok && !part && (!haveJournal || (haveBirth && olderThan(dir + name, sx.stx_btime))) &&
+                adoptLegacy(dir, name, legacy)) {
+                adopted.push_back(legacy);
+                report.adopted++;
+            } else if (ok && part) {
+                if (::rename((dir + name).c_str(), (dir + rawName).c_str()) == 0)
+                    report.repaired++;
+            } else if (ok) {
+                report.verified++;
+            } else {
+                quarantine(dir, name);
+                struct stat st;
+                if (stat((dir + rawName + ".info").c_str(), &st) == 0)
+                    quarantine(dir, rawName + ".info");
+                report.quarantined++;
+            }
+        }
+
+        // Point de contrôle quand des images ont été vérifiées depuis le précédent :
+        // données et renommages d'abord rendus durables
+        bool progress = records.size() > checkpoint || !adopted.empty() || report.repaired > 0;
+        if (progress && jfd < 0)
+            jfd = ::open(journalPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (progress && jfd >= 0 && syncfs(jfd) == 0) {
+            JournalRecord mark = {};
+            mark.magic = CHECKPOINT_MAGIC;
+            mark.version = 1;
+            mark.recordSum = recordSum(mark);
+            adopted.push_back(mark);
+            size_t bytes = adopted.size() * sizeof(JournalRecord);
+            if (pwrite(jfd, adopted.data(), bytes, validRecords * sizeof(JournalRecord)) != static_cast<ssize_t>(bytes) ||
+                fdatasync(jfd) != 0)
+                std::cerr << "Journal: point de contrôle impossible dans " << journalPath << std::endl;
+        }
+        if (jfd >= 0)
+            ::close(jfd);
+        return report;
+    }
+
+private:
+    static bool endsWith(const std::string &s, const char *suffix) {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    static bool fileMatches(const std::string &path, const JournalRecord &rec, bool fullCheck) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) == rec.length;
+        if (rec.version == ADOPTED_VERSION && rec.checksum == 0)
+            fullCheck = false; // somme jamais connue
+        if (ok && fullCheck && rec.length > 0) {
+            void *mem = mmap(nullptr, rec.length, PROT_READ, MAP_PRIVATE, fd, 0);
+            ok = mem != MAP_FAILED &&
+                 frameChecksum(static_cast<const uint8_t *>(mem), rec.length) == rec.checksum;
+            if (mem != MAP_FAILED)
+                munmap(mem, rec.length);
+        }
+        ::close(fd);
+        return ok;
+    }
+
+    static bool olderThan(const std::string &path, const struct statx_timestamp &birth) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        return st.st_mtim.tv_sec < birth.tv_sec ||
+               (st.st_mtim.tv_sec == birth.tv_sec && st.st_mtim.tv_nsec < static_cast<long>(birth.tv_nsec));
+    }
+
+    // .raw écrit avant le journal : taille (length, sinon stride x height) et somme du .info
+    static bool adoptLegacy(const std::string &dir, const std::string &name, JournalRecord &rec) {
+        if (name.size() >= sizeof(rec.name))
+            return false;
+        char text[4096];
+        int fd = ::open((dir + name + ".info").c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        ssize_t n = ::read(fd, text, sizeof(text) - 1);
+        ::close(fd);
+        if (n <= 0)
+            return false;
+        text[n] = '\0';
+        uint64_t length = infoValue(text, "length", 10);
+        if (length == 0)
+            length = infoValue(text, "stride", 10) * infoValue(text, "height", 10);
+
+        rec = {};
+        rec.magic = JOURNAL_MAGIC;
+        rec.version = ADOPTED_VERSION;
+        rec.length = length;
+        rec.checksum = infoValue(text, "checksum", 16);
+        memcpy(rec.name, name.c_str(), name.size());
+        rec.recordSum = recordSum(rec);
+        return length > 0 && fileMatches(dir + name, rec, true);
+    }
+
+    // Valeur de "clé=..." en début de ligne, 0 si absente
+    static uint64_t infoValue(const char *text, const char *key, int base) {
+        size_t n = strlen(key);
+        for (const char *line = text; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : nullptr) {
+            if (strncmp(line, key, n) == 0 && line[n] == '=')
+                return strtoull(line + n + 1, nullptr, base);
+        }
+        return 0;
+    }
+
+    static void quarantine(const std::string &dir, const std::string &name) {
+        std::string target = dir + RECOVERY_DIR;
+        mkdir(target.c_str(), 0777);
+        if (::rename((dir + name).c_str(), (target + "/" + name).c_str()) != 0)
+            std::cerr << "Journal: impossible de déplacer " << name << ": " << strerror(errno) << std::endl;
+    }
+
+    std::string dir_;
+    int fd_ = -1;
+};
@@ -0,0 +1,147 @@
+// Métriques de qualité calculées à bord pour chaque image (exposition et netteté)
+//
+// Une grille fixe de quads Bayer 2x2 est lue dans l'image RAW 10-bit CSI2P (octets de
+// poids fort seulement) : le coût ne dépend pas de la résolution. Pour chaque point,
+// un mot de 32 bits par ligne donne deux quads ; les sommes et le comptage des pixels
+// saturés se font en SWAR (quatre octets par opération).
+//   - histogramme de luminance (32 classes) et luminance moyenne ;
+//   - fraction de pixels saturés et de quads très sombres ;
+//   - netteté : énergie du gradient (différence entre quads voisins et entre les deux
+//     verts d'un même quad), moyennée sur les points.
+// Le calcul s'arrête si le budget de temps est dépassé (métriques partielles).
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "text_buffer.h"
+
+static const int METRICS_BINS = 32;
+
+struct FrameMetrics {
+    bool valid = false;     // calcul fait (éventuellement partiel)
+    bool complete = false;  // toute la grille parcourue dans le budget
+    uint32_t samples = 0;   // quads lus
+    uint32_t histogram[METRICS_BINS] = {};
+    double mean = 0.0;      // luminance moyenne sur 8 bits
+    double clipped = 0.0;   // fraction de pixels saturés
+    double dark = 0.0;      // fraction de quads sous 8/255
+    double sharpness = 0.0; // énergie moyenne du gradient
+    uint32_t elapsedUs = 0;
+};
+
+// Nombre d'octets nuls dans un mot de 32 bits (exact, sans branchement)
+inline uint32_t zeroBytes(uint32_t w)
+{
+    uint32_t nonZero = (((w & 0x7F7F7F7F) + 0x7F7F7F7F) | w) & 0x80808080;
+    return 4 - __builtin_popcount(nonZero);
+}
+
+inline bool computeFrameMetrics(const uint8_t *data, size_t size, unsigned width, unsigned height,
+                                unsigned stride, unsigned budgetUs, FrameMetrics &m,
+                                unsigned gridRows = 48, unsigned gridCols = 96)
+{
+    m = FrameMetrics();
+    unsigned groups = width / 4;
+    unsigned quadRows = height / 2;
+    if (groups == 0 || quadRows == 0 || static_cast<size_t>(height) * stride > size)
+        return false;
+    if (gridCols > groups)
+        gridCols = groups;
+    if (gridRows > quadRows)
+        gridRows = quadRows;
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0, energy = 0;
+    uint32_t clippedPixels = 0, darkQuads = 0;
+    unsigned rowsDone = 0;
+
+    for (unsigned i = 0; i < gridRows; i++) {
+        unsigned y = (i * quadRows / gridRows) * 2;
+        const uint8_t *top = data + static_cast<size_t>(y) * stride;
+        const uint8_t *bottom = top + stride;
+
+        for (unsigned j = 0; j < gridCols; j++) {
+            unsigned offset = (j * groups / gridCols) * 5;
+            uint32_t a, b; // a = B G B G, b = G R G R (BGGR)
+            memcpy(&a, top + offset, 4);
+            memcpy(&b, bottom + offset, 4);
+
+            // Somme des 4 pixels de chaque quad, deux voies de 16 bits
+            uint32_t quads = (a & 0x00FF00FF) + ((a >> 8) & 0x00FF00FF) +
+                             (b & 0x00FF00FF) + ((b >> 8) & 0x00FF00FF);
+            int l0 = (quads & 0xFFFF) >> 2;
+            int l1 = (quads >> 16) >> 2;
+            clippedPixels += zeroBytes(~a) + zeroBytes(~b);
+
+            m.histogram[l0 >> 3]++;
+            m.histogram[l1 >> 3]++;
+            sum += l0 + l1;
+            darkQuads += (l0 < 8) + (l1 < 8);
+
+            int dl = l0 - l1;
+            int dg0 = static_cast<int>((a >> 8) & 0xFF) - static_cast<int>(b & 0xFF);
+            int dg1 = static_cast<int>(a >> 24) - static_cast<int>((b >> 16) & 0xFF);
+            energy += dl * dl + dg0 * dg0 + dg1 * dg1;
+        }
+        rowsDone++;
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (elapsed > static_cast<long long>(budgetUs) && rowsDone < gridRows)
+            break;
+    }
+
+    m.samples = rowsDone * gridCols * 2;
+    m.valid = m.samples > 0;
+    m.complete = rowsDone == gridRows;
+    if (m.valid) {
+        m.mean = static_cast<double>(sum) / m.samples;
+        m.clipped = static_cast<double>(clippedPixels) / (m.samples * 4);
+        m.dark = static_cast<double>(darkQuads) / m.samples;
+        m.sharpness = static_cast<double>(energy) / m.samples;
+    }
+    m.elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return m.valid;
+}
+
+// Alerte d'après les métriques ; sharpnessRef = netteté habituelle de la session (0 = inconnue)
+inline const char *classifyFrame(const FrameMetrics &m, double sharpnessRef)
+{
+    if (!m.valid)
+        return "";
+    if (m.clipped > 0.02)
+        return "surexposee";
+    if (m.mean < 12.0 || m.dark > 0.5)
+        return "sousexposee";
+    if (sharpnessRef > 0.0 && m.sharpness < 0.5 * sharpnessRef)
+        return "floue";
+    return "ok";
+}
+
+// Lignes "clé=valeur" ajoutées au .info de l'image
+inline void appendMetricsInfo(TextBuffer &info, const FrameMetrics &m, const char *alert)
+{
+    if (!m.valid) {
+        info.add("metrics=skipped\n");
+        return;
+    }
+    info.line("metrics", m.complete ? "complete" : "partial");
+    info.line("metrics_samples", m.samples);
+    info.line("metrics_mean", m.mean);
+    info.line("metrics_clipped", m.clipped);
+    info.line("metrics_dark", m.dark);
+    info.line("metrics_sharpness", m.sharpness);
+    info.line("metrics_alert", alert);
+    info.add("metrics_histogram=");
+    for (int i = 0; i < METRICS_BINS; i++) {
+        if (i)
+            info.add(';');
+        info.addUInt(m.histogram[i]);
+    }
+    info.add('\n');
+}
@@ -0,0 +1,178 @@
+// Pool d'images préallouées pour les étages qui ont besoin d'une copie CPU
+// (compression, aperçus...).
+//
+// Toute la mémoire est réservée au démarrage en un seul mmap anonyme, verrouillée
+// en RAM (mlock) et pré-touchée : pendant la capture il n'y a plus ni appel à
+// l'allocateur ni défaut de page. Les pages géantes transparentes (THP) peuvent
+// être demandées pour réduire la pression sur la TLB.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+class FramePool;
+
+// Emplacement emprunté au pool, rendu automatiquement à la destruction
+class PooledFrame {
+public:
+    PooledFrame() = default;
+    PooledFrame(FramePool *pool, uint8_t *data) : pool_(pool), data_(data) {}
+    PooledFrame(PooledFrame &&other) noexcept
+        : size(other.size), pool_(other.pool_), data_(other.data_) {
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size = 0;
+    }
+    PooledFrame &operator=(PooledFrame &&other) noexcept;
+    PooledFrame(const PooledFrame &) = delete;
+    PooledFrame &operator=(const PooledFrame &) = delete;
+    ~PooledFrame() { reset(); }
+
+    void reset();
+
+    explicit operator bool() const { return data_ != nullptr; }
+    uint8_t *data() const { return data_; }
+    size_t capacity() const;
+
+    size_t size = 0; // octets utiles dans l'emplacement
+
+private:
+    FramePool *pool_ = nullptr;
+    uint8_t *data_ = nullptr;
+};
+
+class FramePool {
+public:
+    static constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+    FramePool() = default;
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+    ~FramePool() { release(); }
+
+    // Réserve min(maxSlots, budget / frameSize) emplacements (au moins 1 si le budget le permet)
+    bool init(size_t frameSize, size_t budgetBytes, size_t maxSlots, bool hugePages = false) {
+        release();
+
+        size_t align = hugePages ? HUGE_PAGE : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        slotSize_ = (frameSize + align - 1) / align * align;
+        size_t count = budgetBytes / slotSize_;
+        if (count > maxSlots)
+            count = maxSlots;
+        if (count == 0) {
+            std::cerr << "FramePool: budget mémoire insuffisant pour une image de "
+                      << frameSize << " octets" << std::endl;
+            return false;
+        }
+
+        length_ = count * slotSize_;
+        void *mem = mmap(nullptr, length_, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            std::cerr << "FramePool: mmap de " << length_ << " octets impossible" << std::endl;
+            return false;
+        }
+        base_ = static_cast<uint8_t *>(mem);
+
+        if (hugePages && madvise(base_, length_, MADV_HUGEPAGE) != 0)
+            std::cerr << "FramePool: pages géantes indisponibles, pages normales utilisées" << std::endl;
+
+        // Verrouillage + pré-touche : plus aucun défaut de page pendant la capture
+        if (mlock(base_, length_) != 0)
+            std::cerr << "FramePool: mlock impossible (ulimit -l ?), pages non verrouillées" << std::endl;
+        memset(base_, 0, length_);
+
+        free_.reserve(count);
+        for (size_t i = count; i-- > 0;)
+            free_.push_back(base_ + i * slotSize_);
+        count_ = count;
+        return true;
+    }
+
+    // Emprunt non bloquant : emplacement vide si le pool est épuisé
+    PooledFrame tryBorrow() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (free_.empty())
+            return PooledFrame();
+        uint8_t *slot = free_.back();
+        free_.pop_back();
+        return PooledFrame(this, slot);
+    }
+
+    // Emprunt bloquant : attend qu'un emplacement soit rendu
+    PooledFrame borrow() {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return !free_.empty(); });
+        uint8_t *slot = free_.back();
+        free_.pop_back();
+        return PooledFrame(this, slot);
+    }
+
+    void giveBack(uint8_t *slot) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            free_.push_back(slot);
+        }
+        cv_.notify_one();
+    }
+
+    size_t slotSize() const { return slotSize_; }
+    size_t count() const { return count_; }
+    bool valid() const { return base_ != nullptr; }
+
+private:
+    void release() {
+        if (base_) {
+            munlock(base_, length_);
+            munmap(base_, length_);
+        }
+        base_ = nullptr;
+        length_ = slotSize_ = count_ = 0;
+        free_.clear();
+    }
+
+    uint8_t *base_ = nullptr;
+    size_t length_ = 0;
+    size_t slotSize_ = 0;
+    size_t count_ = 0;
+    std::vector<uint8_t *> free_; // capacité réservée à init(), jamais réallouée
+    std::mutex mtx_;
+    std::condition_variable cv_;
+};
+
+inline PooledFrame &PooledFrame::operator=(PooledFrame &&other) noexcept
+{
+    if (this != &other) {
+        reset();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        size = other.size;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size = 0;
+    }
+    return *this;
+}
+
+inline void PooledFrame::reset()
+{
+    if (pool_ && data_)
+        pool_->giveBack(data_);
+    pool_ = nullptr;
+    data_ = nullptr;
+    size = 0;
+}
+
+inline size_t PooledFrame::capacity() const
+{
+    return pool_ ? pool_->slotSize() : 0;
+}
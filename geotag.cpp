@@ -0,0 +1,760 @@
+// à compiler avec:  g++ -O2 -o geotag geotag.cpp -std=c++17
+//
+// Géoréférencement au sol des images d'une session, à partir des journaux de l'autopilote :
+//   ./geotag --triggers=cam.csv images/              une ligne par déclenchement (impulsion N = ligne N)
+//   ./geotag --track=gps.csv --t0=T images/          trajectoire horodatée, interpolée à l'instant de chaque image
+// Options :
+//   --pulse-offset=K     impulsion de la première ligne de --triggers (1 par défaut)
+//   --t0=T               instant (temps du journal, en secondes) du front PPS clk=0
+//   --dest=dossier       dossier de la cible 0, 1... (ordre des --dest de la capture) quand les
+//                        supports sont montés ailleurs qu'à bord ; répétable
+//   --session=AAAAMMJJ_HHMMSS   session à traiter quand le dossier en contient plusieurs
+//   --max-gap=S          écart maximal entre deux points de trajectoire encadrant une image (2 s)
+//   --time-col= --lat-col= --lon-col= --alt-col= --yaw-col=   noms des colonnes du CSV
+//   --time-unit=s|ms|us  unité de la colonne de temps (s par défaut)
+//   --dry-run            écrit seulement geotags.csv (geotags_<session>.csv), sans toucher aux images
+//
+// Les images sont décrites par l'index binaire de session (session_*.idx) s'il est présent,
+// sinon par leurs .raw.info (pulse, clk, tick, pps_tick ; à défaut le nom de fichier), chaque
+// image dans le dossier de sa cible. Une image est identifiée par (session, impulsion) : les numéros
+// d'impulsion et les secondes PPS repartent de 1 et 0 à chaque session, un journal de l'autopilote
+// ne correspond donc qu'à une seule session. L'instant d'une image est t0 + clk + (tick - pps_tick) / 1e6.
+// Une image marquée revoked (impulsion parasite reconnue après la prise) n'est pas géoréférencée ;
+// avec --triggers, les impulsions suivantes sont ramenées sur leur ligne.
+// Images et trajectoire sont triées puis parcourues ensemble : O(n log n) pour n images.
+//
+// Les positions sont écrites dans dossier/geotags.csv et dans les sorties déjà converties :
+//   - .dng / .tif : IFD GPS ajouté en fin de fichier, seul l'en-tête (ou l'entrée GPSInfo)
+//     est modifié sur place : les données image ne sont ni relues ni réécrites ;
+//   - .jpg : segment EXIF (APP1) inséré, les données JPEG sont recopiées sans réencodage.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "raw_reader.h"
+#include "session_index.h"
+
+using namespace std;
+
+struct FrameTiming {
+    string base;    // chemin sans extension (photo_...)
+    string session; // AAAAMMJJ_HHMMSS de l'index, vide pour une image décrite par son .info
+    int pulse = 0;
+    int clk = 0;
+    uint32_t tick = 0;
+    uint32_t ppsTick = 0;
+    bool hasPps = false;
+    bool holdover = false; // PPS absent à la prise : instant extrapolé
+    bool revoked = false;  // impulsion parasite reconnue après la prise (revoked=1)
+    double time = 0.0; // temps du journal
+};
+
+struct GeoFix {
+    double lat = 0.0;
+    double lon = 0.0;
+    double alt = NAN;
+    double yaw = NAN; // cap en degrés
+    bool valid = false;
+};
+
+struct TrackPoint {
+    double time = 0.0;
+    GeoFix fix;
+};
+
+struct ColumnNames {
+    string time, lat, lon, alt, yaw;
+    double timeScale = 1.0;
+};
+
+// ---------- Lecture des images ----------
+
+static bool exists(const string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// Ancien nommage sans séparateurs : photo_PPPPCCCCTTTTTTTTTTTT
+static bool timingFromName(const string &name, FrameTiming &f)
+{
+    size_t p = name.rfind("photo_");
+    if (p == string::npos)
+        return false;
+    string digits = name.substr(p + 6);
+    digits.erase(remove(digits.begin(), digits.end(), '_'), digits.end());
+    if (digits.size() != 20 || digits.find_first_not_of("0123456789") != string::npos)
+        return false;
+    f.pulse = stoi(digits.substr(0, 4));
+    f.clk = stoi(digits.substr(4, 4));
+    f.tick = static_cast<uint32_t>(stoull(digits.substr(8)));
+    return true;
+}
+
+// Dossier de chaque cible d'après la copie CSV de l'index (colonnes cible et dossier)
+static vector<string> readTargetDirs(const string &csvPath)
+{
+    vector<string> dirs;
+    ifstream in(csvPath);
+    string line;
+    if (!getline(in, line))
+        return dirs;
+    int targetCol = -1, dirCol = -1, col = 0;
+    string field;
+    for (istringstream header(line); getline(header, field, ','); col++) {
+        if (field == "cible")
+            targetCol = col;
+        else if (field == "dossier")
+            dirCol = col;
+    }
+    if (targetCol < 0 || dirCol < 0)
+        return dirs;
+    while (getline(in, line)) {
+        vector<string> fields;
+        for (istringstream row(line); getline(row, field, ',');)
+            fields.push_back(field);
+        if (static_cast<int>(fields.size()) <= max(targetCol, dirCol) || fields[dirCol].empty())
+            continue;
+        int target = atoi(fields[targetCol].c_str());
+        if (target < 0 || target > 0xFFFF)
+            continue;
+        if (static_cast<int>(dirs.size()) <= target)
+            dirs.resize(target + 1);
+        if (dirs[target].empty())
+            dirs[target] = fields[dirCol];
+    }
+    return dirs;
+}
+
+// Index binaires de session du dossier (tous, ou seulement celui de `session`) : un
+// enregistrement par image, sans ouvrir les .info. Chaque image est cherchée dans le dossier
+// de sa cible : --dest=, sinon le dossier noté dans le CSV de la même session s'il existe
+// ici, sinon le dossier de l'index.
+static vector<FrameTiming> readIndexes(const string &dir, const vector<string> &dests, const string &session)
+{
+    vector<FrameTiming> frames;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return frames;
+    while (dirent *e = readdir(d)) {
+        string name = e->d_name;
+        if (name.rfind("session_", 0) != 0 || name.size() < 12 || name.compare(name.size() - 4, 4, ".idx") != 0)
+            continue;
+        string stamp = name.substr(8, name.size() - 12);
+        if (!session.empty() && stamp != session)
+            continue;
+        SessionIndexReader index;
+        if (!index.open(dir + name))
+            continue;
+        vector<string> targetDirs = readTargetDirs(dir + name.substr(0, name.size() - 4) + ".csv");
+        vector<bool> missing(targetDirs.size());
+        auto targetDir = [&](uint16_t target) -> string {
+            if (target < dests.size())
+                return dests[target];
+            if (target >= targetDirs.size() || targetDirs[target].empty())
+                return dir;
+            if (!exists(targetDirs[target])) {
+                if (!missing[target])
+                    cerr << "Cible " << target << " : dossier " << targetDirs[target]
+                         << " introuvable, images cherchées dans " << dir << " (voir --dest=)" << endl;
+                missing[target] = true;
+                return dir;
+            }
+            string d = targetDirs[target];
+            return d.back() == '/' ? d : d + '/';
+        };
+        for (size_t p = 1; p <= index.slots(); p++) {
+            const SessionIndexEntry *entry = index.find(static_cast<uint32_t>(p));
+            if (!entry)
+                continue;
+            FrameTiming f;
+            string raw = entry->name;
+            f.base = targetDir(entry->target) + raw.substr(0, raw.rfind('.'));
+            f.session = stamp;
+            f.pulse = static_cast<int>(entry->pulse);
+            f.clk = static_cast<int>(entry->clk);
+            f.tick = entry->tick;
+            f.ppsTick = entry->ppsTick;
+            f.hasPps = true;
+            f.holdover = (entry->flags & ENTRY_HOLDOVER) != 0;
+            f.revoked = (entry->flags & ENTRY_REVOKED) != 0;
+            frames.push_back(f);
+        }
+    }
+    closedir(d);
+    return frames;
+}
+
+static vector<FrameTiming> readFrames(const string &dir, const vector<string> &dests, const string &session,
+                                      int &untimed)
+{
+    vector<FrameTiming> frames = readIndexes(dir, dests, session);
+    if (!frames.empty() || !session.empty())
+        return frames;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return frames;
+    while (dirent *e = readdir(d)) {
+        string name = e->d_name;
+        if (name.size() <= 9 || name.compare(name.size() - 9, 9, ".raw.info") != 0)
+            continue;
+        FrameTiming f;
+        f.base = dir + name.substr(0, name.size() - 9);
+        RawInfo info;
+        bool ok = false;
+        if (readRawInfo(dir + name, info) && !info.get("pulse").empty()) {
+            try {
+                f.pulse = stoi(info.get("pulse"));
+                f.clk = stoi(info.get("clk", "0"));
+                f.tick = static_cast<uint32_t>(stoul(info.get("tick", "0")));
+                f.hasPps = !info.get("pps_tick").empty();
+                if (f.hasPps)
+                    f.ppsTick = static_cast<uint32_t>(stoul(info.get("pps_tick")));
+                f.holdover = info.get("holdover") == "1";
+                f.revoked = info.get("revoked") == "1";
+                ok = true;
+            } catch (const exception &) {
+            }
+        }
+        if (!ok)
+            ok = timingFromName(name.substr(0, name.size() - 9), f);
+        if (ok)
+            frames.push_back(f);
+        else
+            untimed++;
+    }
+    closedir(d);
+    return frames;
+}
+
+// ---------- Lecture du journal de l'autopilote ----------
+
+static string lower(string s)
+{
+    for (char &c : s)
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+static vector<string> splitCsv(const string &line, char sep)
+{
+    vector<string> out;
+    string cur;
+    for (char c : line) {
+        if (c == sep) {
+            out.push_back(cur);
+            cur.clear();
+        } else if (c != '\r' && c != '"') {
+            cur += c;
+        }
+    }
+    out.push_back(cur);
+    for (string &s : out) {
+        size_t a = s.find_first_not_of(' ');
+        size_t b = s.find_last_not_of(' ');
+        s = a == string::npos ? string() : s.substr(a, b - a + 1);
+    }
+    return out;
+}
+
+static int findColumn(const vector<string> &header, const string &wanted, const vector<string> &defaults)
+{
+    vector<string> names = wanted.empty() ? defaults : vector<string>{wanted};
+    for (const string &n : names)
+        for (size_t i = 0; i < header.size(); i++)
+            if (lower(header[i]) == lower(n))
+                return static_cast<int>(i);
+    return -1;
+}
+
+static bool readLog(const string &path, const ColumnNames &cols, bool needTime, vector<TrackPoint> &points)
+{
+    ifstream in(path);
+    if (!in) {
+        cerr << "Impossible de lire " << path << endl;
+        return false;
+    }
+    string line;
+    if (!getline(in, line))
+        return false;
+    char sep = line.find(';') != string::npos ? ';' : line.find('\t') != string::npos ? '\t' : ',';
+    vector<string> header = splitCsv(line, sep);
+    int ct = findColumn(header, cols.time, {"time", "timestamp", "gpstime", "timeus", "t"});
+    int cla = findColumn(header, cols.lat, {"lat", "latitude"});
+    int clo = findColumn(header, cols.lon, {"lon", "lng", "longitude"});
+    int cal = findColumn(header, cols.alt, {"alt", "altitude", "alt_msl"});
+    int cya = findColumn(header, cols.yaw, {"yaw", "heading", "cap"});
+    if (cla < 0 || clo < 0 || (needTime && ct < 0)) {
+        cerr << path << " : colonnes latitude/longitude" << (needTime ? "/temps" : "")
+             << " introuvables (voir --lat-col, --lon-col, --time-col)" << endl;
+        return false;
+    }
+
+    while (getline(in, line)) {
+        if (line.empty())
+            continue;
+        vector<string> f = splitCsv(line, sep);
+        auto num = [&](int c) { return c >= 0 && c < static_cast<int>(f.size()) && !f[c].empty() ? atof(f[c].c_str()) : NAN; };
+        TrackPoint p;
+        p.time = num(ct) * cols.timeScale;
+        p.fix.lat = num(cla);
+        p.fix.lon = num(clo);
+        p.fix.alt = num(cal);
+        p.fix.yaw = num(cya);
+        p.fix.valid = !std::isnan(p.fix.lat) && !std::isnan(p.fix.lon) && !(needTime && std::isnan(p.time));
+        points.push_back(p);
+    }
+    return true;
+}
+
+// ---------- Jointure ----------
+
+static double lerpAngle(double a, double b, double t)
+{
+    double d = fmod(b - a + 540.0, 360.0) - 180.0;
+    return fmod(a + d * t + 360.0, 360.0);
+}
+
+// Images et points triés par temps, parcourus ensemble
+static void interpolate(vector<FrameTiming> &frames, vector<TrackPoint> &track, double maxGap, vector<GeoFix> &fixes)
+{
+    track.erase(remove_if(track.begin(), track.end(), [](const TrackPoint &p) { return !p.fix.valid; }), track.end());
+    sort(track.begin(), track.end(), [](const TrackPoint &a, const TrackPoint &b) { return a.time < b.time; });
+    vector<size_t> order(frames.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&](size_t a, size_t b) { return frames[a].time < frames[b].time; });
+
+    fixes.assign(frames.size(), GeoFix());
+    size_t k = 0;
+    for (size_t i : order) {
+        double t = frames[i].time;
+        while (k + 1 < track.size() && track[k + 1].time < t)
+            k++;
+        if (k + 1 >= track.size() || track[k].time > t || track[k + 1].time - track[k].time > maxGap)
+            continue;
+        const TrackPoint &a = track[k];
+        const TrackPoint &b = track[k + 1];
+        double u = b.time > a.time ? (t - a.time) / (b.time - a.time) : 0.0;
+        GeoFix &g = fixes[i];
+        g.lat = a.fix.lat + (b.fix.lat - a.fix.lat) * u;
+        g.lon = a.fix.lon + (b.fix.lon - a.fix.lon) * u;
+        g.alt = a.fix.alt + (b.fix.alt - a.fix.alt) * u;
+        g.yaw = std::isnan(a.fix.yaw) || std::isnan(b.fix.yaw) ? NAN : lerpAngle(a.fix.yaw, b.fix.yaw, u);
+        g.valid = true;
+    }
+}
+
+// ---------- Écriture des balises GPS ----------
+
+static void le16(vector<uint8_t> &v, uint16_t x)
+{
+    v.push_back(static_cast<uint8_t>(x));
+    v.push_back(static_cast<uint8_t>(x >> 8));
+}
+
+static void le32(vector<uint8_t> &v, uint32_t x)
+{
+    for (int i = 0; i < 4; i++)
+        v.push_back(static_cast<uint8_t>(x >> (8 * i)));
+}
+
+// IFD GPS (TIFF petit-boutiste) destiné à l'offset `base` du fichier
+static vector<uint8_t> buildGpsIfd(const GeoFix &g, uint32_t base)
+{
+    struct Entry {
+        uint16_t tag, type;
+        uint32_t count;
+        vector<uint8_t> data;
+    };
+    auto rational = [](vector<uint8_t> &d, double v, uint32_t den) {
+        le32(d, static_cast<uint32_t>(llround(v * den)));
+        le32(d, den);
+    };
+    auto dms = [&](double deg) {
+        vector<uint8_t> d;
+        deg = fabs(deg);
+        double m = (deg - floor(deg)) * 60.0;
+        rational(d, floor(deg), 1);
+        rational(d, floor(m), 1);
+        rational(d, (m - floor(m)) * 60.0, 10000);
+        return d;
+    };
+    vector<Entry> e;
+    e.push_back({0, 1, 4, {2, 3, 0, 0}});
+    e.push_back({1, 2, 2, {static_cast<uint8_t>(g.lat >= 0 ? 'N' : 'S'), 0}});
+    e.push_back({2, 5, 3, dms(g.lat)});
+    e.push_back({3, 2, 2, {static_cast<uint8_t>(g.lon >= 0 ? 'E' : 'W'), 0}});
+    e.push_back({4, 5, 3, dms(g.lon)});
+    if (!std::isnan(g.alt)) {
+        e.push_back({5, 1, 1, {static_cast<uint8_t>(g.alt < 0 ? 1 : 0)}});
+        vector<uint8_t> d;
+        rational(d, fabs(g.alt), 100);
+        e.push_back({6, 5, 1, d});
+    }
+    if (!std::isnan(g.yaw)) {
+        e.push_back({16, 2, 2, {'T', 0}});
+        vector<uint8_t> d;
+        rational(d, g.yaw, 100);
+        e.push_back({17, 5, 1, d});
+    }
+
+    vector<uint8_t> out;
+    le16(out, static_cast<uint16_t>(e.size()));
+    uint32_t extra = base + 2 + 12 * e.size() + 4;
+    vector<uint8_t> values;
+    for (const Entry &x : e) {
+        le16(out, x.tag);
+        le16(out, x.type);
+        le32(out, x.count);
+        if (x.data.size() <= 4) {
+            vector<uint8_t> inl = x.data;
+            inl.resize(4, 0);
+            out.insert(out.end(), inl.begin(), inl.end());
+        } else {
+            le32(out, extra + static_cast<uint32_t>(values.size()));
+            values.insert(values.end(), x.data.begin(), x.data.end());
+        }
+    }
+    le32(out, 0);
+    out.insert(out.end(), values.begin(), values.end());
+    return out;
+}
+
+static bool preadAll(int fd, void *buf, size_t n, off_t off)
+{
+    return pread(fd, buf, n, off) == static_cast<ssize_t>(n);
+}
+
+static bool pwriteAll(int fd, const void *buf, size_t n, off_t off)
+{
+    return pwrite(fd, buf, n, off) == static_cast<ssize_t>(n);
+}
+
+// TIFF/DNG : IFD GPS (et au besoin un nouvel IFD0 avec l'entrée GPSInfo) ajouté en fin de
+// fichier, puis l'offset pointant dessus modifié : 4 octets réécrits sur place
+static bool patchTiff(const string &path, const GeoFix &g)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool ok = false;
+    uint8_t header[8];
+    struct stat st;
+    if (fstat(fd, &st) == 0 && preadAll(fd, header, 8, 0) && header[0] == 'I' && header[1] == 'I' && header[2] == 42) {
+        uint32_t ifd0;
+        memcpy(&ifd0, header + 4, 4);
+        uint16_t count = 0;
+        if (preadAll(fd, &count, 2, ifd0)) {
+            vector<uint8_t> entries(12 * count);
+            uint32_t next = 0;
+            if (preadAll(fd, entries.data(), entries.size(), ifd0 + 2) &&
+                preadAll(fd, &next, 4, ifd0 + 2 + entries.size())) {
+                off_t end = (st.st_size + 1) & ~static_cast<off_t>(1);
+                uint32_t gpsOffset = static_cast<uint32_t>(end);
+                vector<uint8_t> gps = buildGpsIfd(g, gpsOffset);
+                if (gps.size() & 1)
+                    gps.push_back(0);
+
+                // Entrée GPSInfo existante (nouveau passage) : seul son offset change
+                long existing = -1;
+                for (uint16_t i = 0; i < count; i++) {
+                    uint16_t tag;
+                    memcpy(&tag, &entries[12 * i], 2);
+                    if (tag == 34853)
+                        existing = i;
+                }
+                if (existing >= 0) {
+                    ok = pwriteAll(fd, gps.data(), gps.size(), end) && fdatasync(fd) == 0 &&
+                         pwriteAll(fd, &gpsOffset, 4, ifd0 + 2 + 12 * existing + 8);
+                } else {
+                    // Nouvel IFD0 : entrées d'origine (leurs valeurs restent où elles sont) + GPSInfo
+                    vector<uint8_t> gpsEntry;
+                    le16(gpsEntry, 34853);
+                    le16(gpsEntry, 4); // LONG (IFD)
+                    le32(gpsEntry, 1);
+                    le32(gpsEntry, gpsOffset);
+                    size_t at = 0;
+                    while (at < count) {
+                        uint16_t tag;
+                        memcpy(&tag, &entries[12 * at], 2);
+                        if (tag > 34853)
+                            break;
+                        at++;
+                    }
+                    entries.insert(entries.begin() + 12 * at, gpsEntry.begin(), gpsEntry.end());
+                    vector<uint8_t> ifd;
+                    le16(ifd, static_cast<uint16_t>(count + 1));
+                    ifd.insert(ifd.end(), entries.begin(), entries.end());
+                    le32(ifd, next);
+                    uint32_t newIfd0 = static_cast<uint32_t>(end + gps.size());
+                    gps.insert(gps.end(), ifd.begin(), ifd.end());
+                    ok = pwriteAll(fd, gps.data(), gps.size(), end) && fdatasync(fd) == 0 &&
+                         pwriteAll(fd, &newIfd0, 4, 4);
+                }
+            }
+        }
+    }
+    ok = close(fd) == 0 && ok;
+    return ok;
+}
+
+// JPEG : segment APP1 EXIF (IFD0 réduit à GPSInfo) inséré après SOI/APP0, ancien EXIF retiré
+static bool patchJpeg(const string &path, const GeoFix &g)
+{
+    ifstream in(path, ios::binary);
+    vector<uint8_t> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8)
+        return false;
+
+    // TIFF dans l'APP1 : en-tête, IFD0 à une entrée, puis IFD GPS
+    vector<uint8_t> tiff = {'I', 'I', 42, 0};
+    le32(tiff, 8);
+    le16(tiff, 1);
+    le16(tiff, 34853);
+    le16(tiff, 4);
+    le32(tiff, 1);
+    le32(tiff, 26);
+    le32(tiff, 0);
+    vector<uint8_t> gps = buildGpsIfd(g, 26);
+    tiff.insert(tiff.end(), gps.begin(), gps.end());
+    vector<uint8_t> app1 = {0xFF, 0xE1, 0, 0, 'E', 'x', 'i', 'f', 0, 0};
+    app1.insert(app1.end(), tiff.begin(), tiff.end());
+    size_t len = app1.size() - 2;
+    if (len > 0xFFFF)
+        return false;
+    app1[2] = static_cast<uint8_t>(len >> 8);
+    app1[3] = static_cast<uint8_t>(len);
+
+    vector<uint8_t> out = {0xFF, 0xD8};
+    size_t pos = 2;
+    bool inserted = false;
+    while (pos + 4 <= data.size() && data[pos] == 0xFF) {
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xDA || marker == 0xD9)
+            break;
+        size_t seg = 2 + (data[pos + 2] << 8 | data[pos + 3]);
+        if (pos + seg > data.size())
+            return false;
+        bool exif = marker == 0xE1 && seg >= 10 && memcmp(&data[pos + 4], "Exif\0\0", 6) == 0;
+        if (marker != 0xE0 && !inserted) {
+            out.insert(out.end(), app1.begin(), app1.end());
+            inserted = true;
+        }
+        if (!exif)
+            out.insert(out.end(), data.begin() + pos, data.begin() + pos + seg);
+        pos += seg;
+    }
+    if (!inserted)
+        out.insert(out.end(), app1.begin(), app1.end());
+    out.insert(out.end(), data.begin() + pos, data.end());
+
+    string tmp = path + ".tmp";
+    ofstream o(tmp, ios::binary);
+    o.write(reinterpret_cast<const char *>(out.data()), out.size());
+    o.close();
+    if (!o || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    string triggersPath, trackPath, dir, session;
+    vector<string> dests;
+    ColumnNames cols;
+    double t0 = NAN;
+    double maxGap = 2.0;
+    int pulseOffset = 1;
+    bool dryRun = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&](const char *prefix) { return arg.substr(strlen(prefix)); };
+        if (arg.rfind("--triggers=", 0) == 0)
+            triggersPath = value("--triggers=");
+        else if (arg.rfind("--track=", 0) == 0)
+            trackPath = value("--track=");
+        else if (arg.rfind("--t0=", 0) == 0)
+            t0 = atof(value("--t0=").c_str());
+        else if (arg.rfind("--dest=", 0) == 0) {
+            string d = value("--dest=");
+            dests.push_back(d.empty() || d.back() == '/' ? d : d + '/');
+        } else if (arg.rfind("--session=", 0) == 0)
+            session = value("--session=");
+        else if (arg.rfind("--max-gap=", 0) == 0)
+            maxGap = atof(value("--max-gap=").c_str());
+        else if (arg.rfind("--pulse-offset=", 0) == 0)
+            pulseOffset = atoi(value("--pulse-offset=").c_str());
+        else if (arg.rfind("--time-col=", 0) == 0)
+            cols.time = value("--time-col=");
+        else if (arg.rfind("--lat-col=", 0) == 0)
+            cols.lat = value("--lat-col=");
+        else if (arg.rfind("--lon-col=", 0) == 0)
+            cols.lon = value("--lon-col=");
+        else if (arg.rfind("--alt-col=", 0) == 0)
+            cols.alt = value("--alt-col=");
+        else if (arg.rfind("--yaw-col=", 0) == 0)
+            cols.yaw = value("--yaw-col=");
+        else if (arg.rfind("--time-unit=", 0) == 0) {
+            string u = value("--time-unit=");
+            cols.timeScale = u == "ms" ? 1e-3 : u == "us" ? 1e-6 : 1.0;
+        } else if (arg == "--dry-run")
+            dryRun = true;
+        else if (arg.rfind("--", 0) == 0) {
+            cerr << "Option inconnue: " << arg << endl;
+            return 1;
+        } else
+            dir = arg;
+    }
+    if (dir.empty() || triggersPath.empty() == trackPath.empty() || (!trackPath.empty() && std::isnan(t0))) {
+        cerr << "Usage: " << argv[0] << " (--triggers=cam.csv [--pulse-offset=K] | --track=gps.csv --t0=T [--max-gap=S])"
+             << " [--dest=dossier]... [--session=AAAAMMJJ_HHMMSS] [--time-col=...] [--time-unit=s|ms|us] [--dry-run] dossier" << endl;
+        return 1;
+    }
+    if (dir.back() != '/')
+        dir += '/';
+
+    int untimed = 0;
+    vector<FrameTiming> frames = readFrames(dir, dests, session, untimed);
+    if (!session.empty() && frames.empty()) {
+        cerr << "Aucun index session_" << session << ".idx lisible dans " << dir << endl;
+        return 1;
+    }
+    sort(frames.begin(), frames.end(), [](const FrameTiming &a, const FrameTiming &b) {
+        return a.session != b.session ? a.session < b.session : a.pulse < b.pulse;
+    });
+    // Un seul journal de l'autopilote : une seule session à la fois
+    if (!frames.empty() && frames.front().session != frames.back().session) {
+        cerr << "Plusieurs sessions dans " << dir << ", choisir avec --session= :";
+        for (size_t i = 0; i < frames.size(); i++)
+            if (i == 0 || frames[i].session != frames[i - 1].session)
+                cerr << ' ' << frames[i].session;
+        cerr << endl;
+        return 1;
+    }
+    // Sans index, rien ne distingue deux sessions dans les .info : une impulsion vue deux fois
+    // n'est attribuée à aucune des deux images
+    int duplicates = 0;
+    for (size_t i = 0; i < frames.size();) {
+        size_t j = i + 1;
+        while (j < frames.size() && frames[j].pulse == frames[i].pulse)
+            j++;
+        if (j - i > 1) {
+            cerr << "Impulsion " << frames[i].pulse << " portée par " << j - i
+                 << " images (plusieurs sessions dans le dossier ?), ignorée" << endl;
+            duplicates += static_cast<int>(j - i);
+            frames.erase(frames.begin() + static_cast<long>(i), frames.begin() + static_cast<long>(j));
+        } else {
+            i = j;
+        }
+    }
+    // Image d'une impulsion parasite révoquée trop tard : aucun déclenchement ne lui correspond.
+    // Son numéro a été consommé, les impulsions suivantes sont décalées d'autant
+    vector<int> revokedPulses;
+    for (size_t i = 0; i < frames.size();) {
+        if (frames[i].revoked) {
+            revokedPulses.push_back(frames[i].pulse);
+            frames.erase(frames.begin() + static_cast<long>(i));
+        } else {
+            i++;
+        }
+    }
+    cout << frames.size() << " images horodatées";
+    if (!session.empty())
+        cout << " (session " << session << ")";
+    if (untimed)
+        cout << ", " << untimed << " sans horodatage (ignorées)";
+    if (duplicates)
+        cout << ", " << duplicates << " en double (ignorées)";
+    if (!revokedPulses.empty())
+        cout << ", " << revokedPulses.size() << " sur impulsion parasite (ignorées)";
+    cout << endl;
+
+    vector<TrackPoint> log;
+    vector<GeoFix> fixes(frames.size());
+    if (!triggersPath.empty()) {
+        // Un déclenchement de l'autopilote = une impulsion : jointure directe par numéro, moins
+        // les impulsions parasites qui précèdent
+        if (!readLog(triggersPath, cols, false, log))
+            return 1;
+        for (size_t i = 0; i < frames.size(); i++) {
+            long parasites = lower_bound(revokedPulses.begin(), revokedPulses.end(), frames[i].pulse) -
+                             revokedPulses.begin();
+            long row = static_cast<long>(frames[i].pulse) - pulseOffset - parasites;
+            if (row >= 0 && row < static_cast<long>(log.size()))
+                fixes[i] = log[row].fix;
+        }
+    } else {
+        if (!readLog(trackPath, cols, true, log))
+            return 1;
+        int noPps = 0, holdover = 0;
+        for (FrameTiming &f : frames) {
+            if (f.holdover)
+                holdover++;
+            // Différence de ticks modulo 2^32 : juste même au passage à zéro du compteur.
+            // Peut dépasser 1 s (front PPS manqué avant le maintien) : la seconde n'a pas avancé
+            double frac = f.hasPps ? static_cast<uint32_t>(f.tick - f.ppsTick) / 1e6 : 0.5;
+            if (!f.hasPps)
+                noPps++;
+            f.time = t0 + f.clk + frac;
+        }
+        if (noPps)
+            cout << noPps << " images sans pps_tick : instant connu à la seconde près" << endl;
+        if (holdover)
+            cout << holdover << " images prises sans PPS : instant extrapolé (voir time_error_us)" << endl;
+        interpolate(frames, log, maxGap, fixes);
+    }
+
+    // geotags.csv d'abord : il reste la référence même si une image ne peut être modifiée
+    string csvPath = dir + (session.empty() ? string("geotags.csv") : "geotags_" + session + ".csv");
+    ofstream csv(csvPath);
+    csv << "fichier,impulsion,clk,temps,latitude,longitude,altitude,cap\n";
+    csv.precision(9);
+    int tagged = 0, patched = 0, failed = 0;
+    for (size_t i = 0; i < frames.size(); i++) {
+        const GeoFix &g = fixes[i];
+        if (!g.valid)
+            continue;
+        tagged++;
+        size_t slash = frames[i].base.rfind('/');
+        csv << frames[i].base.substr(slash + 1) << ',' << frames[i].pulse << ',' << frames[i].clk << ','
+            << (trackPath.empty() ? string() : to_string(frames[i].time)) << ',' << g.lat << ',' << g.lon << ','
+            << (std::isnan(g.alt) ? string() : to_string(g.alt)) << ','
+            << (std::isnan(g.yaw) ? string() : to_string(g.yaw)) << '\n';
+        if (dryRun)
+            continue;
+        for (const char *ext : {".dng", ".tif", ".jpg"}) {
+            string path = frames[i].base + ext;
+            if (!exists(path))
+                continue;
+            bool ok = ext[1] == 'j' ? patchJpeg(path, g) : patchTiff(path, g);
+            if (ok) {
+                patched++;
+            } else {
+                failed++;
+                cerr << "Impossible d'écrire la position dans " << path << endl;
+            }
+        }
+    }
+    csv.close();
+
+    cout << tagged << " images géoréférencées, " << frames.size() - tagged << " sans position, "
+         << patched << " fichiers modifiés, " << failed << " échecs -> " << csvPath << endl;
+    return failed == 0 && csv ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+// Source de fronts libgpiod v2 : périphérique caractère /dev/gpiochipN
+//
+// Le noyau détecte les fronts par interruption et les horodate (CLOCK_MONOTONIC) au
+// moment de l'IRQ : pas d'échantillonnage en continu, et un front reste exact même si
+// le thread de lecture est réveillé en retard. Les événements sont lus par lots sur un
+// thread qui dort dans ppoll(), réveillé aussi à l'échéance du délai de garde de chaque
+// ligne (à la µs près). Il suffit d'appartenir au groupe gpio, root n'est pas
+// nécessaire. Compiler avec -DHAVE_LIBGPIOD -lgpiod (paquet libgpiod-dev, version 2).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+#include <gpiod.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "trigger_source.h"
+
+class GpiodTrigger : public TriggerSource {
+public:
+    static const int EVENT_BATCH = 16;
+
+    ~GpiodTrigger() override { close(); }
+
+    bool open(const TriggerPins &pins) override {
+        pins_ = pins;
+        chip_ = gpiod_chip_open(pins.chip.c_str());
+        if (!chip_)
+            return false;
+
+        gpiod_line_settings *settings = gpiod_line_settings_new();
+        gpiod_line_config *config = gpiod_line_config_new();
+        gpiod_request_config *requestConfig = gpiod_request_config_new();
+        bool ok = settings && config && requestConfig;
+        if (ok) {
+            gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT);
+            gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH);
+            gpiod_line_settings_set_bias(settings, GPIOD_LINE_BIAS_PULL_DOWN);
+            gpiod_line_settings_set_event_clock(settings, GPIOD_LINE_CLOCK_MONOTONIC);
+            unsigned int offsets[2] = {pins.pulse, pins.clock};
+            ok = gpiod_line_config_add_line_settings(config, offsets, 2, settings) == 0;
+            gpiod_request_config_set_consumer(requestConfig, "nat");
+            gpiod_request_config_set_event_buffer_size(requestConfig, 64);
+        }
+        if (ok)
+            request_ = gpiod_chip_request_lines(chip_, requestConfig, config);
+        if (requestConfig)
+            gpiod_request_config_free(requestConfig);
+        if (config)
+            gpiod_line_config_free(config);
+        if (settings)
+            gpiod_line_settings_free(settings);
+
+        events_ = gpiod_edge_event_buffer_new(EVENT_BATCH);
+        wake_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (!request_ || !events_ || wake_ < 0) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool start(TriggerEdgeFn fn) override {
+        if (!request_)
+            return false;
+        fn_ = fn;
+        stop_ = false;
+        thread_ = std::thread([this] { run(); });
+        return true;
+    }
+
+    void close() override {
+        stop_ = true;
+        if (wake_ >= 0) {
+            uint64_t one = 1;
+            ssize_t n = write(wake_, &one, sizeof(one)); // réveille poll()
+            (void)n;
+        }
+        if (thread_.joinable())
+            thread_.join();
+        if (events_)
+            gpiod_edge_event_buffer_free(events_);
+        if (request_)
+            gpiod_line_request_release(request_);
+        if (chip_)
+            gpiod_chip_close(chip_);
+        if (wake_ >= 0)
+            ::close(wake_);
+        events_ = nullptr;
+        request_ = nullptr;
+        chip_ = nullptr;
+        wake_ = -1;
+    }
+
+    uint32_t tick() override { return monotonicTickUs(); }
+    const char *name() const override { return "gpiod"; }
+
+private:
+    void run() {
+        pollfd fds[2] = {{gpiod_line_request_get_fd(request_), POLLIN, 0}, {wake_, POLLIN, 0}};
+        while (!stop_) {
+            // Prochaine échéance du délai de garde, sinon attente sans limite
+            timespec timeout;
+            timespec *wait = nullptr;
+            if (settleUs_ && (armed_[0] || armed_[1])) {
+                uint32_t now = tick();
+                uint32_t left = UINT32_MAX;
+                for (int l = 0; l < 2; l++) {
+                    if (!armed_[l])
+                        continue;
+                    uint32_t elapsed = now - lastEdge_[l];
+                    left = std::min(left, elapsed < settleUs_ ? settleUs_ - elapsed : 0u);
+                }
+                timeout = {static_cast<time_t>(left / 1000000), static_cast<long>(left % 1000000) * 1000};
+                wait = &timeout;
+            }
+            int ready = ppoll(fds, 2, wait, nullptr);
+            if (ready == 0) {
+                uint32_t now = tick();
+                for (int l = 0; l < 2; l++) {
+                    if (armed_[l] && now - lastEdge_[l] >= settleUs_) {
+                        armed_[l] = false;
+                        fn_(l ? TriggerLine::Clock : TriggerLine::Pulse, TRIGGER_TIMEOUT, now);
+                    }
+                }
+                continue;
+            }
+            if (ready < 0 || (fds[1].revents & POLLIN))
+                continue;
+            if (!(fds[0].revents & POLLIN))
+                continue;
+            int n = gpiod_line_request_read_edge_events(request_, events_, EVENT_BATCH);
+            for (int i = 0; i < n; i++) {
+                gpiod_edge_event *event = gpiod_edge_event_buffer_get_event(events_, i);
+                // Horodatage du noyau ramené à la base de tick() (µs sur 32 bits)
+                uint32_t tick = static_cast<uint32_t>(gpiod_edge_event_get_timestamp_ns(event) / 1000);
+                int level = gpiod_edge_event_get_event_type(event) == GPIOD_EDGE_EVENT_RISING_EDGE ? 1 : 0;
+                TriggerLine line = gpiod_edge_event_get_line_offset(event) == pins_.clock ? TriggerLine::Clock
+                                                                                          : TriggerLine::Pulse;
+                int l = line == TriggerLine::Clock ? 1 : 0;
+                lastEdge_[l] = tick;
+                armed_[l] = true;
+                fn_(line, level, tick);
+            }
+        }
+    }
+
+    TriggerPins pins_;
+    TriggerEdgeFn fn_ = nullptr;
+    gpiod_chip *chip_ = nullptr;
+    gpiod_line_request *request_ = nullptr;
+    gpiod_edge_event_buffer *events_ = nullptr;
+    int wake_ = -1;
+    uint32_t lastEdge_[2] = {}; // impulsion, clock : dernier front, base du délai de garde
+    bool armed_[2] = {};
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};
@@ -0,0 +1,280 @@
+// à compiler avec:  g++ -O2 -o jitter_bench jitter_bench.cpp -lpthread -std=c++17
+//
+// Banc de gigue du déclenchement : compare des profils de threads (thread_profile.h)
+// sous une charge semblable à celle d'un vol, sans caméra ni pigpio.
+//   sudo ./jitter_bench [--profiles=default,pinned] [--seconds=N] [--period-us=P]
+//                       [--writers=N] [--dir=dossier] [--frame-mo=M] [--compress=N]
+//                       [--pin=rôle:cœurs[:fifo=P|:nice=N|:idle]]...
+//
+// Pour chaque profil :
+//   - un thread "trigger" se réveille à échéances absolues toutes les P µs (1000 par
+//     défaut, comme la boucle de déclenchement) et mesure son retard ;
+//   - à chaque réveil il signale un thread "completion" (eventfd), dont le délai de
+//     prise en charge est mesuré aussi ;
+//   - N threads "writer" écrivent des images de M Mo dans le dossier (writeback du
+//     noyau compris) et des threads "preview" dématricent en continu (bayer_kernel.h).
+// Sans root, SCHED_FIFO et mlockall sont refusés : le banc le signale et continue.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bayer_kernel.h"
+#include "thread_profile.h"
+
+using namespace std;
+
+struct BenchOptions {
+    int seconds = 10;
+    int periodUs = 1000;
+    int writers = 1;
+    int compress = 1;
+    size_t frameBytes = 4608 * 2592 * 5 / 4; // une image SBGGR10_CSI2P
+    string dir = "/tmp";
+};
+
+struct LatencyStats {
+    size_t count = 0;
+    double mean = 0, p50 = 0, p99 = 0, p999 = 0, max = 0;
+    size_t over500 = 0;
+};
+
+static LatencyStats summarize(vector<int64_t> &ns)
+{
+    LatencyStats s;
+    s.count = ns.size();
+    if (ns.empty())
+        return s;
+    sort(ns.begin(), ns.end());
+    double sum = 0;
+    for (int64_t v : ns) {
+        sum += v;
+        s.over500 += v > 500000;
+    }
+    auto pct = [&](double q) { return ns[min(ns.size() - 1, static_cast<size_t>(q * ns.size()))] / 1000.0; };
+    s.mean = sum / ns.size() / 1000.0;
+    s.p50 = pct(0.50);
+    s.p99 = pct(0.99);
+    s.p999 = pct(0.999);
+    s.max = ns.back() / 1000.0;
+    return s;
+}
+
+static int64_t nowNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+static void role(const ThreadProfile &profile, ThreadRole r, atomic<int> &refused)
+{
+    string error;
+    if (!applyThreadRole(profile, r, &error)) {
+        if (refused++ == 0)
+            cerr << "  " << threadRoleName(r) << ": " << error << endl;
+    }
+}
+
+static void writerLoop(const BenchOptions &opt, int id, const vector<uint8_t> &frame, atomic<bool> &stop)
+{
+    string path = opt.dir + "/jitter_bench_" + to_string(getpid()) + "_" + to_string(id) + ".raw";
+    while (!stop) {
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return;
+        size_t done = 0;
+        while (done < frame.size() && !stop) {
+            ssize_t n = write(fd, frame.data() + done, min<size_t>(frame.size() - done, 1 << 20));
+            if (n <= 0)
+                break;
+            done += n;
+        }
+        sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+        fdatasync(fd);
+        close(fd);
+    }
+    unlink(path.c_str());
+}
+
+static void compressLoop(const vector<uint8_t> &frame, atomic<bool> &stop)
+{
+    const unsigned width = 4608, stride = width * 5 / 4;
+    FusedParams params;
+    buildFusedParams(params, "BGGR", 64, 1.0f);
+    vector<uint16_t> top(width * 3), bottom(width * 3);
+    size_t rows = frame.size() / stride;
+    while (!stop) {
+        RawStats stats;
+        for (size_t y = 0; y + 1 < rows && !stop; y += 2)
+            fusedCsi2pPair(frame.data() + y * stride, frame.data() + (y + 1) * stride, width, params,
+                           top.data(), bottom.data(), stats);
+    }
+}
+
+static void runProfile(const BenchOptions &opt, const ThreadProfile &profile, const vector<uint8_t> &frame)
+{
+    cout << "Profil " << describeThreadProfile(profile) << endl;
+    atomic<int> refused{0};
+    if (profile.lockMemory) {
+        string error;
+        if (!limitThreadStacks(&error) || !lockProcessMemory(&error))
+            cerr << "  " << error << endl;
+    }
+
+    atomic<bool> stop{false};
+    int efd = eventfd(0, EFD_CLOEXEC);
+    size_t expected = static_cast<size_t>(opt.seconds) * 1000000 / opt.periodUs + 16;
+    vector<int64_t> triggerLate, handoff;
+    triggerLate.reserve(expected);
+    handoff.reserve(expected);
+    atomic<int64_t> postedAt{0};
+
+    vector<thread> load;
+    for (int i = 0; i < opt.writers; i++)
+        load.emplace_back([&, i] {
+            role(profile, ThreadRole::Writer, refused);
+            writerLoop(opt, i, frame, stop);
+        });
+    for (int i = 0; i < opt.compress; i++)
+        load.emplace_back([&] {
+            role(profile, ThreadRole::Preview, refused);
+            compressLoop(frame, stop);
+        });
+
+    thread completion([&] {
+        role(profile, ThreadRole::Completion, refused);
+        uint64_t v;
+        while (read(efd, &v, sizeof(v)) == sizeof(v)) {
+            if (stop)
+                break;
+            handoff.push_back(nowNs() - postedAt.load());
+        }
+    });
+
+    thread trigger([&] {
+        role(profile, ThreadRole::Trigger, refused);
+        timespec next;
+        clock_gettime(CLOCK_MONOTONIC, &next);
+        int64_t end = nowNs() + static_cast<int64_t>(opt.seconds) * 1000000000;
+        while (true) {
+            next.tv_nsec += opt.periodUs * 1000;
+            while (next.tv_nsec >= 1000000000) {
+                next.tv_nsec -= 1000000000;
+                next.tv_sec++;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+            int64_t now = nowNs();
+            if (now >= end)
+                break;
+            triggerLate.push_back(now - (static_cast<int64_t>(next.tv_sec) * 1000000000 + next.tv_nsec));
+            postedAt = nowNs();
+            uint64_t one = 1;
+            if (write(efd, &one, sizeof(one)) != sizeof(one))
+                break;
+        }
+    });
+
+    trigger.join();
+    stop = true;
+    uint64_t one = 1;
+    if (write(efd, &one, sizeof(one)) != sizeof(one))
+        cerr << "  eventfd: " << strerror(errno) << endl;
+    completion.join();
+    for (auto &t : load)
+        t.join();
+    close(efd);
+    if (profile.lockMemory)
+        munlockall();
+
+    LatencyStats t = summarize(triggerLate), h = summarize(handoff);
+    printf("  déclenchement (µs) : moy %7.1f  p50 %7.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f  >500µs %zu/%zu\n",
+           t.mean, t.p50, t.p99, t.p999, t.max, t.over500, t.count);
+    printf("  complétion    (µs) : moy %7.1f  p50 %7.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f  >500µs %zu/%zu\n",
+           h.mean, h.p50, h.p99, h.p999, h.max, h.over500, h.count);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions opt;
+    vector<string> profiles = {"default", "pinned"};
+    vector<string> overrides;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&](const char *prefix) { return arg.substr(strlen(prefix)); };
+        if (arg.rfind("--seconds=", 0) == 0)
+            opt.seconds = max(1, atoi(value("--seconds=").c_str()));
+        else if (arg.rfind("--period-us=", 0) == 0)
+            opt.periodUs = max(50, atoi(value("--period-us=").c_str()));
+        else if (arg.rfind("--writers=", 0) == 0)
+            opt.writers = max(0, atoi(value("--writers=").c_str()));
+        else if (arg.rfind("--compress=", 0) == 0)
+            opt.compress = max(0, atoi(value("--compress=").c_str()));
+        else if (arg.rfind("--frame-mo=", 0) == 0)
+            opt.frameBytes = static_cast<size_t>(max(1, atoi(value("--frame-mo=").c_str()))) << 20;
+        else if (arg.rfind("--dir=", 0) == 0)
+            opt.dir = value("--dir=");
+        else if (arg.rfind("--pin=", 0) == 0)
+            overrides.push_back(value("--pin="));
+        else if (arg.rfind("--profiles=", 0) == 0) {
+            profiles.clear();
+            string list = value("--profiles=");
+            size_t pos = 0;
+            while (pos <= list.size()) {
+                size_t end = list.find(',', pos);
+                profiles.push_back(list.substr(pos, end == string::npos ? string::npos : end - pos));
+                if (end == string::npos)
+                    break;
+                pos = end + 1;
+            }
+        } else {
+            cerr << "Usage: " << argv[0] << " [--profiles=default,pinned] [--seconds=N] [--period-us=P] "
+                 << "[--writers=N] [--dir=dossier] [--frame-mo=M] [--compress=N] [--pin=rôle:cœurs[:...]]..." << endl;
+            return 1;
+        }
+    }
+
+    // Contenu pseudo-aléatoire : ni compressible par le support, ni trivial pour le noyau
+    vector<uint8_t> frame(opt.frameBytes);
+    uint32_t x = 2463534242u;
+    for (auto &b : frame) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        b = static_cast<uint8_t>(x);
+    }
+
+    cout << "Banc de gigue : " << opt.seconds << " s par profil, période " << opt.periodUs << " µs, "
+         << opt.writers << " écriture(s) de " << opt.frameBytes / (1024 * 1024.0) << " Mo dans " << opt.dir
+         << ", " << opt.compress << " dématriçage(s), " << thread::hardware_concurrency() << " cœurs" << endl;
+
+    for (const string &name : profiles) {
+        ThreadProfile profile;
+        if (!loadThreadProfile(name, profile)) {
+            cerr << "Profil inconnu: " << name << " (default|pinned)" << endl;
+            return 1;
+        }
+        // Les surcharges --pin s'appliquent au profil épinglé, pas à la référence
+        if (name != "default")
+            for (const string &spec : overrides)
+                if (!parseRoleOverride(spec, profile)) {
+                    cerr << "Rôle invalide: " << spec << endl;
+                    return 1;
+                }
+        runProfile(opt, profile, frame);
+    }
+    return 0;
+}
@@ -0,0 +1,327 @@
+// à compiler avec:  g++ -O2 -o journal_test journal_test.cpp -std=c++17
+//
+// Simulation de coupures d'alimentation pour frame_journal.h, sans caméra :
+//   ./journal_test [--dir=dossier]      (dossier temporaire dans /tmp par défaut)
+//
+// Chaque cas écrit un dossier d'images selon le protocole du journal, l'abîme comme
+// le ferait une coupure (.part tronqué, fin de journal déchirée, octets modifiés dans
+// une image validée), puis vérifie ce que FrameJournal::recover() rapporte et ce qui
+// reste dans le dossier. S'y ajoutent un dossier écrit avant le journal et la borne
+// du point de contrôle. Code de sortie non nul si une vérification échoue.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "durability.h"
+#include "frame_journal.h"
+
+using namespace std;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "  ÉCHEC %s:%d : %s\n", __FILE__, __LINE__, #cond);  \
+            failures++;                                                          \
+        }                                                                        \
+    } while (0)
+
+static const size_t FRAME_SIZE = 64 * 1024;
+
+static bool exists(const string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static off_t fileSize(const string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+static void writeFile(const string &path, const vector<uint8_t> &data, size_t size)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0 || write(fd, data.data(), size) != static_cast<ssize_t>(size)) {
+        perror(path.c_str());
+        exit(2);
+    }
+    close(fd);
+}
+
+static vector<uint8_t> frameData(int n)
+{
+    vector<uint8_t> data(FRAME_SIZE);
+    uint32_t x = 2463534242u + n;
+    for (auto &b : data) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        b = static_cast<uint8_t>(x);
+    }
+    return data;
+}
+
+static string frameName(int n)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "photo_%04d.raw", n);
+    return name;
+}
+
+// Dossier vide pour un cas
+static string caseDir(const string &root, const char *name)
+{
+    string dir = root + "/" + name + "/";
+    mkdir(dir.c_str(), 0777);
+    return dir;
+}
+
+// Étapes du protocole jusqu'à `step` : 1 = .part écrit, 3 = journalisé, 4 = renommé
+static void writeFrame(FrameJournal &journal, const string &dir, int n, int step, size_t written = FRAME_SIZE)
+{
+    vector<uint8_t> data = frameData(n);
+    string raw = dir + frameName(n);
+    writeFile(raw + ".part", data, written);
+    writeFile(raw + ".info", data, 16);
+    if (step >= 3 && !journal.commit(frameName(n).c_str(), FRAME_SIZE, frameChecksum(data.data(), FRAME_SIZE))) {
+        fprintf(stderr, "commit impossible\n");
+        exit(2);
+    }
+    if (step >= 4)
+        rename((raw + ".part").c_str(), raw.c_str());
+}
+
+static void flipByte(const string &path, off_t offset)
+{
+    int fd = open(path.c_str(), O_RDWR);
+    uint8_t b = 0;
+    if (fd < 0 || pread(fd, &b, 1, offset) != 1) {
+        perror(path.c_str());
+        exit(2);
+    }
+    b ^= 0x5A;
+    if (pwrite(fd, &b, 1, offset) != 1)
+        exit(2);
+    close(fd);
+}
+
+static void report(const char *name, const RecoveryReport &r)
+{
+    printf("%-28s valides %3d  réparées %d  en quarantaine %d  adoptées %d\n", name, r.verified, r.repaired,
+           r.quarantined, r.adopted);
+}
+
+// Coupure pendant l'écriture : .part tronqué, .part complet journalisé, .part non journalisé
+static void partFiles(const string &root)
+{
+    string dir = caseDir(root, "part");
+    FrameJournal journal;
+    journal.open(dir);
+    for (int n = 1; n <= 10; n++)
+        writeFrame(journal, dir, n, 4);
+    writeFrame(journal, dir, 11, 3);                  // journalisé, rename pas fait
+    writeFrame(journal, dir, 12, 3, FRAME_SIZE / 3);  // journalisé mais données tronquées
+    writeFrame(journal, dir, 13, 1, FRAME_SIZE / 2);  // coupure pendant l'écriture
+    journal.close();
+
+    RecoveryReport r = FrameJournal::recover(dir, 6);
+    report("fichiers .part", r);
+    CHECK(r.verified == 10);
+    CHECK(r.repaired == 1);
+    CHECK(r.quarantined == 2);
+    CHECK(exists(dir + frameName(11)) && !exists(dir + frameName(11) + ".part"));
+    CHECK(exists(dir + "recuperation/" + frameName(12) + ".part"));
+    CHECK(exists(dir + "recuperation/" + frameName(13) + ".part"));
+    CHECK(exists(dir + "recuperation/" + frameName(13) + ".info"));
+    CHECK(!exists(dir + frameName(13) + ".info"));
+
+    // Une seconde récupération ne trouve plus rien à réparer
+    r = FrameJournal::recover(dir, 6);
+    CHECK(r.verified == 11 && r.repaired == 0 && r.quarantined == 0);
+}
+
+// Coupure pendant l'ajout au journal : enregistrement final incomplet ou corrompu
+static void tornJournal(const string &root)
+{
+    string dir = caseDir(root, "journal");
+    FrameJournal journal;
+    journal.open(dir);
+    for (int n = 1; n <= 8; n++)
+        writeFrame(journal, dir, n, 4);
+    writeFrame(journal, dir, 9, 3);
+    journal.close();
+
+    // Dernier enregistrement (image 9) coupé au milieu
+    string path = dir + JOURNAL_NAME;
+    CHECK(truncate(path.c_str(), 8 * sizeof(JournalRecord) + 50) == 0);
+    RecoveryReport r = FrameJournal::recover(dir, 6);
+    report("fin de journal tronquée", r);
+    CHECK(r.verified == 8);
+    CHECK(r.repaired == 0);
+    CHECK(r.quarantined == 1);
+    CHECK(exists(dir + "recuperation/" + frameName(9) + ".part"));
+    CHECK(fileSize(path) == static_cast<off_t>(9 * sizeof(JournalRecord))); // 8 images + point de contrôle
+
+    // Enregistrement complet mais octets corrompus : coupé aussi, avec tout ce qui suit
+    journal.open(dir);
+    writeFrame(journal, dir, 10, 4);
+    writeFrame(journal, dir, 11, 4);
+    journal.close();
+    flipByte(path, 9 * sizeof(JournalRecord) + 40); // image 10
+    r = FrameJournal::recover(dir, 6);
+    report("enregistrement corrompu", r);
+    CHECK(r.verified == 8);
+    CHECK(r.quarantined == 2);
+    CHECK(fileSize(path) == static_cast<off_t>(9 * sizeof(JournalRecord)));
+}
+
+// Image validée dont le contenu n'a pas atteint le support (octets modifiés)
+static void corruptFrames(const string &root)
+{
+    string dir = caseDir(root, "contenu");
+    FrameJournal journal;
+    journal.open(dir);
+    for (int n = 1; n <= 30; n++)
+        writeFrame(journal, dir, n, 4);
+    journal.close();
+
+    flipByte(dir + frameName(28), FRAME_SIZE / 2); // dans la borne : relue, détectée
+    flipByte(dir + frameName(5), FRAME_SIZE / 2);  // hors borne : vérifiée par sa taille
+    RecoveryReport r = FrameJournal::recover(dir, 6);
+    report("images modifiées (borne 6)", r);
+    CHECK(r.verified == 29);
+    CHECK(r.quarantined == 1);
+    CHECK(exists(dir + "recuperation/" + frameName(28)));
+    CHECK(exists(dir + frameName(5)));
+}
+
+// Sans borne (mode none) : tout ce qui suit le dernier point de contrôle est relu
+static void checkpoints(const string &root)
+{
+    string dir = caseDir(root, "none");
+    FrameJournal journal;
+    journal.open(dir);
+    for (int n = 1; n <= 30; n++)
+        writeFrame(journal, dir, n, 4);
+    journal.close();
+
+    flipByte(dir + frameName(5), FRAME_SIZE / 2);
+    RecoveryReport r = FrameJournal::recover(dir, 0);
+    report("images modifiées (tout)", r);
+    CHECK(r.verified == 29);
+    CHECK(r.quarantined == 1);
+    CHECK(exists(dir + "recuperation/" + frameName(5)));
+
+    // Images d'avant le point de contrôle : vérifiées par leur taille seulement
+    journal.open(dir);
+    for (int n = 31; n <= 35; n++)
+        writeFrame(journal, dir, n, 4);
+    journal.close();
+    flipByte(dir + frameName(10), FRAME_SIZE / 2);
+    flipByte(dir + frameName(33), FRAME_SIZE / 2);
+    r = FrameJournal::recover(dir, 0);
+    report("après point de contrôle", r);
+    CHECK(r.verified == 33);
+    CHECK(r.quarantined == 1);
+    CHECK(exists(dir + "recuperation/" + frameName(33)));
+    CHECK(exists(dir + frameName(10)));
+}
+
+// Dossier écrit avant la mise en place du journal : .raw et .info sans journal.bin
+static void legacyFrames(const string &root)
+{
+    string dir = caseDir(root, "ancien");
+    const char *info = "width=256\nheight=256\nformat=SBGGR10_CSI2P\nstride=256\n";
+    vector<uint8_t> text(info, info + strlen(info));
+    for (int n = 1; n <= 10; n++) {
+        writeFile(dir + frameName(n), frameData(n), FRAME_SIZE);
+        writeFile(dir + frameName(n) + ".info", text, text.size());
+    }
+    writeFile(dir + frameName(11), frameData(11), FRAME_SIZE / 2); // copie interrompue
+    writeFile(dir + frameName(11) + ".info", text, text.size());
+    writeFile(dir + frameName(12), frameData(12), FRAME_SIZE);     // sans .info
+
+    RecoveryReport r = FrameJournal::recover(dir, 6);
+    report("dossier sans journal", r);
+    CHECK(r.adopted == 10);
+    CHECK(r.quarantined == 2);
+    CHECK(exists(dir + frameName(1)) && exists(dir + frameName(10)));
+    CHECK(exists(dir + "recuperation/" + frameName(11)));
+    CHECK(fileSize(dir + JOURNAL_NAME) == static_cast<off_t>(11 * sizeof(JournalRecord)));
+
+    // Adoptées une fois pour toutes ; un .raw plus récent que le journal reste suspect
+    writeFile(dir + frameName(13), frameData(13), FRAME_SIZE);
+    writeFile(dir + frameName(13) + ".info", text, text.size());
+    r = FrameJournal::recover(dir, 6);
+    report("dossier adopté", r);
+    CHECK(r.verified == 10);
+    CHECK(r.adopted == 0);
+    CHECK(r.quarantined == 1);
+    CHECK(exists(dir + "recuperation/" + frameName(13)));
+}
+
+// La borne suit la politique de durabilité
+static void bounds()
+{
+    DurabilityPolicy policy;
+    policy.mode = DurabilityMode::None;
+    CHECK(unsyncedFrameBound(policy) == 0);
+    policy.mode = DurabilityMode::File;
+    CHECK(unsyncedFrameBound(policy) == 1);
+    policy.mode = DurabilityMode::Behind;
+    policy.barrierFrames = 5;
+    CHECK(unsyncedFrameBound(policy) == 6);
+    policy.barrierFrames = 40;
+    CHECK(unsyncedFrameBound(policy) == 41);
+    policy.barrierFrames = 1000;
+    CHECK(unsyncedFrameBound(policy) == DurabilityTracker::MAX_PENDING + 1);
+}
+
+int main(int argc, char *argv[])
+{
+    string root;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--dir=", 0) == 0) {
+            root = arg.substr(6);
+        } else {
+            fprintf(stderr, "Usage: %s [--dir=dossier]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (root.empty()) {
+        char templ[] = "/tmp/journal_test.XXXXXX";
+        if (!mkdtemp(templ)) {
+            perror("mkdtemp");
+            return 1;
+        }
+        root = templ;
+    } else {
+        mkdir(root.c_str(), 0777);
+    }
+    printf("Dossier de test : %s\n", root.c_str());
+
+    partFiles(root);
+    tornJournal(root);
+    corruptFrames(root);
+    checkpoints(root);
+    legacyFrames(root);
+    bounds();
+
+    if (failures) {
+        printf("%d vérifications en échec\n", failures);
+        return 1;
+    }
+    printf("Toutes les vérifications sont passées\n");
+    return 0;
+}
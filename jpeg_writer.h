@@ -0,0 +1,138 @@
+// Écriture d'images RGB 8-bit ligne par ligne, en JPEG si libjpeg est disponible
+//
+// Compiler avec -DHAVE_LIBJPEG -ljpeg ; sur Raspberry Pi OS et Debian/Ubuntu, libjpeg est
+// libjpeg-turbo (encodage SIMD NEON/SSE2/AVX2). Sans libjpeg, les images sont écrites en PPM.
+// Les lignes sont compressées au fil de l'eau : l'image entière n'est jamais en mémoire.
+// Une erreur de libjpeg (support plein, erreur d'écriture) fait échouer l'appel en cours
+// au lieu de terminer le programme : le fichier est alors incomplet et close() rend faux.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#ifdef HAVE_LIBJPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+
+// Extension du fichier selon l'encodeur disponible
+inline const char *rgb8Extension()
+{
+#ifdef HAVE_LIBJPEG
+    return ".jpg";
+#else
+    return ".ppm";
+#endif
+}
+
+class Rgb8Writer {
+public:
+    Rgb8Writer() = default;
+    Rgb8Writer(const Rgb8Writer &) = delete;
+    Rgb8Writer &operator=(const Rgb8Writer &) = delete;
+    ~Rgb8Writer() { close(); }
+
+    bool open(const std::string &path, unsigned width, unsigned height, int quality = 85) {
+        close();
+        f_ = fopen(path.c_str(), "wb");
+        if (!f_)
+            return false;
+        width_ = width;
+#ifdef HAVE_LIBJPEG
+        // error_exit par défaut appelle exit() : retour ici par longjmp à la place
+        cinfo_.err = jpeg_std_error(&jerr_.base);
+        jerr_.base.error_exit = onError;
+        jerr_.base.output_message = [](j_common_ptr) {};
+        failed_ = false;
+        jpeg_create_compress(&cinfo_);
+        created_ = true;
+        if (setjmp(jerr_.jump)) {
+            failed_ = true;
+            return false;
+        }
+        jpeg_stdio_dest(&cinfo_, f_);
+        cinfo_.image_width = width;
+        cinfo_.image_height = height;
+        cinfo_.input_components = 3;
+        cinfo_.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo_);
+        jpeg_set_quality(&cinfo_, quality, TRUE);
+        cinfo_.dct_method = JDCT_IFAST;
+        jpeg_start_compress(&cinfo_, TRUE);
+        started_ = true;
+#else
+        (void)quality;
+        fprintf(f_, "P6\n%u %u\n255\n", width, height);
+#endif
+        return true;
+    }
+
+    // `rows` lignes consécutives de width * 3 octets
+    bool writeRows(const uint8_t *rgb, unsigned rows) {
+        if (!f_)
+            return false;
+#ifdef HAVE_LIBJPEG
+        if (failed_ || !started_)
+            return false;
+        if (setjmp(jerr_.jump)) {
+            failed_ = true;
+            return false;
+        }
+        for (unsigned r = 0; r < rows; r++) {
+            JSAMPROW row = const_cast<uint8_t *>(rgb) + static_cast<size_t>(r) * width_ * 3;
+            jpeg_write_scanlines(&cinfo_, &row, 1);
+        }
+        return true;
+#else
+        size_t n = static_cast<size_t>(rows) * width_ * 3;
+        return fwrite(rgb, 1, n, f_) == n;
+#endif
+    }
+
+    bool close() {
+        if (!f_)
+            return false;
+#ifdef HAVE_LIBJPEG
+        // Image incomplète : jpeg_finish_compress() refuserait de terminer
+        bool complete = !failed_ && started_ && cinfo_.next_scanline == cinfo_.image_height && finish();
+        if (created_)
+            jpeg_destroy_compress(&cinfo_);
+        created_ = started_ = false;
+        bool ok = complete && !ferror(f_);
+#else
+        bool ok = !ferror(f_);
+#endif
+        ok = fclose(f_) == 0 && ok;
+        f_ = nullptr;
+        return ok;
+    }
+
+private:
+    FILE *f_ = nullptr;
+    unsigned width_ = 0;
+#ifdef HAVE_LIBJPEG
+    struct ErrorManager {
+        jpeg_error_mgr base; // en premier : libjpeg ne connaît que cette partie
+        std::jmp_buf jump;
+    };
+
+    [[noreturn]] static void onError(j_common_ptr cinfo) {
+        std::longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1);
+    }
+
+    bool finish() {
+        if (setjmp(jerr_.jump))
+            return false;
+        jpeg_finish_compress(&cinfo_);
+        return true;
+    }
+
+    jpeg_compress_struct cinfo_;
+    ErrorManager jerr_;
+    bool created_ = false;
+    bool started_ = false;
+    bool failed_ = false;
+#endif
+};
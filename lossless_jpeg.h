@@ -0,0 +1,230 @@
+// Encodeur JPEG sans perte (ITU T.81 processus 14, "LJ92"), compression standard des DNG
+//
+// Une bande de mosaïque Bayer de largeur W est codée comme une image de W/2 colonnes
+// à 2 composantes entrelacées : le prédicteur "pixel de gauche" compare ainsi deux
+// pixels de même couleur. La table de Huffman est optimale pour chaque bande
+// (procédure de l'annexe K, codes limités à 16 bits).
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class LosslessJpegEncoder {
+public:
+    // data : rows x (width * components) échantillons, precision : bits par échantillon (2..16)
+    void encode(const uint16_t *data, unsigned width, unsigned rows, unsigned components,
+                int precision, std::vector<uint8_t> &out) {
+        out.clear();
+        unsigned rowValues = width * components;
+
+        // Passe 1 : catégories des différences, pour la table de Huffman
+        uint32_t freq[17] = {};
+        forEachDiff(data, width, rows, components, precision, [&](int diff) { freq[category(diff)]++; });
+        buildTable(freq);
+
+        // En-têtes : SOI, DHT, SOF3, SOS
+        marker(out, 0xD8);
+        marker(out, 0xC4);
+        unsigned nsym = 0;
+        for (int i = 0; i < 16; i++)
+            nsym += bits_[i];
+        be16(out, 2 + 1 + 16 + nsym);
+        out.push_back(0x00); // classe 0 (DC), table 0
+        for (int i = 0; i < 16; i++)
+            out.push_back(bits_[i]);
+        out.insert(out.end(), symbols_.begin(), symbols_.end());
+
+        marker(out, 0xC3);
+        be16(out, 8 + 3 * components);
+        out.push_back(static_cast<uint8_t>(precision));
+        be16(out, rows);
+        be16(out, width);
+        out.push_back(static_cast<uint8_t>(components));
+        for (unsigned c = 0; c < components; c++) {
+            out.push_back(static_cast<uint8_t>(c + 1));
+            out.push_back(0x11);
+            out.push_back(0);
+        }
+
+        marker(out, 0xDA);
+        be16(out, 6 + 2 * components);
+        out.push_back(static_cast<uint8_t>(components));
+        for (unsigned c = 0; c < components; c++) {
+            out.push_back(static_cast<uint8_t>(c + 1));
+            out.push_back(0x00);
+        }
+        out.push_back(1); // prédicteur 1 : pixel de gauche
+        out.push_back(0);
+        out.push_back(0);
+
+        // Passe 2 : données entropiques (avec bourrage 0xFF 0x00)
+        bitBuf_ = 0;
+        bitCount_ = 0;
+        out.reserve(out.size() + static_cast<size_t>(rows) * rowValues * 3 / 2);
+        forEachDiff(data, width, rows, components, precision, [&](int diff) {
+            int ssss = category(diff);
+            putBits(out, codes_[ssss], lengths_[ssss]);
+            if (ssss > 0 && ssss < 16) {
+                int v = diff < 0 ? diff + (1 << ssss) - 1 : diff;
+                putBits(out, static_cast<uint32_t>(v) & ((1u << ssss) - 1), ssss);
+            }
+        });
+        // Remplissage du dernier octet avec des 1
+        if (bitCount_ > 0)
+            putBits(out, (1u << (8 - bitCount_)) - 1, 8 - bitCount_);
+        marker(out, 0xD9);
+    }
+
+private:
+    template <typename F>
+    static void forEachDiff(const uint16_t *data, unsigned width, unsigned rows, unsigned components,
+                            int precision, F &&f) {
+        unsigned rowValues = width * components;
+        int modulo = 1 << 16;
+        for (unsigned y = 0; y < rows; y++) {
+            const uint16_t *row = data + static_cast<size_t>(y) * rowValues;
+            const uint16_t *above = row - rowValues;
+            for (unsigned i = 0; i < rowValues; i++) {
+                int pred;
+                if (i < components)
+                    pred = y == 0 ? 1 << (precision - 1) : above[i];
+                else
+                    pred = row[i - components];
+                // Différence modulo 2^16, ramenée dans [-32767, 32768]
+                int diff = (static_cast<int>(row[i]) - pred) & (modulo - 1);
+                if (diff > 32768)
+                    diff -= modulo;
+                f(diff);
+            }
+        }
+    }
+
+    static int category(int diff) {
+        unsigned a = diff < 0 ? -diff : diff;
+        int n = 0;
+        while (a) {
+            n++;
+            a >>= 1;
+        }
+        return n;
+    }
+
+    // Table de Huffman optimale limitée à 16 bits (annexe K.2 de T.81)
+    void buildTable(const uint32_t freqIn[17]) {
+        const int N = 18; // 17 catégories + symbole réservé (aucun code tout à 1)
+        int64_t freq[N];
+        int codesize[N] = {};
+        int others[N];
+        for (int i = 0; i < 17; i++)
+            freq[i] = freqIn[i];
+        freq[17] = 1;
+        for (int i = 0; i < N; i++)
+            others[i] = -1;
+
+        while (true) {
+            int v1 = -1, v2 = -1;
+            for (int i = 0; i < N; i++) {
+                if (freq[i] == 0)
+                    continue;
+                if (v1 < 0 || freq[i] <= freq[v1])
+                    v1 = i;
+            }
+            for (int i = 0; i < N; i++) {
+                if (freq[i] == 0 || i == v1)
+                    continue;
+                if (v2 < 0 || freq[i] <= freq[v2])
+                    v2 = i;
+            }
+            if (v2 < 0)
+                break;
+            freq[v1] += freq[v2];
+            freq[v2] = 0;
+            codesize[v1]++;
+            while (others[v1] >= 0) {
+                v1 = others[v1];
+                codesize[v1]++;
+            }
+            others[v1] = v2;
+            codesize[v2]++;
+            while (others[v2] >= 0) {
+                v2 = others[v2];
+                codesize[v2]++;
+            }
+        }
+
+        int count[33] = {};
+        for (int i = 0; i < N; i++)
+            if (codesize[i])
+                count[codesize[i]]++;
+        for (int i = 32; i > 16; i--) {
+            while (count[i] > 0) {
+                int j = i - 2;
+                while (count[j] == 0)
+                    j--;
+                count[i] -= 2;
+                count[i - 1]++;
+                count[j + 1] += 2;
+                count[j]--;
+            }
+        }
+        int i = 16;
+        while (count[i] == 0)
+            i--;
+        count[i]--; // retire le symbole réservé
+
+        for (int k = 0; k < 16; k++)
+            bits_[k] = static_cast<uint8_t>(count[k + 1]);
+
+        // Symboles triés par longueur de code puis par valeur
+        symbols_.clear();
+        for (int len = 1; len <= 32; len++)
+            for (int s = 0; s < 17; s++)
+                if (codesize[s] == len)
+                    symbols_.push_back(static_cast<uint8_t>(s));
+        symbols_.resize(std::min<size_t>(symbols_.size(), 17));
+
+        // Codes canoniques
+        std::fill(std::begin(lengths_), std::end(lengths_), 0);
+        uint32_t code = 0;
+        size_t k = 0;
+        for (int len = 1; len <= 16; len++) {
+            for (int n = 0; n < bits_[len - 1]; n++, k++) {
+                codes_[symbols_[k]] = code++;
+                lengths_[symbols_[k]] = len;
+            }
+            code <<= 1;
+        }
+    }
+
+    void putBits(std::vector<uint8_t> &out, uint32_t value, int n) {
+        bitBuf_ = (bitBuf_ << n) | value;
+        bitCount_ += n;
+        while (bitCount_ >= 8) {
+            bitCount_ -= 8;
+            uint8_t b = static_cast<uint8_t>(bitBuf_ >> bitCount_);
+            out.push_back(b);
+            if (b == 0xFF)
+                out.push_back(0x00);
+        }
+        bitBuf_ &= (1ull << bitCount_) - 1;
+    }
+
+    static void marker(std::vector<uint8_t> &out, uint8_t m) {
+        out.push_back(0xFF);
+        out.push_back(m);
+    }
+
+    static void be16(std::vector<uint8_t> &out, unsigned v) {
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        out.push_back(static_cast<uint8_t>(v & 0xFF));
+    }
+
+    uint8_t bits_[16] = {};
+    std::vector<uint8_t> symbols_;
+    uint32_t codes_[17] = {};
+    int lengths_[17] = {};
+    uint64_t bitBuf_ = 0;
+    int bitCount_ = 0;
+};
@@ -1,38 +1,125 @@
+// à compiler avec:  g++ -o exe main.cpp $(pkg-config --cflags --libs libcamera) -lpigpio -lpthread -std=c++17
+//
+// Mode simple : une photo RAW par impulsion, prise par une session libcamera
+// persistante (plus de libcamera-still lancé à chaque photo).
+//   sudo ./exe                 -> /home/rpi0/images/
+//   sudo ./exe --usb           -> /mnt/usb/images/
+//   sudo ./exe --dest=dossier  -> dossier au choix
+
 #include <iostream>
 #include <pigpio.h>
 #include <unistd.h>
 #include <iomanip> 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+#include <libcamera/libcamera.h>
+#include <libcamera/control_ids.h>
+
+#include "async_log.h"
+#include "camera_session.h"
+#include "durability.h"
+#include "frame_journal.h"
+#include "raw_writer.h"
 
 using namespace std;
+using namespace libcamera;
 int nbImpulsions = 0 ; // compteur d'impulsion 
 int clk_externe = 0; // la clock externe donné par le GPS 
-bool impulsion = false; // True si il y a eu une impulsion False sinon 
+atomic<bool> impulsion{false}; // True si il y a eu une impulsion False sinon 
 int gpio_imp = 17; // GPIO pour les impulsions
 int gpio_clk = 27; // GPIO pour la clock externe
+string dossier = "/home/rpi0/images/"; // destination des photos (SD par défaut)
+
+// Session caméra ouverte une seule fois au démarrage
+static CameraSession session;
+static mutex mtx;
+static condition_variable cv;
+static Request *requeteTerminee = nullptr;
+static vector<FrameLease *> requetesEnRetard; // capture abandonnée après le délai, rendue à son retour
+static ControlList controlesPhoto; // équivalent de --shutter 20000 --gain 1.0 --lens-position 0.0 --awb auto
+
+// Remplace le "sync" global après chaque photo (--sync=none|file|behind, --sync-frames=N, --sync-ms=T)
+static DurabilityPolicy politiqueSync;
+static DurabilityTracker durabilite;
+static FrameJournal journal; // protocole d'écriture journalisé (frame_journal.h)
 
  
 // Fonction 
 
+static void requestComplete(Request *request) {
+    FrameLease *enRetard = nullptr;
+    {
+        lock_guard<mutex> lock(mtx);
+        for (auto it = requetesEnRetard.begin(); it != requetesEnRetard.end(); ++it) {
+            if ((*it)->request == request) {
+                enRetard = *it;
+                requetesEnRetard.erase(it);
+                break;
+            }
+        }
+        if (!enRetard)
+            requeteTerminee = request;
+    }
+    // Requête terminée (ou annulée) après l'abandon de sa photo : seul le buffer est récupéré
+    if (enRetard) {
+        session.lender.giveBack(enRetard);
+        LOG_WARN("Capture en retard revenue, buffer récupéré");
+        return;
+    }
+    cv.notify_one();
+}
+
 string prendre_photo(){
     // Génère un nom de fichier avec le format : photo_nbImpulsions_clk_externe_clk_interne
-    string nomFichier = "/home/rpi0/images/photo_" + to_string(nbImpulsions) + "_" + 
+    string nomFichier = dossier + "photo_" + to_string(nbImpulsions) + "_" + 
                         to_string(clk_externe) + "_" + 
-                        to_string(gpioTick()) + ".dng";
-    
-    // Construit la commande libcamera-still
-    string commande = "libcamera-still --raw -o " + nomFichier + " --width 4608 --height 2592 --nopreview -t 1" // Si problème lors de la capture "erreur lors de la prise de photo", remplacez libcamera-still par rpicam-still
-    " --exposure sport --shutter 20000 --gain 1.0 --autofocus-mode manual --lens-position 0.0 --awb auto 2>/dev/null";
-    // La deuxième ligne améliore la vitesse de capture
-
-    // Exécute la commande
-    int resultat = system(commande.c_str());
-    system("sync");
+                        to_string(gpioTick()) + ".raw";
+
+    FrameLease *lease = session.lender.take();
+    if (!lease) {
+        LOG_ERROR("Erreur lors de la prise de photo (aucun buffer libre)");
+        return "";
+    }
+
+    Request *request = lease->request;
+    request->controls().merge(controlesPhoto);
+    {
+        lock_guard<mutex> lock(mtx);
+        requeteTerminee = nullptr;
+    }
+    if (session.camera()->queueRequest(request) < 0) {
+        session.lender.giveBack(lease);
+        LOG_ERROR("Erreur lors de la prise de photo");
+        return "";
+    }
+
+    // Attendre la fin de la capture (le capteur est déjà configuré et démarré)
+    bool termine;
+    {
+        unique_lock<mutex> lock(mtx);
+        termine = cv.wait_for(lock, chrono::seconds(2), [request] { return requeteTerminee == request; });
+        // Sous le même verrou : la requête ne peut pas revenir entre le délai et l'inscription
+        if (!termine)
+            requetesEnRetard.push_back(lease);
+    }
+
+    bool resultat = termine && request->status() == Request::RequestComplete &&
+                    writeRawFrame(nomFichier, lease->data, lease->size, session.streamConfig(), durabilite, journal);
+    if (termine)
+        session.lender.giveBack(lease);
     
-    if (resultat == 0) {
-        cout << "Photo prise : " << nomFichier << endl;
+    if (resultat) {
+        LOG_INFO("Photo prise : {}", nomFichier.c_str() + dossier.size());
         return nomFichier;
     } else {
-        cerr << "Erreur lors de la prise de photo" << endl;
+        LOG_ERROR("Erreur lors de la prise de photo");
         return "";
     }
 }
@@ -51,15 +138,77 @@ void rising_callback_impul(int gpio, int level, uint32_t tick) {
     }
 }
 
+// Entier positif sans caractère en trop : une faute de frappe affiche l'usage
+static bool lireEntier(const string &texte, int &valeur) {
+    if (texte.empty() || texte[0] < '0' || texte[0] > '9')
+        return false;
+    char *fin = nullptr;
+    errno = 0;
+    unsigned long v = strtoul(texte.c_str(), &fin, 10);
+    if (errno != 0 || *fin != '\0' || v > INT_MAX)
+        return false;
+    valeur = static_cast<int>(v);
+    return true;
+}
+
 //main 
-int main(){
+int main(int argc, char *argv[]){
+    requetesEnRetard.reserve(2);
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--usb") {
+            dossier = "/mnt/usb/images/";
+        } else if (arg.rfind("--dest=", 0) == 0) {
+            dossier = arg.substr(7);
+            if (dossier.empty() || dossier.back() != '/')
+                dossier += '/';
+        } else if (arg.rfind("--sync=", 0) == 0 && parseDurabilityMode(arg.substr(7), politiqueSync.mode)) {
+        } else if (arg.rfind("--sync-frames=", 0) == 0 && lireEntier(arg.substr(14), politiqueSync.barrierFrames)) {
+        } else if (arg.rfind("--sync-ms=", 0) == 0 && lireEntier(arg.substr(10), politiqueSync.barrierMs)) {
+        } else {
+            cerr << "Usage: " << argv[0] << " [--usb | --dest=dossier] [--sync=none|file|behind] [--sync-frames=N] [--sync-ms=T]" << endl;
+            return 1;
+        }
+    }
+
+    // Remise en état du dossier après une éventuelle coupure pendant le vol précédent
+    RecoveryReport recuperation = FrameJournal::recover(dossier, unsyncedFrameBound(politiqueSync));
+    cout << "Récupération: " << recuperation.verified << " images valides, " << recuperation.repaired
+         << " réparées, " << recuperation.quarantined << " déplacées dans recuperation/, "
+         << recuperation.adopted << " antérieures au journal" << endl;
+    if (!journal.open(dossier))
+        cerr << "Erreur: impossible d'ouvrir le journal d'écriture" << endl;
+
+    durabilite.configure(politiqueSync, dossier);
+    durabilite.setJournal(journal.fd());
+
+    // Capture synchrone (une photo à la fois) : le second buffer sert la photo suivante
+    // tant qu'une capture abandonnée après le délai n'est pas revenue
+    if (!session.open(4608, 2592, formats::SBGGR10_CSI2P, 2))
+        return 1;
+
+    controlesPhoto.set(controls::AeEnable, false);
+    controlesPhoto.set(controls::ExposureTime, 20000);
+    controlesPhoto.set(controls::AnalogueGain, 1.0f);
+    controlesPhoto.set(controls::AwbEnable, true);
+    controlesPhoto.set(controls::AfMode, controls::AfModeManual);
+    controlesPhoto.set(controls::LensPosition, 0.0f);
+
+    if (!session.start(requestComplete)) {
+        session.close();
+        return 1;
+    }
 
     if (gpioInitialise() < 0) {
         std::cerr << "Erreur : Pigpio init failed\n";
+        session.close();
         return 1;
     }
 
     std::cout << "Programme démarré, test ISR sur GPIO 17 et 27\n";
+    std::cout << "Destination : " << dossier << std::endl;
+    asyncLog().start(); // messages par photo écrits par un thread de fond
 
     gpioSetMode(gpio_imp, PI_INPUT);
     gpioSetMode(gpio_clk, PI_INPUT);
@@ -73,11 +222,11 @@ int main(){
     
 
     while (true){
-        if (impulsion == true){
-            std::cout << "impulsion reçue\n";
-            impulsion = false;
+        if (impulsion.exchange(false)){
+            LOG_INFO("impulsion reçue");
             string photo = prendre_photo();
         }
+        durabilite.poll(); // barrière en temps même sans nouvelle photo
         usleep(1000); // Attendre 1 ms pour éviter une boucle trop rapide
     }
 }
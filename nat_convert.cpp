@@ -0,0 +1,825 @@
+// à compiler avec:  g++ -O2 -o nat_convert nat_convert.cpp -lz -lpthread -std=c++17
+//   compression zstd : ajouter -DHAVE_ZSTD -lzstd
+//   aperçus JPEG (--jpeg) : ajouter -DHAVE_LIBJPEG -ljpeg (libjpeg-turbo), sinon PPM
+//
+// Convertisseur au sol des images .raw (+ .raw.info) en TIFF 16-bit ou en DNG, version native de convert.py :
+//   ./nat_convert photo.raw [autre.raw...]
+//   ./nat_convert --batch images/
+//   ./nat_convert --dng --jobs=4 --batch images/
+//   ./nat_convert --dng --watch images/     (convertit les images au fil de leur arrivée)
+// Options :
+//   --compression=deflate|lzw|zstd|ljpeg|none   (deflate en TIFF, ljpeg en DNG)
+//   --threads=N    threads de compression (tous les cœurs par défaut)
+//   --jobs=N       fichiers convertis en même temps (les threads sont partagés)
+//   --boost=X      multiplie la luminosité (1.0 par défaut, TIFF et JPEG)
+//   --black=N      niveau de noir 10-bit : retiré du TIFF (RGB et --cfa, 0 par défaut comme convert.py),
+//                  remplace black_level du .info pour --jpeg et le tag BlackLevel du DNG
+//   --cfa          écrit la mosaïque Bayer (1 canal, motif CFA) sans dématriçage
+//   --dng          écrit un DNG (mosaïque brute 10-bit + métadonnées), sans dématriçage
+//   --jpeg         aperçu 8-bit sRGB (balance des blancs, courbe de tons), un fichier par cœur
+//   --scale=1|2|4  réduction de l'aperçu JPEG (2 par défaut : un pixel par quad Bayer)
+//   --quality=N    qualité JPEG (85 par défaut)
+//   --wb=R,B       gains rouge/bleu de l'aperçu (red_gain/blue_gain du .info par défaut)
+//   --watch dir    convertit le dossier puis surveille (inotify) les nouvelles images
+//   --cache=f      registre des conversions faites (dossier/.nat_convert_done par défaut)
+//   --force        reconvertit même les images déjà présentes dans le registre
+//
+// Avec --batch et --watch, les images déjà converties dans le même mode (taille, date
+// et empreinte inchangées, sortie présente) sont sautées : relancer ne coûte presque rien.
+// Le .raw est lu par bandes depuis un mapping mémoire ; chaque bande est dématricée
+// (plus proche voisin, comme convert.py) puis compressée en parallèle (tiff_writer.h).
+// En CSI2P, dépaquetage, noir, gain, dématriçage et statistiques sont faits en une seule
+// passe par le noyau fusionné de bayer_kernel.h.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <ctime>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+#include "bayer_kernel.h"
+#include "convert_cache.h"
+#include "dng_writer.h"
+#include "frame_journal.h"
+#include "jpeg_writer.h"
+#include "raw_reader.h"
+#include "tiff_writer.h"
+
+using namespace std;
+
+struct ConvertOptions {
+    TiffCompression compression = TiffCompression::Deflate;
+    bool compressionSet = false;
+    unsigned threads = 0;
+    unsigned jobs = 1;
+    float boost = 1.0f;
+    unsigned black = 0;
+    bool blackSet = false; // --black donné : remplace black_level du .info (DNG, JPEG)
+    bool cfa = false;
+    bool dng = false;
+    bool jpeg = false;
+    unsigned scale = 2;
+    int quality = 85;
+    float wbRed = 0.0f;   // 0 = gains du .info
+    float wbBlue = 0.0f;
+    bool force = false;
+};
+
+static std::mutex outMtx; // lignes de compte rendu des conversions parallèles
+
+// Noir (10-bit, comme --black) puis gain sur des valeurs 16-bit, comme la table du noyau fusionné
+static void applyLevels(uint16_t *row, unsigned n, unsigned black, float boost)
+{
+    if (black == 0 && boost == 1.0f)
+        return;
+    unsigned black16 = black << 6;
+    for (unsigned x = 0; x < n; x++) {
+        unsigned base = row[x] > black16 ? row[x] - black16 : 0;
+        row[x] = static_cast<uint16_t>(std::min(base * boost, 65535.0f));
+    }
+}
+
+// Dématriçage plus proche voisin d'une paire de lignes : R et B répétés sur le quad,
+// vert moyen là où il manque
+static void demosaicPair(const uint16_t *top, const uint16_t *bottom, unsigned width,
+                         const BayerLayout &l, uint16_t *outTop, uint16_t *outBottom)
+{
+    const uint16_t *rows[2] = {top, bottom};
+    uint16_t *outs[2] = {outTop, outBottom};
+    for (unsigned x = 0; x + 1 < width; x += 2) {
+        uint16_t r = rows[l.r[0]][x + l.r[1]];
+        uint16_t b = rows[l.b[0]][x + l.b[1]];
+        uint16_t g1 = rows[l.g1[0]][x + l.g1[1]];
+        uint16_t g2 = rows[l.g2[0]][x + l.g2[1]];
+        uint16_t g = static_cast<uint16_t>((static_cast<uint32_t>(g1) + g2) / 2);
+        for (int dy = 0; dy < 2; dy++) {
+            for (int dx = 0; dx < 2; dx++) {
+                uint16_t *p = outs[dy] + (x + dx) * 3;
+                p[0] = r;
+                p[2] = b;
+                if (dy == l.g1[0] && dx == l.g1[1])
+                    p[1] = g1;
+                else if (dy == l.g2[0] && dx == l.g2[1])
+                    p[1] = g2;
+                else
+                    p[1] = g;
+            }
+        }
+    }
+}
+
+static bool convertToTiff(const string &rawPath, const ConvertOptions &opt)
+{
+    auto start = chrono::steady_clock::now();
+
+    RawInfo info;
+    if (!readRawInfo(rawPath + ".info", info)) {
+        cerr << "Fichier .info introuvable ou invalide: " << rawPath << ".info" << endl;
+        return false;
+    }
+    MappedFile raw;
+    if (!raw.open(rawPath)) {
+        cerr << "Fichier introuvable: " << rawPath << endl;
+        return false;
+    }
+
+    string outPath = rawPath.substr(0, rawPath.rfind('.')) + ".tif";
+    TiffWriter::Image image;
+    image.width = info.width;
+    image.height = info.height;
+    image.compression = opt.compression;
+    image.samples = opt.cfa ? 1 : 3;
+    image.photometric = opt.cfa ? 32803 : 2;
+
+    TiffWriter tiff;
+    if (!tiff.open(outPath, image)) {
+        cerr << "Impossible de créer " << outPath << endl;
+        return false;
+    }
+
+    BayerLayout layout = bayerLayout(info.pattern());
+    if (opt.cfa) {
+        // Motif CFA (TIFF/EP) : 0 = rouge, 1 = vert, 2 = bleu
+        uint16_t dim[2] = {2, 2};
+        uint8_t cfa[4];
+        cfa[layout.r[0] * 2 + layout.r[1]] = 0;
+        cfa[layout.g1[0] * 2 + layout.g1[1]] = 1;
+        cfa[layout.g2[0] * 2 + layout.g2[1]] = 1;
+        cfa[layout.b[0] * 2 + layout.b[1]] = 2;
+        tiff.addTag(33421, TIFF_SHORT, 2, dim, sizeof(dim));
+        tiff.addTag(33422, TIFF_BYTE, 4, cfa, sizeof(cfa));
+    }
+
+    unsigned width = info.width;
+    unsigned height = info.height;
+
+    // CSI2P en RGB : une seule passe du mapping vers la bande de sortie
+    bool fused = info.csi2p() && !opt.cfa;
+    FusedParams params;
+    buildFusedParams(params, info.pattern(), opt.black, opt.boost);
+    RawStats stats;
+    std::mutex statsMtx;
+
+    auto fill = [&](unsigned y0, unsigned rows, uint16_t *dst) -> bool {
+        if (fused) {
+            thread_local vector<uint16_t> spare;
+            RawStats local;
+            for (unsigned r = 0; r < rows; r += 2) {
+                unsigned y = y0 + r;
+                unsigned yb = y + 1 < height ? y + 1 : y; // hauteur impaire : dernière ligne répétée
+                if (static_cast<size_t>(yb + 1) * info.stride > raw.size())
+                    return false;
+                uint16_t *outTop = dst + static_cast<size_t>(r) * width * 3;
+                uint16_t *outBottom = outTop + static_cast<size_t>(width) * 3;
+                if (r + 1 >= rows) {
+                    spare.resize(static_cast<size_t>(width) * 3);
+                    outBottom = spare.data();
+                }
+                fusedCsi2pPair(raw.data() + static_cast<size_t>(y) * info.stride,
+                               raw.data() + static_cast<size_t>(yb) * info.stride, width, params,
+                               outTop, outBottom, local);
+            }
+            std::lock_guard<std::mutex> lock(statsMtx);
+            stats.merge(local);
+            return true;
+        }
+        if (opt.cfa) {
+            for (unsigned r = 0; r < rows; r++) {
+                uint16_t *row = dst + static_cast<size_t>(r) * width;
+                if (!readRawRow16(info, raw, y0 + r, row))
+                    return false;
+                applyLevels(row, width, opt.black, opt.boost);
+            }
+            return true;
+        }
+        // Paires de lignes Bayer ; la dernière ligne d'une hauteur impaire est répétée
+        thread_local vector<uint16_t> pair;
+        pair.resize(static_cast<size_t>(width) * 2);
+        thread_local vector<uint16_t> spare;
+        for (unsigned r = 0; r < rows; r += 2) {
+            unsigned y = y0 + r;
+            uint16_t *top = pair.data();
+            uint16_t *bottom = pair.data() + width;
+            if (!readRawRow16(info, raw, y, top))
+                return false;
+            if (y + 1 < height) {
+                if (!readRawRow16(info, raw, y + 1, bottom))
+                    return false;
+            } else {
+                memcpy(bottom, top, width * 2);
+            }
+            applyLevels(pair.data(), width * 2, opt.black, opt.boost);
+
+            uint16_t *outTop = dst + static_cast<size_t>(r) * width * 3;
+            uint16_t *outBottom = outTop + static_cast<size_t>(width) * 3;
+            if (r + 1 >= rows) {
+                // Bande de hauteur impaire : la ligne du bas n'est pas écrite
+                spare.resize(static_cast<size_t>(width) * 3);
+                outBottom = spare.data();
+            }
+            demosaicPair(top, bottom, width, layout, outTop, outBottom);
+        }
+        return true;
+    };
+
+    bool ok = tiff.writeStrips(fill, opt.threads);
+    ok = tiff.close() && ok;
+    if (!ok) {
+        cerr << "Échec de la conversion de " << rawPath << endl;
+        unlink(outPath.c_str());
+        return false;
+    }
+
+    long ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(outMtx);
+    cout << rawPath << " -> " << outPath << " (" << ms << " ms";
+    if (fused)
+        cout << ", min=" << stats.min << " max=" << stats.max << " moy=" << std::fixed << std::setprecision(1)
+             << stats.mean() << " saturés=" << std::setprecision(2) << 100.0 * stats.clipped / std::max<uint64_t>(1, stats.count)
+             << " %" << std::defaultfloat;
+    cout << ")" << endl;
+    return true;
+}
+
+static double infoNumber(const RawInfo &info, const string &key)
+{
+    try {
+        return stod(info.get(key, "0"));
+    } catch (const exception &) {
+        return 0.0;
+    }
+}
+
+// Mosaïque brute en DNG : pas de dématriçage, valeurs 10-bit d'origine
+static bool convertToDng(const string &rawPath, const ConvertOptions &opt)
+{
+    auto start = chrono::steady_clock::now();
+
+    RawInfo info;
+    if (!readRawInfo(rawPath + ".info", info)) {
+        cerr << "Fichier .info introuvable ou invalide: " << rawPath << ".info" << endl;
+        return false;
+    }
+    MappedFile raw;
+    if (!raw.open(rawPath)) {
+        cerr << "Fichier introuvable: " << rawPath << endl;
+        return false;
+    }
+
+    DngMetadata meta;
+    meta.pattern = info.pattern();
+    size_t pixels = static_cast<size_t>(info.width) * info.height;
+    DngRowFn readRow;
+    if (info.csi2p()) {
+        readRow = [&](unsigned y, uint16_t *dst) {
+            if (static_cast<size_t>(y + 1) * info.stride > raw.size())
+                return false;
+            unpackCsi2pRow(raw.data() + static_cast<size_t>(y) * info.stride, info.width, dst);
+            return true;
+        };
+    } else if (raw.size() == pixels * 2) {
+        meta.blackLevel = 0;
+        meta.whiteLevel = 65535;
+        readRow = [&](unsigned y, uint16_t *dst) { return readRawRow16(info, raw, y, dst); };
+    } else if (raw.size() == pixels) {
+        meta.blackLevel = 0;
+        meta.whiteLevel = 255;
+        readRow = [&](unsigned y, uint16_t *dst) {
+            memcpy(dst, raw.data() + static_cast<size_t>(y) * info.width, info.width);
+            for (unsigned x = info.width; x-- > 0;)
+                dst[x] = reinterpret_cast<const uint8_t *>(dst)[x];
+            return true;
+        };
+    } else {
+        cerr << "Format non reconnu: " << rawPath << endl;
+        return false;
+    }
+    if (!info.get("black_level").empty())
+        meta.blackLevel = static_cast<uint32_t>(infoNumber(info, "black_level"));
+    // Mosaïque d'origine conservée : --black devient le niveau de noir déclaré, à l'échelle
+    // des valeurs du fichier (10 bits en CSI2P, 16 ou 8 bits sinon)
+    if (opt.blackSet)
+        meta.blackLevel = meta.whiteLevel == 65535 ? opt.black << 6
+                          : meta.whiteLevel == 255 ? opt.black >> 2 : opt.black;
+
+    // Métadonnées de prise de vue écrites au vol dans le .info
+    meta.exposureUs = infoNumber(info, "exposure_us");
+    meta.analogueGain = infoNumber(info, "analogue_gain");
+    meta.redGain = infoNumber(info, "red_gain");
+    meta.blueGain = infoNumber(info, "blue_gain");
+    if (!info.get("pulse").empty())
+        meta.description = "impulsion=" + info.get("pulse") + " clk=" + info.get("clk") +
+                           " tick=" + info.get("tick") + " timestamp_capteur=" + info.get("sensor_timestamp");
+    struct stat st;
+    if (stat(rawPath.c_str(), &st) == 0) {
+        char date[32];
+        strftime(date, sizeof(date), "%Y:%m:%d %H:%M:%S", localtime(&st.st_mtime));
+        meta.dateTime = date;
+    }
+
+    string outPath = rawPath.substr(0, rawPath.rfind('.')) + ".dng";
+    TiffCompression compression = opt.compressionSet ? opt.compression : TiffCompression::LosslessJpeg;
+    if (!writeDng(outPath, info.width, info.height, readRow, meta, compression, opt.threads)) {
+        cerr << "Échec de la conversion de " << rawPath << " (compression DNG: ljpeg ou none)" << endl;
+        unlink(outPath.c_str());
+        return false;
+    }
+
+    long ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(outMtx);
+    cout << rawPath << " -> " << outPath << " (" << ms << " ms)" << endl;
+    return true;
+}
+
+// Tables de tons de l'aperçu, une par couleur, indexées par la valeur 10-bit :
+// noir retiré, balance des blancs et boost, épaule douce sur les hautes lumières, puis sRGB
+struct ToneTables {
+    uint8_t lut[3][1024];
+};
+
+static void buildToneTables(ToneTables &t, unsigned black, unsigned white, const float gains[3], float boost)
+{
+    const double knee = 0.8;
+    for (int c = 0; c < 3; c++) {
+        for (unsigned v = 0; v < 1024; v++) {
+            double x = v > black ? double(v - black) / (white - black) * gains[c] * boost : 0.0;
+            if (x > knee)
+                x = knee + (1.0 - knee) * (1.0 - std::exp(-(x - knee) / (1.0 - knee)));
+            double y = x <= 0.0031308 ? 12.92 * x : 1.055 * std::pow(x, 1.0 / 2.4) - 0.055;
+            t.lut[c][v] = static_cast<uint8_t>(std::lround(std::min(1.0, y) * 255.0));
+        }
+    }
+}
+
+// Aperçu JPEG 8-bit, réduit d'un facteur 1, 2 ou 4, écrit au fil des lignes
+static bool convertToJpeg(const string &rawPath, const ConvertOptions &opt)
+{
+    auto start = chrono::steady_clock::now();
+
+    RawInfo info;
+    if (!readRawInfo(rawPath + ".info", info)) {
+        cerr << "Fichier .info introuvable ou invalide: " << rawPath << ".info" << endl;
+        return false;
+    }
+    MappedFile raw;
+    if (!raw.open(rawPath)) {
+        cerr << "Fichier introuvable: " << rawPath << endl;
+        return false;
+    }
+
+    unsigned width = info.width;
+    unsigned height = info.height;
+    unsigned scale = opt.scale;
+    unsigned outWidth = width / scale;
+    unsigned outHeight = scale == 1 ? height : height / scale;
+    if (outWidth == 0 || outHeight == 0) {
+        cerr << "Image trop petite pour --scale=" << scale << ": " << rawPath << endl;
+        return false;
+    }
+
+    // Valeurs lues en 16 bits puis ramenées sur 10 bits ; noir de l'IMX708 en CSI2P
+    unsigned black = info.csi2p() ? 64 : 0;
+    if (!info.get("black_level").empty())
+        black = static_cast<unsigned>(infoNumber(info, "black_level"));
+    if (opt.blackSet)
+        black = opt.black;
+    float gains[3] = {opt.wbRed > 0.0f ? opt.wbRed : static_cast<float>(infoNumber(info, "red_gain")), 1.0f,
+                      opt.wbBlue > 0.0f ? opt.wbBlue : static_cast<float>(infoNumber(info, "blue_gain"))};
+    if (gains[0] <= 0.0f || gains[2] <= 0.0f)
+        gains[0] = gains[2] = 1.0f;
+    ToneTables tone;
+    buildToneTables(tone, std::min(black, 1022u), 1023, gains, opt.boost);
+
+    string outPath = rawPath.substr(0, rawPath.rfind('.')) + rgb8Extension();
+    Rgb8Writer out;
+    if (!out.open(outPath, outWidth, outHeight, opt.quality)) {
+        cerr << "Impossible de créer " << outPath << endl;
+        return false;
+    }
+
+    BayerLayout l = bayerLayout(info.pattern());
+    unsigned group = std::max(2u, scale); // lignes Bayer lues par itération
+    vector<uint16_t> rows(static_cast<size_t>(width) * group);
+    vector<uint16_t> rgb16(static_cast<size_t>(width) * 3 * 2);
+    vector<uint8_t> rgb8(static_cast<size_t>(outWidth) * 3 * 2);
+    bool ok = true;
+    unsigned written = 0;
+    for (unsigned y = 0; ok && written < outHeight; y += group) {
+        for (unsigned r = 0; r < group; r++) {
+            uint16_t *row = rows.data() + static_cast<size_t>(r) * width;
+            if (y + r < height) {
+                ok = ok && readRawRow16(info, raw, y + r, row);
+                for (unsigned x = 0; x < width; x++)
+                    row[x] >>= 6;
+            } else {
+                memcpy(row, row - width, width * 2); // hauteur impaire : dernière ligne répétée
+            }
+        }
+
+        unsigned produced;
+        if (scale == 1) {
+            // Pleine définition : dématriçage plus proche voisin, comme le TIFF
+            demosaicPair(rows.data(), rows.data() + width, width, l, rgb16.data(), rgb16.data() + width * 3);
+            for (size_t i = 0; i < static_cast<size_t>(outWidth) * 2; i++)
+                for (int c = 0; c < 3; c++)
+                    rgb8[i * 3 + c] = tone.lut[c][rgb16[i * 3 + c]];
+            produced = std::min(2u, outHeight - written);
+        } else {
+            // Un pixel par bloc scale x scale : moyenne des quads Bayer du bloc
+            unsigned quads = scale / 2;
+            for (unsigned x = 0; x < outWidth; x++) {
+                uint32_t sr = 0, sg = 0, sb = 0;
+                for (unsigned qy = 0; qy < quads; qy++) {
+                    const uint16_t *rp[2] = {rows.data() + static_cast<size_t>(qy * 2) * width,
+                                             rows.data() + static_cast<size_t>(qy * 2 + 1) * width};
+                    for (unsigned qx = 0; qx < quads; qx++) {
+                        unsigned x0 = x * scale + qx * 2;
+                        sr += rp[l.r[0]][x0 + l.r[1]];
+                        sg += rp[l.g1[0]][x0 + l.g1[1]] + rp[l.g2[0]][x0 + l.g2[1]];
+                        sb += rp[l.b[0]][x0 + l.b[1]];
+                    }
+                }
+                unsigned n = quads * quads;
+                rgb8[x * 3 + 0] = tone.lut[0][sr / n];
+                rgb8[x * 3 + 1] = tone.lut[1][sg / (2 * n)];
+                rgb8[x * 3 + 2] = tone.lut[2][sb / n];
+            }
+            produced = 1;
+        }
+        ok = ok && out.writeRows(rgb8.data(), produced);
+        written += produced;
+    }
+    ok = out.close() && ok;
+    if (!ok) {
+        cerr << "Échec de la conversion de " << rawPath << endl;
+        unlink(outPath.c_str());
+        return false;
+    }
+
+    long ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(outMtx);
+    cout << rawPath << " -> " << outPath << " (" << ms << " ms)" << endl;
+    return true;
+}
+
+static vector<string> listRawFiles(const string &directory)
+{
+    vector<string> files;
+    string dir = directory;
+    if (!dir.empty() && dir.back() != '/')
+        dir += '/';
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return files;
+    while (dirent *e = readdir(d)) {
+        string name = e->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".raw") == 0)
+            files.push_back(dir + name);
+    }
+    closedir(d);
+    sort(files.begin(), files.end());
+    return files;
+}
+
+enum class ConvertResult { Converted, Skipped, Pending, Failed };
+
+// Décrit la sortie, pour qu'un changement d'options reconvertisse les images
+static string cacheMode(const ConvertOptions &opt)
+{
+    if (opt.jpeg)
+        return string("jpg") + rgb8Extension() + ":" + to_string(opt.scale) + ":" + to_string(opt.quality) +
+               ":wb=" + to_string(opt.wbRed) + "," + to_string(opt.wbBlue) + ":boost=" + to_string(opt.boost) +
+               (opt.blackSet ? ":noir=" + to_string(opt.black) : string());
+    if (opt.dng)
+        return "dng:" + to_string(static_cast<int>(opt.compressionSet ? opt.compression
+                                                                       : TiffCompression::LosslessJpeg)) +
+               (opt.blackSet ? ":noir=" + to_string(opt.black) : string());
+    return "tif:" + to_string(static_cast<int>(opt.compression)) + (opt.cfa ? ":cfa" : ":rgb") +
+           ":boost=" + to_string(opt.boost) + (opt.black ? ":noir=" + to_string(opt.black) : string());
+}
+
+static string outputPath(const string &rawPath, const ConvertOptions &opt)
+{
+    if (opt.jpeg)
+        return rawPath.substr(0, rawPath.rfind('.')) + rgb8Extension();
+    return rawPath.substr(0, rawPath.rfind('.')) + (opt.dng ? ".dng" : ".tif");
+}
+
+// Conversion d'une image si elle est complète et pas déjà faite ; `cache` peut être nul
+static ConvertResult convertFile(const string &rawPath, const ConvertOptions &opt, ConvertCache *cache)
+{
+    struct stat st;
+    RawInfo info;
+    if (stat(rawPath.c_str(), &st) != 0 || !readRawInfo(rawPath + ".info", info))
+        return ConvertResult::Pending; // .raw ou .info pas encore arrivé
+    // Copie en cours : la longueur annoncée par le .info n'est pas encore atteinte
+    if (!info.get("length").empty() && info.get("length") != to_string(st.st_size))
+        return ConvertResult::Pending;
+
+    char resolved[PATH_MAX];
+    string key = realpath(rawPath.c_str(), resolved) ? string(resolved) : rawPath;
+    int64_t mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    string mode = cacheMode(opt);
+
+    uint64_t hash = 0;
+    bool hashed = false;
+    auto contentHash = [&]() {
+        if (!hashed) {
+            MappedFile raw;
+            if (raw.open(rawPath))
+                hash = frameChecksum(raw.data(), raw.size());
+            hashed = true;
+        }
+        return hash;
+    };
+
+    struct stat out;
+    if (cache && !opt.force && stat(outputPath(rawPath, opt).c_str(), &out) == 0 &&
+        cache->done(mode, key, st.st_size, mtimeNs, contentHash))
+        return ConvertResult::Skipped;
+
+    // Même somme que celle calculée à bord : le transfert n'a rien abîmé
+    string expected = info.get("checksum");
+    if (!expected.empty() && strtoull(expected.c_str(), nullptr, 16) != contentHash()) {
+        std::lock_guard<std::mutex> lock(outMtx);
+        cerr << "Somme de contrôle incorrecte, image ignorée: " << rawPath << endl;
+        return ConvertResult::Failed;
+    }
+
+    bool ok = opt.jpeg ? convertToJpeg(rawPath, opt)
+              : opt.dng ? convertToDng(rawPath, opt) : convertToTiff(rawPath, opt);
+    if (!ok)
+        return ConvertResult::Failed;
+    if (cache)
+        cache->record(mode, key, st.st_size, mtimeNs, contentHash());
+    return ConvertResult::Converted;
+}
+
+// File des images à convertir, partagée par les --jobs threads
+class ConvertQueue {
+public:
+    void push(const string &path) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        // En cours de conversion : reprise par done(), jamais deux workers sur la même sortie
+        if (active_.count(path)) {
+            again_.insert(path);
+            return;
+        }
+        if (queued_.insert(path).second) {
+            paths_.push_back(path);
+            cv_.notify_one();
+        }
+    }
+
+    bool pop(string &path) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this] { return closed_ || !paths_.empty(); });
+        if (paths_.empty())
+            return false;
+        path = paths_.front();
+        paths_.pop_front();
+        queued_.erase(path);
+        active_.insert(path);
+        return true;
+    }
+
+    // Fin de la conversion de `path` (obtenu par pop) : remise en file si elle a été
+    // proposée de nouveau entre-temps (fichier réécrit, .info arrivé pendant la conversion)
+    void done(const string &path) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        active_.erase(path);
+        if (again_.erase(path) && queued_.insert(path).second) {
+            paths_.push_back(path);
+            cv_.notify_one();
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<string> paths_;
+    std::set<string> queued_; // une image déjà en attente n'est pas ajoutée deux fois
+    std::set<string> active_; // en cours de conversion
+    std::set<string> again_;  // proposées de nouveau pendant leur conversion
+    bool closed_ = false;
+};
+
+static volatile sig_atomic_t stopWatching = 0;
+
+static void onSignal(int)
+{
+    stopWatching = 1;
+}
+
+// Surveillance posée avant de lister le dossier : une image arrivée entre les deux est
+// vue par les deux (la file ignore le doublon) plutôt que par aucun ; -1 en cas d'échec
+static int openWatch(const string &dir)
+{
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0 || inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        cerr << "Impossible de surveiller " << dir << ": " << strerror(errno) << endl;
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Surveille `dir` jusqu'à SIGINT/SIGTERM : une image est proposée dès que son .raw ou
+// son .info est refermé ou renommé ; convertFile attend que les deux soient complets
+static void watchDirectory(int fd, const string &dir, ConvertQueue &queue)
+{
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    cout << "Surveillance de " << dir << " (Ctrl+C pour arrêter)" << endl;
+
+    alignas(inotify_event) char buf[16384];
+    while (!stopWatching) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 500) <= 0)
+            continue;
+        ssize_t n = read(fd, buf, sizeof(buf));
+        for (ssize_t off = 0; off < n;) {
+            const inotify_event *ev = reinterpret_cast<const inotify_event *>(buf + off);
+            off += sizeof(inotify_event) + ev->len;
+            if (ev->len == 0)
+                continue;
+            string name = ev->name;
+            if (name.size() > 9 && name.compare(name.size() - 9, 9, ".raw.info") == 0)
+                name.resize(name.size() - 5);
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".raw") == 0)
+                queue.push(dir + name);
+        }
+    }
+    ::close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    ConvertOptions opt;
+    opt.threads = std::max(1u, thread::hardware_concurrency());
+    vector<string> files;
+    string watchDir;
+    string cachePath;
+    bool useCache = false;
+    bool jobsSet = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--compression=", 0) == 0) {
+            if (!parseTiffCompression(arg.substr(14), opt.compression)) {
+                cerr << "Compression inconnue (deflate|lzw|zstd|ljpeg|none)" << endl;
+                return 1;
+            }
+            opt.compressionSet = true;
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            opt.threads = std::max(1, stoi(arg.substr(10)));
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            opt.jobs = std::max(1, stoi(arg.substr(7)));
+            jobsSet = true;
+        } else if (arg == "--dng") {
+            opt.dng = true;
+        } else if (arg == "--jpeg") {
+            opt.jpeg = true;
+        } else if (arg.rfind("--scale=", 0) == 0) {
+            opt.scale = stoul(arg.substr(8));
+            if (opt.scale != 1 && opt.scale != 2 && opt.scale != 4) {
+                cerr << "--scale doit valoir 1, 2 ou 4" << endl;
+                return 1;
+            }
+        } else if (arg.rfind("--quality=", 0) == 0) {
+            opt.quality = std::min(100, std::max(1, stoi(arg.substr(10))));
+        } else if (arg.rfind("--wb=", 0) == 0) {
+            if (sscanf(arg.c_str() + 5, "%f,%f", &opt.wbRed, &opt.wbBlue) != 2) {
+                cerr << "--wb attend deux gains: --wb=R,B" << endl;
+                return 1;
+            }
+        } else if (arg.rfind("--boost=", 0) == 0) {
+            opt.boost = stof(arg.substr(8));
+        } else if (arg.rfind("--black=", 0) == 0) {
+            opt.black = std::min(1023ul, stoul(arg.substr(8)));
+            opt.blackSet = true;
+        } else if (arg == "--cfa") {
+            opt.cfa = true;
+        } else if (arg == "--force") {
+            opt.force = true;
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            cachePath = arg.substr(8);
+            useCache = true;
+        } else if (arg == "--batch" || arg == "--watch") {
+            string dir = i + 1 < argc ? argv[++i] : ".";
+            if (dir.empty() || dir.back() != '/')
+                dir += '/';
+            if (arg == "--watch") {
+                watchDir = dir; // listé une fois la surveillance posée
+            } else {
+                vector<string> found = listRawFiles(dir);
+                files.insert(files.end(), found.begin(), found.end());
+            }
+            if (cachePath.empty())
+                cachePath = dir + ".nat_convert_done";
+            useCache = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            cerr << "Option inconnue: " << arg << endl;
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if (files.empty() && watchDir.empty()) {
+        cerr << "Usage: " << argv[0] << " [--compression=deflate|lzw|zstd|ljpeg|none] [--threads=N] [--jobs=N]"
+             << " [--boost=X] [--black=N] [--cfa] [--dng] [--jpeg] [--scale=1|2|4] [--quality=N] [--wb=R,B]"
+             << " [--cache=fichier] [--force]"
+             << " fichier.raw... | --batch dossier | --watch dossier" << endl;
+        return 1;
+    }
+
+    int watchFd = -1;
+    if (!watchDir.empty()) {
+        watchFd = openWatch(watchDir);
+        if (watchFd < 0)
+            return 1;
+        vector<string> found = listRawFiles(watchDir);
+        files.insert(files.end(), found.begin(), found.end());
+    }
+
+    ConvertCache cache;
+    if (useCache && !cache.open(cachePath)) {
+        cerr << "Impossible d'ouvrir le registre " << cachePath << endl;
+        return 1;
+    }
+    if (useCache)
+        cout << "Registre " << cachePath << " : " << cache.size() << " conversions connues" << endl;
+
+    // L'aperçu JPEG d'un fichier tient sur un cœur : un fichier par cœur par défaut
+    if (opt.jpeg && !jobsSet)
+        opt.jobs = opt.threads;
+
+    // Plusieurs fichiers à la fois : les threads de compression sont partagés entre eux
+    unsigned jobs = watchDir.empty() ? std::min<unsigned>(opt.jobs, files.size()) : opt.jobs;
+    ConvertOptions perFile = opt;
+    perFile.threads = std::max(1u, opt.threads / std::max(1u, jobs));
+
+    ConvertQueue queue;
+    for (const string &file : files)
+        queue.push(file);
+    if (watchDir.empty())
+        queue.close();
+
+    std::atomic<int> converted{0}, skipped{0}, pending{0}, failures{0};
+    auto worker = [&] {
+        string path;
+        while (queue.pop(path)) {
+            switch (convertFile(path, perFile, useCache ? &cache : nullptr)) {
+            case ConvertResult::Converted: converted++; break;
+            case ConvertResult::Skipped: skipped++; break;
+            case ConvertResult::Pending:
+                // En surveillance, l'arrivée du fichier manquant relancera la conversion
+                if (watchDir.empty()) {
+                    std::lock_guard<std::mutex> lock(outMtx);
+                    cerr << "Image incomplète (.info absent ou taille différente): " << path << endl;
+                }
+                pending++;
+                break;
+            case ConvertResult::Failed: failures++; break;
+            }
+            queue.done(path);
+        }
+    };
+    vector<thread> pool;
+    for (unsigned j = 0; j < jobs; j++)
+        pool.emplace_back(worker);
+    if (watchFd >= 0)
+        watchDirectory(watchFd, watchDir, queue);
+    queue.close();
+    for (auto &t : pool)
+        t.join();
+
+    cout << converted << " converties, " << skipped << " déjà faites, ";
+    if (watchDir.empty())
+        cout << pending << " incomplètes, ";
+    cout << failures << " échecs" << endl;
+    return failures == 0 && (!watchDir.empty() || pending == 0) ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+// à compiler avec:  g++ -o natctl natctl.cpp -std=c++17
+//
+// Client du démon de capture (sudo ./nat --daemon)
+//   ./natctl start [secondes]   démarre une session (900 s par défaut)
+//   ./natctl stop               arrête la session en cours
+//   ./natctl mode auto|fixe     reconvergence AE/AWB à chaque session ou valeurs figées
+//   ./natctl stats              débit et compteurs de la session
+//   ./natctl quit               arrête le démon
+
+#include <iostream>
+#include <string>
+
+#include "control_socket.h"
+
+int main(int argc, char *argv[])
+{
+    std::string socketPath = DEFAULT_CONTROL_SOCKET;
+    int first = 1;
+    if (argc > 1 && std::string(argv[1]).rfind("--socket=", 0) == 0) {
+        socketPath = std::string(argv[1]).substr(9);
+        first = 2;
+    }
+
+    if (argc <= first) {
+        std::cerr << "Usage: " << argv[0] << " [--socket=chemin] start [secondes] | stop | mode auto|fixe | stats | quit" << std::endl;
+        return 1;
+    }
+
+    std::string command;
+    for (int i = first; i < argc; i++) {
+        if (!command.empty())
+            command += ' ';
+        command += argv[i];
+    }
+
+    std::string reply;
+    if (!sendControlCommand(socketPath, command, reply)) {
+        std::cerr << "Erreur : démon injoignable sur " << socketPath << std::endl;
+        return 1;
+    }
+
+    std::cout << reply;
+    return reply.rfind("ERR", 0) == 0 ? 1 : 0;
+}
@@ -1,23 +1,60 @@
 // à compiler avec:  g++ -o nat native.cpp $(pkg-config --cflags --libs libcamera) -lpigpio -std=c++17
+//   aperçus en JPEG (--preview=dossier) : ajouter -DHAVE_LIBJPEG -ljpeg
+//   fronts par le noyau sans root (--trigger=gpiod) : ajouter -DHAVE_LIBGPIOD -lgpiod
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <thread>
 #include <condition_variable>
 #include <mutex>
+#include <atomic>
+#include <vector>
 #include <chrono>
 #include <sstream>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <new>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <pigpio.h>
 
 #include <libcamera/libcamera.h>
 #include <libcamera/control_ids.h>
 #include <libcamera/property_ids.h>
 
+#include "ae_awb.h"
+#include "calibration.h"
+#include "async_log.h"
+#include "camera_session.h"
+#include "capture_path.h"
+#include "control_socket.h"
+#include "durability.h"
+#include "edge_filter.h"
+#include "frame_journal.h"
+#include "frame_metrics.h"
+#include "frame_handle.h"
+#include "frame_pool.h"
+#include "pigpio_trigger.h"
+#include "pps_clock.h"
+#include "preview.h"
+#include "raw_writer.h"
+#include "session_index.h"
+#include "session_log.h"
+#include "storage_targets.h"
+#include "text_buffer.h"
+#include "thread_profile.h"
+#include "trigger_source.h"
+
+#ifdef HAVE_LIBGPIOD
+#include "gpiod_trigger.h"
+#endif
+
 #ifdef HAVE_DNG_WRITER
 #include "dng_writer.h"
 #endif
@@ -29,89 +66,240 @@ using namespace std;
 
 int clk_externe; // la clock externe donné par le GPS 
 int clk_interne; 
+static std::atomic<uint32_t> clkTick{0}; // tick interne du dernier front de la clock externe
+static PpsClock ppsClock; // secondes PPS, extrapolées si le PPS disparaît (--pps-timeout-ms=)
 int temps_total_prise_de_vue = 900; //temps total de prise de vue en secondes, NE PAS DÉBRANCHER AVANT
 
-static std::shared_ptr<Camera> camera;
-static std::mutex mtx;
-static std::condition_variable cv;
-static bool photoReady = false; // True si il y a eu une impulsion False sinon 
+static CameraSession session;
+static std::atomic<bool> photoReady{false}; // True si il y a eu une impulsion False sinon 
 static int photoCounter = 0; // compteur d'impulsion 
-int gpio_imp = 17; // GPIO pour les impulsions
-int gpio_clk = 27; // GPIO pour la clock externe
+static std::atomic<int> photosPerdues{0}; // impulsions sans requête libre
+
+// Buffers caméra prêtés sans copie aux threads d'écriture (un par cible)
+static FrameLender &lender = session.lender;
+
+// Convergence AE/AWB au démarrage, puis contrôles figés réutilisés à chaque déclenchement
+static std::mutex aeMtx;
+static std::condition_variable aeCv;
+static AeAwbConvergence aeAwb;
+static ControlList triggerControls;
+static ExposureState lockedState; // valeurs figées, sauvegardées en fin de session
+static int aeTimeoutMs = 5000; // --ae-timeout-ms=N
+static double calibMean = -1.0; // luminosité de la dernière image de calibration
+static int calibFrames = 0;
+static std::string calibPath = "/home/rpi0/calibration_ae.txt"; // --calib=chemin
+
+// Session de capture ; en mode démon (--daemon) plusieurs sessions se succèdent
+// sans réinitialiser caméra, buffers ni pigpio
+static std::atomic<bool> sessionStop{false};
+static std::atomic<bool> sessionActive{false};
+static std::atomic<bool> daemonQuit{false};
+static std::mutex sessionMtx;
+static std::condition_variable sessionCv;
+static bool sessionRequested = false;
+static int requestedDuration = 0;
+static bool reconvergeEachSession = false; // natctl mode auto|fixe
+static bool daemonMode = false; // --daemon
+static std::string socketPath = DEFAULT_CONTROL_SOCKET; // --socket=chemin
+static std::string socketGroup = DEFAULT_CONTROL_GROUP; // --socket-group=nom
+
+// Compteurs de la session en cours (natctl stats)
+static std::atomic<uint64_t> framesCompleted{0};
+static std::atomic<int64_t> sessionStartNs{0};
+
+// Durabilité des images écrites (--sync=none|file|behind, --sync-frames=N, --sync-ms=T)
+static DurabilityPolicy durabilityPolicy;
+
+// Supports d'écriture (--dest=dossier, répétable) répartis par --stripe=rr|queue,
+// chacun avec son journal (frame_journal.h) et sa durabilité
+static StorageTargets targets;
+static std::vector<std::string> destinations;
+static SessionLog sessionLog; // index de session, une copie dans le dossier de chaque cible
+static SessionIndex sessionIndex; // même index en binaire (.idx), lisible pendant la capture
+
+// Complétion et écriture de chaque image (capture_path.h), avec ses compteurs ; métriques
+// de qualité par image (--metrics-us=N, budget CPU par image, 0 = désactivées), sautées
+// quand la file d'écriture de la cible n'est pas vide
+static CapturePath capturePath(targets, sessionLog, sessionIndex);
+
+// Aperçus basse résolution pendant la capture (--preview=dossier), basse priorité
+static PreviewStage preview;
+static std::string previewDir; // vide = aperçus désactivés
+
+// Copies CPU (aperçus, compression...) : empruntées au pool, jamais allouées en capture.
+// Les emplacements du pool servent de relais quand toutes les requêtes caméra sont
+// prêtées : l'image y est recopiée et sa requête rendue pour l'impulsion suivante
+static FramePool framePool;
+static size_t poolBudgetMo = 0; // --pool-mo=N, 0 = pool désactivé
+static bool poolHugePages = false; // --thp
+static FrameLender stagingLender; // un bail mémoire par emplacement du pool
+static std::vector<PooledFrame> stagingSlots;
+
+// Chemin critique (déclenchement, complétion, écriture) : aucune allocation attendue.
+// operator new est remplacé pour compter celles faites dans une portée HotPath ;
+// le compteur est affiché par natctl stats et en fin de session.
+static thread_local bool inHotPath = false;
+static std::atomic<uint64_t> hotPathAllocs{0};
+
+struct HotPath {
+    bool outer;
+    HotPath() : outer(inHotPath) { inHotPath = true; }
+    ~HotPath() { inHotPath = outer; }
+};
+
+// Toutes les formes de new et delete passent par ces deux fonctions, hors ligne : le
+// compilateur ne voit jamais un free() appliqué au résultat d'un new
+__attribute__((noinline)) static void *countedAlloc(size_t size)
+{
+    if (inHotPath)
+        hotPathAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) static void countedFree(void *p) noexcept { free(p); }
+
+void *operator new(size_t size) { return countedAlloc(size); }
+void *operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+
+// Cœurs et priorités des threads (--threads=default|pinned, --pin=rôle:cœurs[:fifo=P|:nice=N|:idle])
+static ThreadProfile threadProfile;
+
+// Chaque thread applique son rôle lui-même ; les threads de pigpio et de libcamera
+// ne sont pas créés par nous, ils le font au premier appel de nos callbacks
+static void enterRole(ThreadRole role)
+{
+    std::string error;
+    if (!applyThreadRole(threadProfile, role, &error))
+        LOG_WARN("Profil de threads: rôle {} incomplet ({})", threadRoleName(role), error.c_str());
+}
+
+static void enterRoleOnce(ThreadRole role)
+{
+    static thread_local bool entered[static_cast<int>(ThreadRole::Count)] = {};
+    if (!entered[static_cast<int>(role)]) {
+        entered[static_cast<int>(role)] = true;
+        enterRole(role);
+    }
+}
 
+// Fronts d'impulsion (GPIO 17) et de clock externe (GPIO 27) :
+// --trigger=pigpio (défaut), gpiod (sans root) ou mock[:période_ms] (sans matériel)
+static TriggerPins triggerPins;
+static std::string triggerBackend = "pigpio";
+static std::unique_ptr<TriggerSource> trigger;
+
+// Entier positif en base 10, sans caractère en trop : une faute de frappe dans une
+// option doit afficher l'usage, pas interrompre nat sur une exception
+static bool parseUnsigned(const std::string &text, unsigned long &value)
+{
+    if (text.empty() || text[0] < '0' || text[0] > '9')
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    value = strtoul(text.c_str(), &end, 10);
+    return errno == 0 && *end == '\0';
+}
+
+static std::unique_ptr<TriggerSource> makeTrigger(const std::string &backend)
+{
+    if (backend == "pigpio")
+        return std::make_unique<PigpioTrigger>();
+#ifdef HAVE_LIBGPIOD
+    if (backend == "gpiod")
+        return std::make_unique<GpiodTrigger>();
+#endif
+    if (backend == "mock")
+        return std::make_unique<MockTrigger>();
+    unsigned long periodMs;
+    if (backend.rfind("mock:", 0) == 0 && parseUnsigned(backend.substr(5), periodMs) && periodMs <= UINT_MAX)
+        return std::make_unique<MockTrigger>(static_cast<unsigned>(periodMs));
+    return nullptr;
+}
 
 // Fonctions callback pour impulsions et horloge
-void rising_callback_clk(int gpio, int level, uint32_t tick) {
+void rising_callback_clk(int level, uint32_t tick) {
     if (level == 1){
-        clk_externe += 1;
+        clkTick = tick;
+        bool realign = ppsClock.holdover();
+        int64_t error = 0;
+        clk_externe = ppsClock.pps(tick, &error);
+        if (realign)
+            LOG_WARN("PPS retrouvé à la seconde {}, écart avec l'extrapolation {} µs", clk_externe, error);
     }
 }
 
-void rising_callback_impul(int gpio, int level, uint32_t tick) {
+void rising_callback_impul(int level, uint32_t tick) {
     if (level == 1){
         photoReady = true;
         photoCounter += 1;
     }
 }
 
-static std::string generateFilename(int index) {
-    std::ostringstream oss;
-    oss << "photo_" << std::setw(4) << std::setfill('0') << index << std::setw(4) << std::setfill('0') << to_string(clk_externe) << std::setw(12) << std::setfill('0')<< gpioTick() << ".dng";
-    return oss.str();
-}
+// Filtres anti-parasites (--filter-pulse=largeur_us,période_us, --filter-pps=largeur_us,tolérance_us)
+static EdgeFilter pulseFilter;
+static EdgeFilter clockFilter;
+static std::atomic<uint64_t> revokedTooLate{0}; // impulsion trop courte vue après le déclenchement
 
-static bool saveFrameBufferWithDNG(FrameBuffer *buffer, const std::string &filename, 
-                                    const ControlList &metadata, 
-                                    const StreamConfiguration &streamConfig) {
-    std::string filepath = "/home/rpi0/images/" + filename;
-    
-    const FrameBuffer::Plane &plane = buffer->planes()[0];
-    int fd_in = plane.fd.get();
-    size_t size = plane.length;
-    
-    // Mapping mémoire pour accéder aux données RAW
-    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd_in, 0);
-    if (data == MAP_FAILED) {
-        std::cerr << "Erreur: mmap a échoué." << std::endl;
-        return false;
-    }
-
-    std::string rawpath = filepath;
-    rawpath.replace(rawpath.length() - 4, 4, ".raw");
-    
-    int fd_out = open(rawpath.c_str(), O_WRONLY | O_CREAT, 0666);
-    if (fd_out < 0) {
-        std::cerr << "Erreur: Impossible d'ouvrir " << rawpath << std::endl;
-        munmap(data, size);
-        return false;
-    }
+// Une impulsion acceptée est encore révocable pendant au plus 2 L µs (edge_filter.h) : la
+// boucle de déclenchement attend que le filtre ait tranché, au front suivant ou au délai
+// de garde de la source. Si la décision tarde (thread des fronts en retard) au-delà de
+// PULSE_SETTLE_GRACE_US, la photo part quand même et une révocation tardive la marque
+static const int32_t PULSE_SETTLE_GRACE_US = 5000;
+static std::atomic<bool> pulseUndecided{false};
+static std::atomic<uint32_t> pulseDecisionTick{0};
 
-    if (write(fd_out, data, size) != size) {
-        std::cerr << "Erreur: Échec de l'écriture." << std::endl;
-        munmap(data, size);
-        close(fd_out);
-        return false;
-    }
+static void publishPulseState(uint32_t tick)
+{
+    pulseDecisionTick = pulseFilter.decisionTick();
+    pulseUndecided = pulseFilter.undecided(tick);
+}
 
-    munmap(data, size);
-    close(fd_out);
-
-    // Créer un fichier .info avec les métadonnées pour reconstruction ultérieure
-    std::string infopath = rawpath + ".info";
-    std::ofstream info(infopath);
-    info << "width=" << streamConfig.size.width << "\n";
-    info << "height=" << streamConfig.size.height << "\n";
-    info << "format=" << streamConfig.pixelFormat.toString() << "\n";
-    info << "stride=" << streamConfig.stride << "\n";
-    info.close();
-
-    std::cout << "  [RAW] Fichier écrit: " << rawpath 
-              << " (" << size / (1024 * 1024.0) << " MB)" << std::endl;
-    std::cout << "        Métadonnées: " << infopath << std::endl;
-    std::cout << "        Note: Convertir avec raw2dng ou le script Python fourni" << std::endl;
-    
-    return true;
+static bool pulseSettling(uint32_t now)
+{
+    return pulseUndecided && static_cast<int32_t>(now - pulseDecisionTick.load()) < PULSE_SETTLE_GRACE_US;
+}
 
+// Les fronts montants valides sont signalés sans attente ; une impulsion trop courte, révoquée
+// une fois la ligne restée basse L µs, est annulée tant que la boucle ne l'a pas prise
+static void onTriggerEdge(TriggerLine line, int level, uint32_t tick)
+{
+    enterRoleOnce(ThreadRole::Trigger);
+    if (line == TriggerLine::Clock) {
+        if (clockFilter.settle(tick) == EdgeVerdict::Revoked) {
+            clkTick = clockFilter.lastAccepted();
+            ppsClock.revokeLast();
+            clk_externe = ppsClock.lastSecond();
+        }
+        if (level == 1 && clockFilter.rising(tick) == EdgeVerdict::Accepted)
+            rising_callback_clk(level, tick);
+        else if (level == 0)
+            clockFilter.falling(tick);
+    } else {
+        if (pulseFilter.settle(tick) == EdgeVerdict::Revoked) {
+            if (photoReady.exchange(false)) {
+                photoCounter -= 1;
+            } else {
+                // Photo déjà partie : numéro gardé, image marquée (geotag la saute)
+                revokedTooLate++;
+                capturePath.revokeLate(photoCounter);
+                LOG_WARN("Impulsion {} révoquée après le déclenchement (parasite), image marquée revoked=1",
+                         photoCounter);
+            }
+        }
+        if (level == 1 && pulseFilter.rising(tick) == EdgeVerdict::Accepted) {
+            publishPulseState(tick); // encore révocable avant que photoReady ne soit vu
+            rising_callback_impul(level, tick);
+        } else if (level == 0) {
+            pulseFilter.falling(tick);
+        }
+        publishPulseState(tick);
+    }
 }
 
 // Callback modifié pour passer les métadonnées
@@ -119,187 +307,663 @@ static StreamConfiguration *globalStreamConfig = nullptr;
 
 static void requestComplete(Request *request)
 {
-    std::lock_guard<std::mutex> lock(mtx);
-    
+    enterRoleOnce(ThreadRole::Completion);
+    FrameLease *lease = lender.find(request);
+    if (!lease)
+        return;
+
     if (request->status() == Request::RequestCancelled) {
-        std::cerr << "Requête annulée" << std::endl;
+        LOG_WARN("Requête annulée");
+        lender.giveBack(lease);
         return;
     }
 
-    if (request->status() == Request::RequestComplete) {
-        const std::map<const Stream *, FrameBuffer *> &buffers = request->buffers();
-        
-        // Récupérer les métadonnées de la requête
-        const ControlList &metadata = request->metadata();
-        
-        for (auto const &bufferPair : buffers) {
-            FrameBuffer *buffer = bufferPair.second;
-            const FrameMetadata &frameMeta = buffer->metadata();
-            
-            std::cout << "\n[CALLBACK] Photo capturée (seq: " << std::setw(6) 
-                      << std::setfill('0') << frameMeta.sequence << ")";
-            
-            if (buffer->planes().empty() || buffer->planes()[0].length == 0) {
-                std::cerr << "Erreur: Buffer vide" << std::endl;
-                continue;
-            }
+    if (lease->calibration) {
+        double mean = -1.0;
+        if (globalStreamConfig)
+            mean = meanLevelCsi2p(lease->data, globalStreamConfig->size.width,
+                                  globalStreamConfig->size.height, globalStreamConfig->stride);
+        {
+            std::lock_guard<std::mutex> lock(aeMtx);
+            aeAwb.update(request->metadata());
+            calibMean = mean;
+            calibFrames++;
+        }
+        lender.giveBack(lease);
+        aeCv.notify_one();
+        return;
+    }
 
-            photoCounter++;
-            std::string filename = generateFilename(photoCounter);
+    // Pas d'écriture ici : le buffer est prêté au thread d'écriture et la requête
+    // ne redevient disponible qu'une fois la dernière poignée relâchée
+    HotPath hot;
+    const FrameMetadata &frameMeta = request->buffers().begin()->second->metadata();
+    lease->sequence = frameMeta.sequence;
+    lease->sensorTimestamp = request->metadata().get(controls::SensorTimestamp).value_or(frameMeta.timestamp);
+    framesCompleted++;
+    capturePath.complete(FrameHandle(lease), lender);
+}
 
-            if (globalStreamConfig) {
-                saveFrameBufferWithDNG(buffer, filename, metadata, *globalStreamConfig);
-            } else {
-                std::cerr << "Erreur: StreamConfig non disponible" << std::endl;
-            }
+// Fait tourner la caméra en automatique jusqu'à convergence AE/AWB (ou timeout),
+// puis fige l'exposition et la balance des blancs dans triggerControls
+static void convergeAeAwb()
+{
+    {
+        std::lock_guard<std::mutex> lock(aeMtx);
+        aeAwb = AeAwbConvergence();
+    }
+    auto start = steady_clock::now();
+    auto deadline = start + milliseconds(aeTimeoutMs);
+
+    while (steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock(aeMtx);
+            if (aeAwb.converged())
+                break;
         }
-        
-        photoReady = true;
-        cv.notify_one();
+
+        FrameLease *lease = lender.take();
+        if (lease) {
+            lease->calibration = true;
+            lease->request->controls().set(controls::AeEnable, true);
+            lease->request->controls().set(controls::AwbEnable, true);
+            if (session.camera()->queueRequest(lease->request) < 0)
+                lender.giveBack(lease);
+            continue;
+        }
+
+        // Toutes les requêtes sont en vol : attendre la prochaine image
+        std::unique_lock<std::mutex> lock(aeMtx);
+        aeCv.wait_for(lock, 50ms);
+    }
+
+    lender.waitAllReturned();
+
+    std::lock_guard<std::mutex> lock(aeMtx);
+    ExposureState state = aeAwb.state();
+    long elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    if (aeAwb.converged()) {
+        std::cout << "AE/AWB convergé en " << elapsed << " ms (" << aeAwb.frames() << " images)" << std::endl;
+    } else if (state.valid) {
+        std::cerr << "AE/AWB non convergé après " << elapsed << " ms, dernières valeurs conservées" << std::endl;
+    } else {
+        std::cerr << "AE/AWB: aucune métadonnée reçue, exposition par défaut" << std::endl;
+        state.exposureTime = 20000; // 20ms
+        state.analogueGain = 2.0f;  // Gain x2
     }
+    std::cout << "Exposition figée: " << state.exposureTime << " µs, gain " << state.analogueGain
+              << ", gains couleur R=" << state.redGain << " B=" << state.blueGain << std::endl;
+
+    lockedState = state;
+    triggerControls = buildLockedControls(state);
 }
 
-int main()
+// Démarrage à chaud : réutilise la calibration du vol précédent si une image de contrôle
+// prise avec ces valeurs a une luminosité plausible
+static bool warmStart(const ExposureState &saved)
 {
-    std::unique_ptr<CameraManager> cm = std::make_unique<CameraManager>();
-    if (cm->start()) {
-        std::cerr << "Échec du démarrage du CameraManager" << std::endl;
-        return EXIT_FAILURE;
-    }
+    auto start = steady_clock::now();
+    ControlList seeded = buildLockedControls(saved);
 
-    auto cameras = cm->cameras();
-    if (cameras.empty()) {
-        std::cout << "Aucune caméra détectée." << std::endl;
-        cm->stop();
-        return EXIT_FAILURE;
+    int before;
+    {
+        std::lock_guard<std::mutex> lock(aeMtx);
+        before = calibFrames;
     }
 
-    std::string cameraId = cameras[0]->id();
-    camera = cm->get(cameraId);
-    
-    if (!camera || camera->acquire()) {
-        std::cerr << "Échec de l'acquisition de la caméra" << std::endl;
-        cm->stop();
-        return EXIT_FAILURE;
+    FrameLease *lease = lender.take();
+    if (!lease)
+        return false;
+    lease->calibration = true;
+    lease->request->controls().merge(seeded);
+    if (session.camera()->queueRequest(lease->request) < 0) {
+        lender.giveBack(lease);
+        return false;
     }
 
-    std::unique_ptr<CameraConfiguration> config = 
-        camera->generateConfiguration({StreamRole::StillCapture});
-    
-    if (!config) {
-        std::cerr << "Échec de génération de la configuration" << std::endl;
-        camera->release();
-        cm->stop();
-        return EXIT_FAILURE;
+    bool received;
+    double mean;
+    {
+        std::unique_lock<std::mutex> lock(aeMtx);
+        received = aeCv.wait_for(lock, 1s, [before] { return calibFrames > before; });
+        mean = calibMean;
     }
+    lender.waitAllReturned();
 
-    StreamConfiguration &streamConfig = config->at(0);
-    streamConfig.size.width = 4608;
-    streamConfig.size.height = 2592;
-    
-    // FORCER LE FORMAT RAW BAYER (très important!)
-    // Pour IMX708 (Camera v3), utiliser SBGGR10_CSI2P ou SBGGR12_CSI2P
-    streamConfig.pixelFormat = formats::SBGGR10_CSI2P;  // ou SBGGR12_CSI2P
-    // Alternatives selon la caméra:
-    // formats::SRGGB10_CSI2P, formats::SGRBG10_CSI2P, formats::SGBRG10_CSI2P
+    if (!received || !plausibleLevel(mean)) {
+        std::cerr << "Calibration sauvegardée rejetée (luminosité moyenne " << mean
+                  << "), convergence complète" << std::endl;
+        return false;
+    }
 
-    config->validate();
-    std::cout << "Configuration validée: " << streamConfig.toString() << std::endl;
+    long elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    std::cout << "Calibration précédente réutilisée en " << elapsed << " ms (luminosité "
+              << mean << "): " << saved.exposureTime << " µs, gain " << saved.analogueGain << std::endl;
+    lockedState = saved;
+    triggerControls = seeded;
+    return true;
+}
 
-    if (camera->configure(config.get())) {
-        std::cerr << "Échec de configuration de la caméra" << std::endl;
-        camera->release();
-        cm->stop();
-        return EXIT_FAILURE;
+// Métadonnées de prise de vue ajoutées au .info, reprises par nat_convert --dng
+static void appendExposureInfo(TextBuffer &info)
+{
+    if (lockedState.valid) {
+        info.line("exposure_us", lockedState.exposureTime);
+        info.line("analogue_gain", lockedState.analogueGain);
+        info.line("red_gain", lockedState.redGain);
+        info.line("blue_gain", lockedState.blueGain);
     }
+}
 
-    // Sauvegarder le pointeur vers la config pour le callback
-    globalStreamConfig = &streamConfig;
+// Écriture d'une image sur la cible choisie par la répartition (capture_path.h)
+static bool writeFrame(const FrameHandle &frame, StorageTarget &target)
+{
+    HotPath hot;
+    return capturePath.write(frame, target);
+}
+
+// Prend des photos à chaque impulsion pendant `duree` secondes de clock externe
+// (ou jusqu'à sessionStop), puis attend que toutes les images soient écrites
+static void runSession(int duree)
+{
+    pulseFilter.reset();
+    clockFilter.reset();
+    revokedTooLate = 0;
+    pulseUndecided = false;
+    clk_externe = 0;
+    ppsClock.reset(trigger->tick());
+    photoCounter = 0;
+    photoReady = false;
+    photosPerdues = 0;
+    framesCompleted = 0;
+    capturePath.resetStats();
+    targets.resetStats();
+    hotPathAllocs = 0;
+    std::vector<std::string> logDirs;
+    for (const auto &target : targets.targets())
+        if (target->healthy)
+            logDirs.push_back(target->dir);
+    if (!sessionLog.open(logDirs))
+        std::cerr << "Impossible de créer l'index de session" << std::endl;
+    else if (!sessionIndex.open(sessionLog.paths(".idx")))
+        std::cerr << "Impossible de créer l'index binaire de session" << std::endl;
+    sessionStartNs = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    sessionStop = false;
+    sessionActive = true;
+
+    std::cout << "Session démarrée pour " << duree << " s" << std::endl;
+
+    // La durée suit l'horloge PPS : sans PPS elle continue sur l'heure extrapolée
+    while (!sessionStop){
+        if (ppsClock.stamp(trigger->tick()).second >= duree)
+            break;
+        if (ppsClock.holdoverJustStarted())
+            LOG_WARN("PPS perdu après la seconde {} : heure extrapolée (dérive {} ppm)", ppsClock.lastSecond(),
+                     ppsClock.driftPpm());
+        if (!pulseSettling(trigger->tick()) && photoReady.exchange(false)){
+            // Requête libre = buffer dont toutes les poignées ont été relâchées
+            FrameLease *lease = lender.take();
+            if (!lease) {
+                photosPerdues++;
+                LOG_ERROR("Erreur: aucun buffer libre, impulsion {} perdue", photoCounter);
+                continue;
+            }
+            {
+                HotPath hot;
+                lease->calibration = false;
+                lease->pulse = photoCounter;
+                lease->tick = trigger->tick();
+                PpsStamp stamp = ppsClock.stamp(lease->tick);
+                lease->clk = stamp.second;
+                lease->ppsTick = stamp.secondTick;
+                lease->holdover = stamp.holdover;
+                lease->timeErrorUs = stamp.errorUs;
+                formatFrameName(*lease);
+            }
 
-    FrameBufferAllocator *allocator = new FrameBufferAllocator(camera);
-    Stream *stream = streamConfig.stream();
+            Request *request = lease->request;
+            
+            // Exposition et balance des blancs figées à la fin de la convergence
+            // (merge et queueRequest allouent dans libcamera, hors de notre portée)
+            request->controls().merge(triggerControls);
 
-    if (allocator->allocate(stream) < 0) {
-        std::cerr << "Impossible d'allouer les buffers" << std::endl;
-        delete allocator;
-        camera->release();
-        cm->stop();
-        return EXIT_FAILURE;
-    }
+            if (session.camera()->queueRequest(request) < 0) {
+                LOG_ERROR("Erreur: Problème lors de la mise en file de la requête.");
+                lender.giveBack(lease);
+            }
+        }
+
+        usleep(1000); // Attendre 1 ms pour éviter une boucle trop rapide
 
-    camera->requestCompleted.connect(requestComplete);
-    if (camera->start()) {
-        std::cerr << "Échec du démarrage de la caméra" << std::endl;
-        delete allocator;
-        camera->release();
-        cm->stop();
-        return EXIT_FAILURE;
     }
-    
-    // Attendre que l'AE/AWB se stabilise
-    std::cout << "Attente stabilisation AE/AWB (3 secondes)..." << std::endl;
-    std::this_thread::sleep_for(std::chrono::seconds(3));
 
-    std::cout << "\n=== Caméra prête (Mode RAW 4608x2592) ===" << std::endl;
-    std::cout << "Destination: /home/rpi0/images\n" << std::endl;
+    // Toutes les images de la session sont écrites quand les requêtes sont revenues
+    lender.waitAllReturned();
+    stagingLender.waitAllReturned();
+    targets.barrier();
+    sessionLog.close();
+    sessionIndex.close();
+    sessionActive = false;
+    asyncLog().flush(); // messages de la session avant le bilan
+
+    if (lockedState.valid && !saveCalibration(calibPath, lockedState))
+        std::cerr << "Impossible de sauvegarder la calibration dans " << calibPath << std::endl;
+
+    std::cout << "Session terminée: " << capturePath.framesWritten << " images écrites, index " << sessionLog.path() << std::endl;
+    for (const auto &target : targets.targets())
+        std::cout << "  Cible " << target->id << " (" << target->dir << "): " << target->written
+                  << " images, " << target->errors << " erreurs" << (target->healthy ? "" : ", retirée")
+                  << ", retard de durabilité max " << target->durability.maxLagMs() << " ms / "
+                  << target->durability.maxLagFrames() << " images" << std::endl;
+    std::cout << "Images signalées (exposition/netteté): " << capturePath.framesFlagged
+              << ", métriques sautées: " << capturePath.metricsSkipped << std::endl;
+    if (!previewDir.empty())
+        std::cout << "Aperçus: " << preview.written() << " écrits, " << preview.skipped()
+                  << " ignorés (étage occupé), " << preview.abandoned() << " abandonnés" << std::endl;
+    if (targets.lost() > 0)
+        std::cout << "Images perdues (aucune cible disponible): " << targets.lost() << std::endl;
+    if (photosPerdues > 0)
+        std::cout << "Impulsions perdues (aucun buffer libre): " << photosPerdues << std::endl;
+    if (capturePath.framesStaged > 0)
+        std::cout << "Images recopiées dans le pool (requêtes toutes prêtées): " << capturePath.framesStaged
+                  << std::endl;
+    if (pulseFilter.stats.rejected() + clockFilter.stats.rejected() > 0)
+        std::cout << "Fronts parasites rejetés: " << pulseFilter.stats.rejected() << " impulsions ("
+                  << revokedTooLate << " après déclenchement), " << clockFilter.stats.rejected() << " PPS" << std::endl;
+    if (clockFilter.stats.gaps > 0)
+        std::cout << "PPS irréguliers (périodes manquantes): " << clockFilter.stats.gaps << std::endl;
+    if (ppsClock.holdoverEntries() > 0)
+        std::cout << "PPS perdu " << ppsClock.holdoverEntries() << " fois (heure extrapolée, images marquées holdover), "
+                  << ppsClock.realignments() << " réalignements, dernier écart " << ppsClock.lastRealignErrorUs()
+                  << " µs" << std::endl;
+    if (hotPathAllocs > 0)
+        std::cerr << "Attention: " << hotPathAllocs << " allocations sur le chemin critique" << std::endl;
+}
 
-    const std::vector<std::unique_ptr<FrameBuffer>> &buffers = allocator->buffers(stream);
+static std::string formatStats()
+{
+    double elapsed = 0.0;
+    if (sessionActive)
+        elapsed = (duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count() - sessionStartNs) / 1e9;
 
-    // Initialisation gpio et interruptions
-    if (gpioInitialise() < 0) {
-        std::cerr << "Erreur : Pigpio init failed\n";
-        return 1;
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(2)
+        << "etat=" << (sessionActive ? "active" : "inactive")
+        << " duree=" << elapsed << "s"
+        << " clk=" << clk_externe
+        << " impulsions=" << photoCounter
+        << " capturees=" << framesCompleted
+        << " ecrites=" << capturePath.framesWritten
+        << " perdues=" << photosPerdues
+        << " relais_pool=" << capturePath.framesStaged
+        << " erreurs=" << capturePath.writeErrors
+        << " file=" << targets.queued()
+        << " sans_cible=" << targets.lost()
+        << " mode=" << (reconvergeEachSession ? "auto" : "fixe");
+    oss << " signalees=" << capturePath.framesFlagged << " metriques_sautees=" << capturePath.metricsSkipped
+        << " allocations=" << hotPathAllocs << " journal_perdus=" << asyncLog().dropped();
+    oss << " fronts_rejetes=" << pulseFilter.stats.rejected() << "/pps=" << clockFilter.stats.rejected()
+        << " (periode=" << pulseFilter.stats.rejectedPeriod << "/" << clockFilter.stats.rejectedPeriod
+        << " rebond=" << pulseFilter.stats.rejectedLow << "/" << clockFilter.stats.rejectedLow
+        << " courts=" << pulseFilter.stats.revokedWidth << "/" << clockFilter.stats.revokedWidth
+        << " trop_tard=" << revokedTooLate << ") pps_manquants=" << clockFilter.stats.gaps;
+    oss << " pps=" << (ppsClock.holdover() ? "maintien" : "ok") << " maintiens=" << ppsClock.holdoverEntries()
+        << " realignements=" << ppsClock.realignments() << " derive_ppm=" << ppsClock.driftPpm();
+    if (!previewDir.empty())
+        oss << " apercus=" << preview.written() << "/ignores=" << preview.skipped()
+            << "/abandonnes=" << preview.abandoned();
+    for (const auto &target : targets.targets())
+        oss << " cible" << target->id << "=" << (target->healthy ? "ok" : "retiree")
+            << "/" << target->written << "img/" << target->bytes / (1024 * 1024.0) << "MB"
+            << "/libre=" << target->freeBytes / (1024 * 1024 * 1024.0) << "GB"
+            << "/file=" << target->depth
+            << "/non_durables=" << target->durability.pendingFrames()
+            << "/retard_sync=" << target->durability.lastLagMs() << "ms";
+    if (elapsed > 0.0)
+        oss << " debit=" << capturePath.bytesWritten / (1024 * 1024.0) / elapsed << "MB/s"
+            << " cadence=" << capturePath.framesWritten / elapsed << "img/s";
+    return oss.str();
+}
+
+static std::string handleCommand(const std::string &line)
+{
+    std::istringstream in(line);
+    std::string cmd;
+    in >> cmd;
+
+    if (cmd == "start") {
+        // Même contrôle que les options : durée entière, strictement positive, seule
+        int duree = temps_total_prise_de_vue;
+        std::string arg, extra;
+        if (in >> arg) {
+            unsigned long seconds;
+            if (!parseUnsigned(arg, seconds) || seconds == 0 || seconds > INT_MAX)
+                return "ERR durée invalide: " + arg;
+            duree = static_cast<int>(seconds);
+        }
+        if (in >> extra)
+            return "ERR argument en trop: " + extra;
+        std::lock_guard<std::mutex> lock(sessionMtx);
+        if (sessionActive || sessionRequested)
+            return "ERR session déjà en cours";
+        requestedDuration = duree;
+        sessionRequested = true;
+        sessionCv.notify_one();
+        return "OK session demandée (" + std::to_string(duree) + " s)";
+    }
+    if (cmd == "stop") {
+        if (!sessionActive)
+            return "ERR aucune session en cours";
+        sessionStop = true;
+        return "OK arrêt demandé";
+    }
+    if (cmd == "mode") {
+        std::string mode;
+        in >> mode;
+        if (mode != "auto" && mode != "fixe")
+            return "ERR mode inconnu (auto|fixe)";
+        std::lock_guard<std::mutex> lock(sessionMtx);
+        reconvergeEachSession = (mode == "auto");
+        return "OK mode " + mode;
     }
+    if (cmd == "stats")
+        return formatStats();
+    if (cmd == "quit") {
+        std::lock_guard<std::mutex> lock(sessionMtx);
+        sessionStop = true;
+        daemonQuit = true;
+        sessionCv.notify_one();
+        return "OK arrêt du démon";
+    }
+    return "ERR commande inconnue: " + cmd;
+}
 
-    std::cout << "Programme démarré, test ISR sur GPIO 17 et 27\n";
+// Garde la caméra configurée et démarrée, et attend les commandes de natctl
+static bool runDaemon()
+{
+    ControlServer server;
+    if (!server.open(socketPath, socketGroup)) {
+        std::cerr << "Erreur: impossible d'ouvrir le socket de contrôle " << socketPath << std::endl;
+        return false;
+    }
+    std::cout << "Démon prêt, socket de contrôle: " << socketPath << std::endl;
+    if (server.group().empty())
+        std::cerr << "Attention: groupe " << socketGroup << " introuvable, socket réservé à "
+                  << "l'utilisateur du démon" << std::endl;
+
+    std::thread control([&server] {
+        enterRole(ThreadRole::Background);
+        server.serve(handleCommand, daemonQuit);
+    });
+
+    while (true) {
+        int duree;
+        bool reconverge;
+        {
+            std::unique_lock<std::mutex> lock(sessionMtx);
+            sessionCv.wait(lock, [] { return sessionRequested || daemonQuit; });
+            if (daemonQuit)
+                break;
+            duree = requestedDuration;
+            reconverge = reconvergeEachSession;
+        }
+        if (reconverge)
+            convergeAeAwb();
+        runSession(duree);
+        std::lock_guard<std::mutex> lock(sessionMtx);
+        sessionRequested = false;
+    }
 
-    gpioSetMode(gpio_imp, PI_INPUT);
-    gpioSetMode(gpio_clk, PI_INPUT);
-    gpioSetPullUpDown(gpio_imp, PI_PUD_DOWN);
-    gpioSetPullUpDown(gpio_clk, PI_PUD_DOWN);
+    control.join();
+    return true;
+}
 
-    // ALERT func = en mode pollé ultra-rapide, déclenché à chaque changement
-    gpioSetAlertFunc(gpio_imp, rising_callback_impul);
-    gpioSetAlertFunc(gpio_clk, rising_callback_clk);
+static int usageError(const char *program, const std::string &arg, const char *what)
+{
+    std::cerr << what << ": " << arg << std::endl;
+    std::cerr << "Usage: " << program << " [--pool-mo=N] [--thp] [--ae-timeout-ms=N] [--calib=chemin] [--sync=none|file|behind] [--sync-frames=N] [--sync-ms=T] [--dest=dossier]... [--stripe=rr|queue] [--preview=dossier] [--metrics-us=N] [--daemon] [--socket=chemin] [--socket-group=nom] [--log=debug|info|warn|error] [--trigger=pigpio|gpiod|mock[:ms]] [--gpiochip=/dev/gpiochipN] [--filter-pulse=largeur_us,période_us|off] [--filter-pps=largeur_us,tolérance_us|off] [--pps-timeout-ms=N] [--threads=default|pinned] [--pin=rôle:cœurs[:fifo=P|:nice=N|:idle]]... [--mlock]" << std::endl;
+    return EXIT_FAILURE;
+}
 
-    while (clk_externe < temps_total_prise_de_vue){
-        if (photoReady){
-            photoReady = false;
-            std::unique_ptr<Request> request = camera->createRequest();
-            if (!request || request->addBuffer(stream, buffers[0].get()) < 0) {
-                std::cerr << "Erreur: Problème lors de la création de la requête." << std::endl;
-                continue;
+int main(int argc, char *argv[])
+{
+    EdgeFilterConfig pulseConfig, clockConfig;
+    parseEdgeFilter("20,50000", pulseConfig, false);
+    parseEdgeFilter("20,5000", clockConfig, true);
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        unsigned long number;
+        if (arg.rfind("--pool-mo=", 0) == 0) {
+            if (!parseUnsigned(arg.substr(10), number))
+                return usageError(argv[0], arg, "Valeur invalide");
+            poolBudgetMo = number;
+        } else if (arg == "--thp") {
+            poolHugePages = true;
+        } else if (arg.rfind("--ae-timeout-ms=", 0) == 0) {
+            if (!parseUnsigned(arg.substr(16), number) || number > INT_MAX)
+                return usageError(argv[0], arg, "Valeur invalide");
+            aeTimeoutMs = static_cast<int>(number);
+        } else if (arg.rfind("--calib=", 0) == 0) {
+            calibPath = arg.substr(8);
+        } else if (arg.rfind("--sync=", 0) == 0) {
+            if (!parseDurabilityMode(arg.substr(7), durabilityPolicy.mode)) {
+                std::cerr << "Mode de synchronisation inconnu (none|file|behind)" << std::endl;
+                return EXIT_FAILURE;
             }
-            
-            // Configurer l'exposition manuelle si nécessaire
-            // Décommenter ces lignes si l'image est trop sombre
-            request->controls().set(controls::ExposureTime, 20000);  // 20ms
-            request->controls().set(controls::AnalogueGain, 2.0);     // Gain x2
-
-            {
-                std::lock_guard<std::mutex> lock(mtx);
-                photoReady = false;
+        } else if (arg.rfind("--sync-frames=", 0) == 0) {
+            if (!parseUnsigned(arg.substr(14), number) || number > INT_MAX)
+                return usageError(argv[0], arg, "Valeur invalide");
+            durabilityPolicy.barrierFrames = static_cast<int>(number);
+        } else if (arg.rfind("--sync-ms=", 0) == 0) {
+            if (!parseUnsigned(arg.substr(10), number) || number > INT_MAX)
+                return usageError(argv[0], arg, "Valeur invalide");
+            durabilityPolicy.barrierMs = static_cast<int>(number);
+        } else if (arg.rfind("--dest=", 0) == 0) {
+            destinations.push_back(arg.substr(7));
+        } else if (arg.rfind("--stripe=", 0) == 0) {
+            if (!parseStripePolicy(arg.substr(9), targets.policy)) {
+                std::cerr << "Répartition inconnue (rr|queue)" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg.rfind("--metrics-us=", 0) == 0) {
+            if (!parseUnsigned(arg.substr(13), number) || number > UINT_MAX)
+                return usageError(argv[0], arg, "Valeur invalide");
+            capturePath.metricsBudgetUs = static_cast<unsigned>(number);
+        } else if (arg.rfind("--preview=", 0) == 0) {
+            previewDir = arg.substr(10);
+        } else if (arg == "--daemon") {
+            daemonMode = true;
+        } else if (arg.rfind("--socket=", 0) == 0) {
+            socketPath = arg.substr(9);
+        } else if (arg.rfind("--socket-group=", 0) == 0) {
+            socketGroup = arg.substr(15);
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            if (!loadThreadProfile(arg.substr(10), threadProfile)) {
+                std::cerr << "Profil de threads inconnu (default|pinned)" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg.rfind("--pin=", 0) == 0) {
+            if (!parseRoleOverride(arg.substr(6), threadProfile)) {
+                std::cerr << "Rôle invalide, attendu rôle:cœurs[:fifo=P|:nice=N|:idle] "
+                          << "(trigger, completion, writer, preview, background)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            threadProfile.name = "personnalisé";
+        } else if (arg == "--mlock") {
+            threadProfile.lockMemory = true;
+        } else if (arg.rfind("--trigger=", 0) == 0) {
+            triggerBackend = arg.substr(10);
+            if (!makeTrigger(triggerBackend)) {
+                std::cerr << "Source de fronts inconnue (pigpio"
+#ifdef HAVE_LIBGPIOD
+                          << "|gpiod"
+#endif
+                          << "|mock[:période_ms])" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg.rfind("--filter-pulse=", 0) == 0) {
+            if (!parseEdgeFilter(arg.substr(15), pulseConfig, false)) {
+                std::cerr << "Filtre d'impulsion invalide (largeur_us,période_us ou off)" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (arg.rfind("--filter-pps=", 0) == 0) {
+            if (!parseEdgeFilter(arg.substr(13), clockConfig, true)) {
+                std::cerr << "Filtre PPS invalide (largeur_us,tolérance_us ou off)" << std::endl;
+                return EXIT_FAILURE;
             }
+        } else if (arg.rfind("--pps-timeout-ms=", 0) == 0) {
+            if (!parseUnsigned(arg.substr(17), number) || number == 0 || number > UINT32_MAX / 1000)
+                return usageError(argv[0], arg, "Valeur invalide");
+            ppsClock.timeoutUs = static_cast<uint32_t>(number) * 1000;
+        } else if (arg.rfind("--gpiochip=", 0) == 0) {
+            triggerPins.chip = arg.substr(11);
+        } else if (arg.rfind("--log=", 0) == 0) {
+            LogLevel level;
+            if (!parseLogLevel(arg.substr(6), level)) {
+                std::cerr << "Niveau de journal inconnu (debug|info|warn|error)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            asyncLog().setLevel(level);
+        } else {
+            return usageError(argv[0], arg, "Option inconnue");
+        }
+    }
+    if (destinations.empty())
+        destinations.push_back("/home/rpi0/images");
+    pulseFilter.configure(pulseConfig);
+    clockFilter.configure(clockConfig);
 
-            camera->queueRequest(request.get());
+    // Piles réduites avant que libcamera ne crée ses threads : elles seront verrouillées
+    std::string stackError;
+    if (threadProfile.lockMemory && !limitThreadStacks(&stackError))
+        std::cerr << "Piles des threads non réduites (" << stackError << ")" << std::endl;
 
-            {
-                std::unique_lock<std::mutex> lock(mtx);
-                cv.wait(lock, [] { return photoReady; });
+    // FORCER LE FORMAT RAW BAYER (très important!)
+    // Pour IMX708 (Camera v3), utiliser SBGGR10_CSI2P ou SBGGR12_CSI2P
+    // Alternatives selon la caméra:
+    // formats::SRGGB10_CSI2P, formats::SGRBG10_CSI2P, formats::SGBRG10_CSI2P
+    if (!session.open(4608, 2592, formats::SBGGR10_CSI2P, 3))
+        return EXIT_FAILURE;
+
+    StreamConfiguration &streamConfig = session.streamConfig();
+
+    // Sauvegarder le pointeur vers la config pour le callback
+    globalStreamConfig = &streamConfig;
+    capturePath.format = rawFrameFormat(streamConfig);
+
+    // Pool de copies CPU dimensionné sur la taille réelle d'une image
+    if (poolBudgetMo > 0) {
+        if (framePool.init(streamConfig.frameSize, poolBudgetMo * 1024 * 1024, 8, poolHugePages)) {
+            std::cout << "Pool: " << framePool.count() << " images de "
+                      << framePool.slotSize() / (1024 * 1024.0) << " MB verrouillées" << std::endl;
+            stagingSlots.reserve(framePool.count());
+            while (PooledFrame slot = framePool.tryBorrow()) {
+                stagingLender.addMemory(slot.data(), slot.capacity());
+                stagingSlots.push_back(std::move(slot));
             }
         }
+    }
 
-        usleep(1000); // Attendre 1 ms pour éviter une boucle trop rapide
+    if (!session.start(requestComplete)) {
+        session.close();
+        return EXIT_FAILURE;
+    }
+    
+    // Démarrage à chaud si la calibration du vol précédent est valable,
+    // sinon attendre que l'AE/AWB se stabilise (au plus --ae-timeout-ms)
+    ExposureState saved;
+    if (!loadCalibration(calibPath, saved) || !warmStart(saved)) {
+        std::cout << "Attente convergence AE/AWB..." << std::endl;
+        convergeAeAwb();
+    }
 
+    std::cout << "\n=== Caméra prête (Mode RAW 4608x2592) ===" << std::endl;
+    for (const std::string &dest : destinations)
+        std::cout << "Destination: " << dest << std::endl;
+    std::cout << std::endl;
+
+    // Initialisation gpio et interruptions
+    trigger = makeTrigger(triggerBackend);
+    if (!trigger || !trigger->open(triggerPins)) {
+        std::cerr << "Erreur : initialisation des GPIO (" << triggerBackend << ") impossible\n";
+        session.close();
+        return 1;
     }
 
+    // Remise en état de chaque dossier après une éventuelle coupure pendant le vol précédent
+    for (const std::string &dest : destinations) {
+        if (!targets.add(dest, durabilityPolicy))
+            std::cerr << "Cible ignorée: " << dest << std::endl;
+    }
+    if (targets.size() == 0) {
+        std::cerr << "Erreur: aucune cible d'écriture utilisable" << std::endl;
+        trigger->close();
+        session.stop();
+        session.close();
+        return EXIT_FAILURE;
+    }
+    capturePath.staging = &stagingLender;
+    capturePath.appendInfo = appendExposureInfo;
+    targets.threadInit = [] { enterRole(ThreadRole::Writer); };
+    targets.onBarrier = [] {
+        sessionLog.flush();
+        sessionIndex.flush();
+    };
+    targets.start(writeFrame, streamConfig.frameSize, lender.count() + stagingLender.count());
+
+    // Balance des blancs figée reprise pour les aperçus
+    if (!previewDir.empty()) {
+        mkdir(previewDir.c_str(), 0777);
+        preview.threadInit = [] { enterRole(ThreadRole::Preview); };
+        preview.start(previewDir, streamConfig.size.width, streamConfig.size.height,
+                      streamConfig.stride, lockedState.redGain, lockedState.blueGain);
+        capturePath.preview = &preview;
+        std::cout << "Aperçus: " << previewDir << std::endl;
+    }
 
-    camera->stop();
-    camera->requestCompleted.disconnect(requestComplete);
-    delete allocator;
-    camera->release();
-    camera.reset();
-    cm->stop();
+    std::cout << "Programme démarré, fronts " << trigger->name() << " sur GPIO " << triggerPins.pulse
+              << " et " << triggerPins.clock << std::endl;
+
+    // À partir d'ici les messages des threads de capture passent par le journal asynchrone
+    asyncLog().threadInit = [] { enterRole(ThreadRole::Background); };
+    asyncLog().start();
+
+    // Délai de garde : une impulsion trop courte est révoquée sans attendre le front suivant
+    trigger->setSettleTimeout(std::max(pulseConfig.minWidthUs, clockConfig.minWidthUs));
+    if (!trigger->start(onTriggerEdge)) {
+        std::cerr << "Erreur : fronts " << trigger->name() << " indisponibles" << std::endl;
+        trigger->close();
+        targets.stop();
+        session.stop();
+        session.close();
+        return EXIT_FAILURE;
+    }
 
-    return EXIT_SUCCESS;
+    // Tous les buffers et threads existent : mémoire verrouillée, boucle de déclenchement
+    // (ce thread) sur son cœur
+    std::string lockError;
+    if (threadProfile.lockMemory && !lockProcessMemory(&lockError))
+        std::cerr << "Mémoire non verrouillée (" << lockError << ")" << std::endl;
+    std::cout << "Profil de threads: " << describeThreadProfile(threadProfile) << std::endl;
+    enterRole(ThreadRole::Trigger);
+
+    bool ok = true;
+    if (daemonMode)
+        ok = runDaemon();
+    else
+        runSession(temps_total_prise_de_vue);
+
+    trigger->close();
+    session.stop();
+
+    // Vider les files d'écriture : toutes les requêtes reviennent au prêteur
+    preview.stop();
+    targets.stop();
+    lender.waitAllReturned();
+    stagingLender.waitAllReturned();
+
+    session.close();
+    asyncLog().stop();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,71 @@
+// Source de fronts pigpio : gpioSetAlertFuncEx sur les deux lignes (comportement historique)
+//
+// pigpio échantillonne les GPIO par DMA toutes les quelques µs pendant toute la session
+// et demande root ; gpioTick() est l'horloge des fronts. Le délai de garde est le
+// watchdog de pigpio (gpioSetWatchdog, en ms : arrondi au-dessus), répété tant que la
+// ligne ne change pas.
+
+#pragma once
+
+#include <pigpio.h>
+
+#include "trigger_source.h"
+
+class PigpioTrigger : public TriggerSource {
+public:
+    ~PigpioTrigger() override { close(); }
+
+    bool open(const TriggerPins &pins) override {
+        if (gpioInitialise() < 0)
+            return false;
+        initialised_ = true;
+        pins_ = pins;
+        gpioSetMode(pins_.pulse, PI_INPUT);
+        gpioSetMode(pins_.clock, PI_INPUT);
+        gpioSetPullUpDown(pins_.pulse, PI_PUD_DOWN);
+        gpioSetPullUpDown(pins_.clock, PI_PUD_DOWN);
+        return true;
+    }
+
+    // ALERT func = en mode pollé ultra-rapide, déclenché à chaque changement
+    bool start(TriggerEdgeFn fn) override {
+        fn_ = fn;
+        if (gpioSetAlertFuncEx(pins_.pulse, alert, this) != 0 || gpioSetAlertFuncEx(pins_.clock, alert, this) != 0)
+            return false;
+        if (settleUs_) {
+            unsigned ms = (settleUs_ + 999) / 1000;
+            gpioSetWatchdog(pins_.pulse, ms);
+            gpioSetWatchdog(pins_.clock, ms);
+        }
+        return true;
+    }
+
+    void close() override {
+        if (!initialised_)
+            return;
+        gpioSetWatchdog(pins_.pulse, 0);
+        gpioSetWatchdog(pins_.clock, 0);
+        gpioSetAlertFuncEx(pins_.pulse, nullptr, nullptr);
+        gpioSetAlertFuncEx(pins_.clock, nullptr, nullptr);
+        gpioTerminate();
+        initialised_ = false;
+    }
+
+    uint32_t tick() override { return gpioTick(); }
+    const char *name() const override { return "pigpio"; }
+
+private:
+    static void alert(int gpio, int level, uint32_t tick, void *user) {
+        auto *self = static_cast<PigpioTrigger *>(user);
+        if (level == PI_TIMEOUT)
+            level = TRIGGER_TIMEOUT; // watchdog : pas de front depuis le délai de garde
+        else if (level > 1)
+            return;
+        TriggerLine line = static_cast<unsigned>(gpio) == self->pins_.clock ? TriggerLine::Clock : TriggerLine::Pulse;
+        self->fn_(line, level, tick);
+    }
+
+    TriggerPins pins_;
+    TriggerEdgeFn fn_ = nullptr;
+    bool initialised_ = false;
+};
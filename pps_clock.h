@@ -0,0 +1,227 @@
+// Horloge de session calée sur le PPS du GPS, avec maintien (holdover) si le PPS disparaît
+//
+// Chaque front PPS accepté numérote une seconde GPS (1 pour le premier front de la
+// session) et ajoute un point (seconde, tick local) à un ajustement linéaire sur les
+// PPS_FIT_POINTS derniers fronts : la pente donne la dérive du quartz local. Quand aucun
+// front n'arrive pendant timeoutUs, l'horloge passe en maintien : la seconde courante
+// et le tick de son début sont extrapolés depuis ce modèle, ce qui fait avancer la
+// durée de session, les noms de fichiers et les .info comme si le PPS était là, avec
+// une incertitude estimée qui croît avec la durée du maintien. Au retour du PPS, le
+// front reçoit la seconde la plus proche de l'extrapolation (les secondes manquées sont
+// comptées) et l'écart mesuré est rapporté.
+// Ticks en µs sur 32 bits (base de TriggerSource::tick), déroulés en 64 bits ici.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+static const int PPS_FIT_POINTS = 16;
+
+// Heure d'une image : seconde GPS, tick local de son début et qualité
+struct PpsStamp {
+    int second = 0;          // secondes GPS depuis le début de la session (clk)
+    uint32_t secondTick = 0; // tick local du début de cette seconde (pps_tick)
+    bool holdover = false;   // seconde extrapolée, PPS absent
+    uint32_t errorUs = 0;    // incertitude estimée sur l'heure
+};
+
+class PpsClock {
+public:
+    uint32_t timeoutUs = 1500000;     // PPS déclaré perdu après 1,5 s sans front
+    double holdoverPpm = 5.0;         // dérive résiduelle supposée avec un modèle ajusté
+    double freeRunPpm = 50.0;         // sans modèle (moins de 3 fronts) : quartz nominal
+
+    // Début de session : aucun front, secondes comptées au rythme nominal
+    void reset(uint32_t tick) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        state_ = State();
+        state_.lastRaw = tick;
+        state_.lastLocal = tick;
+        state_.startLocal = tick;
+        state_.intercept = tick;
+        saved_ = state_;
+        holdoverEntries_ = realignments_ = 0;
+        lastRealignErrorUs_ = 0;
+        holdoverLogged_ = false;
+    }
+
+    // Front PPS accepté : numéro de la seconde qui commence (manquées comprises)
+    int pps(uint32_t tick, int64_t *realignErrorUs = nullptr) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        saved_ = state_;
+        int64_t t = unwrap(tick);
+        // Premier front : seconde 1, sauf après un maintien sans aucun PPS (rythme nominal)
+        int second = 1;
+        if (state_.count > 0 || state_.holdover)
+            second = std::max(state_.lastSecond + 1, static_cast<int>(std::llround(secondAt(t))));
+        if (state_.holdover) {
+            // Retour du PPS : écart entre le front et le début prévu de cette seconde
+            int64_t error = t - static_cast<int64_t>(std::llround(localAt(second)));
+            lastRealignErrorUs_ = error;
+            realignments_++;
+            if (realignErrorUs)
+                *realignErrorUs = error;
+        }
+        state_.holdover = false;
+        holdoverLogged_ = false;
+        addPoint(second, t);
+        state_.lastSecond = second;
+        state_.lastPpsLocal = t;
+        state_.lastPpsRaw = tick;
+        return second;
+    }
+
+    // Annule le dernier front (impulsion trop courte, edge_filter.h)
+    void revokeLast() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        state_ = saved_;
+    }
+
+    // Heure à donner à une image prise au tick `tick` ; passe en maintien si le PPS manque
+    PpsStamp stamp(uint32_t tick) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        int64_t t = unwrap(tick);
+        PpsStamp s;
+        int64_t reference = state_.count ? state_.lastPpsLocal : state_.startLocal;
+        if (t - reference <= static_cast<int64_t>(timeoutUs)) {
+            s.second = state_.lastSecond;
+            s.secondTick = state_.count ? state_.lastPpsRaw : static_cast<uint32_t>(state_.startLocal);
+            s.errorUs = static_cast<uint32_t>(state_.count >= 3 ? state_.rmsUs : 0);
+            return s;
+        }
+        if (!state_.holdover) {
+            state_.holdover = true;
+            holdoverEntries_++;
+        }
+        s.second = std::max(state_.lastSecond, static_cast<int>(std::floor(secondAt(t))));
+        s.secondTick = static_cast<uint32_t>(static_cast<int64_t>(std::llround(localAt(s.second))));
+        s.holdover = true;
+        double elapsed = (t - reference) / 1e6;
+        double ppm = state_.count >= 3 ? holdoverPpm : freeRunPpm;
+        s.errorUs = static_cast<uint32_t>(std::min(4e9, state_.rmsUs + elapsed * ppm));
+        return s;
+    }
+
+    // Première constatation du maintien (pour ne le signaler qu'une fois)
+    bool holdoverJustStarted() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!state_.holdover || holdoverLogged_)
+            return false;
+        holdoverLogged_ = true;
+        return true;
+    }
+
+    // Dernière seconde numérotée par un front PPS
+    int lastSecond() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return state_.lastSecond;
+    }
+
+    bool holdover() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return state_.holdover;
+    }
+
+    // Dérive mesurée du quartz local, en ppm (0 sans modèle)
+    double driftPpm() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return state_.count >= 2 ? (state_.slope / 1e6 - 1.0) * 1e6 : 0.0;
+    }
+
+    uint64_t holdoverEntries() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return holdoverEntries_;
+    }
+
+    uint64_t realignments() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return realignments_;
+    }
+
+    int64_t lastRealignErrorUs() const {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return lastRealignErrorUs_;
+    }
+
+private:
+    struct State {
+        uint32_t lastRaw = 0;
+        int64_t lastLocal = 0;
+        int64_t startLocal = 0;
+        int lastSecond = 0;
+        int64_t lastPpsLocal = 0;
+        uint32_t lastPpsRaw = 0;
+        bool holdover = false;
+
+        int count = 0, next = 0;
+        int seconds[PPS_FIT_POINTS] = {};
+        int64_t locals[PPS_FIT_POINTS] = {};
+        double intercept = 0;    // tick local de la seconde 0 (début de session sans PPS)
+        double slope = 1e6;      // µs locaux par seconde GPS
+        double rmsUs = 0;        // résidu de l'ajustement
+    };
+
+    // Tick 32 bits -> µs 64 bits ; les appels de plusieurs threads peuvent arriver
+    // légèrement dans le désordre, d'où l'écart signé
+    int64_t unwrap(uint32_t raw) {
+        int32_t delta = static_cast<int32_t>(raw - state_.lastRaw);
+        int64_t local = state_.lastLocal + delta;
+        if (delta > 0) {
+            state_.lastRaw = raw;
+            state_.lastLocal = local;
+        }
+        return local;
+    }
+
+    double localAt(int second) const { return state_.intercept + state_.slope * second; }
+    double secondAt(int64_t local) const { return (local - state_.intercept) / state_.slope; }
+
+    // Moindres carrés sur les derniers fronts (centrés pour garder la précision)
+    void addPoint(int second, int64_t local) {
+        State &s = state_;
+        s.seconds[s.next] = second;
+        s.locals[s.next] = local;
+        s.next = (s.next + 1) % PPS_FIT_POINTS;
+        if (s.count < PPS_FIT_POINTS)
+            s.count++;
+
+        if (s.count == 1) {
+            s.slope = 1e6;
+            s.intercept = local - 1e6 * second;
+            s.rmsUs = 0;
+            return;
+        }
+        double mn = 0, mt = 0;
+        for (int i = 0; i < s.count; i++) {
+            mn += s.seconds[i];
+            mt += static_cast<double>(s.locals[i] - local);
+        }
+        mn /= s.count;
+        mt /= s.count;
+        double sxy = 0, sxx = 0;
+        for (int i = 0; i < s.count; i++) {
+            double dn = s.seconds[i] - mn;
+            sxy += dn * (static_cast<double>(s.locals[i] - local) - mt);
+            sxx += dn * dn;
+        }
+        s.slope = sxx > 0 ? sxy / sxx : 1e6;
+        s.intercept = local + mt - s.slope * mn;
+        double sum = 0;
+        for (int i = 0; i < s.count; i++) {
+            double r = s.locals[i] - localAt(s.seconds[i]);
+            sum += r * r;
+        }
+        s.rmsUs = std::sqrt(sum / s.count);
+    }
+
+    mutable std::mutex mtx_;
+    State state_;
+    State saved_;
+    bool holdoverLogged_ = false;
+    uint64_t holdoverEntries_ = 0;
+    uint64_t realignments_ = 0;
+    int64_t lastRealignErrorUs_ = 0;
+};
@@ -0,0 +1,217 @@
+// Aperçus basse résolution générés pendant la capture, sur les cœurs inoccupés
+//
+// Chaque aperçu est un binning 8x8 de l'image Bayer (4608x2592 -> 576x324 RGB 8 bits)
+// calculé directement depuis le mapping du buffer caméra. Le noyau de binning ne lit
+// que les 8 bits de poids fort du format CSI2P (4 premiers octets de chaque groupe de 5)
+// et additionne 2 pixels par mot de 32 bits (SWAR : deux voies de 16 bits par registre).
+//
+// L'étage est de basse priorité (SCHED_IDLE) et ne retarde jamais l'écriture :
+//   - une seule image en cours : si le thread est occupé, l'image est ignorée ;
+//   - le buffer caméra n'est jamais gardé plus longtemps que par l'écriture du .raw :
+//     entre deux bandes de lignes, si l'aperçu est le dernier détenteur, il abandonne ;
+//   - l'encodage JPEG se fait après avoir relâché le buffer, depuis l'image réduite.
+// Sans libjpeg (compiler avec -DHAVE_LIBJPEG -ljpeg), les aperçus sont écrits en PPM.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "frame_handle.h"
+#include "jpeg_writer.h"
+
+static const int PREVIEW_BIN = 8;
+
+// Accumule une bande de 8 lignes CSI2P (BGGR) dans les sommes par bloc :
+// acc[0] = B, acc[1] = G des lignes paires, acc[2] = G des lignes impaires, acc[3] = R,
+// chaque entrée contenant deux sommes de 16 bits (pixels de gauche/droite du mot)
+inline void binBandCsi2p(const uint8_t *band, unsigned stride, unsigned blocks, uint32_t *acc[4])
+{
+    for (int r = 0; r < PREVIEW_BIN; r++) {
+        const uint8_t *row = band + r * stride;
+        uint32_t *lo = acc[(r & 1) * 2];
+        uint32_t *hi = acc[(r & 1) * 2 + 1];
+        for (unsigned b = 0; b < blocks; b++) {
+            // 8 pixels = 2 groupes de 5 octets ; octets 0..3 = bits de poids fort
+            uint32_t w0, w1;
+            memcpy(&w0, row + b * 10, 4);
+            memcpy(&w1, row + b * 10 + 5, 4);
+            lo[b] += (w0 & 0x00FF00FF) + (w1 & 0x00FF00FF);
+            hi[b] += ((w0 >> 8) & 0x00FF00FF) + ((w1 >> 8) & 0x00FF00FF);
+        }
+    }
+}
+
+class PreviewStage {
+public:
+    ~PreviewStage() { stop(); }
+
+    // gainR/gainB : gains couleur figés (balance des blancs), appliqués à l'aperçu
+    bool start(const std::string &directory, unsigned width, unsigned height, unsigned stride,
+               float gainR, float gainB) {
+        dir_ = directory;
+        if (!dir_.empty() && dir_.back() != '/')
+            dir_ += '/';
+        stride_ = stride;
+        blocks_ = width / PREVIEW_BIN;
+        bands_ = height / PREVIEW_BIN;
+        gainR_ = gainR > 0.0f ? gainR : 1.0f;
+        gainB_ = gainB > 0.0f ? gainB : 1.0f;
+
+        // Toute la mémoire de l'étage est allouée ici, jamais pendant la capture
+        for (auto &a : acc_)
+            a.assign(blocks_, 0);
+        rgb_.assign(static_cast<size_t>(blocks_) * bands_ * 3, 0);
+        name_.reserve(128);
+
+        stop_ = false;
+        thread_ = std::thread([this] { run(); });
+        return true;
+    }
+
+    // Non bloquant : l'image est ignorée si l'aperçu précédent n'est pas terminé.
+    // Appelé depuis le callback de capture : le nom est copié dans name_ (réservé)
+    void submit(const FrameHandle &frame, const char *name) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (pending_ || busy_) {
+                skipped_++;
+                return;
+            }
+            pending_ = frame;
+            name_.assign(name);
+        }
+        cv_.notify_one();
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+            pending_.reset();
+        }
+        cv_.notify_one();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    uint64_t written() const { return written_.load(); }
+    uint64_t skipped() const { return skipped_.load(); }
+    uint64_t abandoned() const { return abandoned_.load(); }
+
+    // Appelé au démarrage du thread d'aperçu (cœurs, priorité : thread_profile.h)
+    std::function<void()> threadInit;
+
+private:
+    void run() {
+        // Priorité minimale : n'utilise que le temps CPU laissé libre par la capture
+        sched_param param = {};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+        if (threadInit)
+            threadInit();
+
+        std::string path;
+        path.reserve(dir_.size() + name_.capacity());
+        while (true) {
+            FrameHandle frame;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this] { return stop_ || pending_; });
+                if (stop_)
+                    return;
+                frame = std::move(pending_);
+                path.assign(dir_).append(name_);
+                busy_ = true;
+            }
+
+            bool ok = bin(frame);
+            frame.reset(); // buffer rendu avant l'encodage
+            if (ok && encode(path))
+                written_++;
+            else
+                abandoned_++;
+
+            std::lock_guard<std::mutex> lock(mtx_);
+            busy_ = false;
+        }
+    }
+
+    bool bin(const FrameHandle &frame) {
+        const uint8_t *data = frame.data();
+        uint32_t *acc[4] = {acc_[0].data(), acc_[1].data(), acc_[2].data(), acc_[3].data()};
+        for (unsigned band = 0; band < bands_; band++) {
+            // Écriture du .raw terminée : ne pas prolonger le prêt du buffer
+            if (frame.lease().refs.load(std::memory_order_acquire) <= 1)
+                return false;
+            if (static_cast<size_t>(band + 1) * PREVIEW_BIN * stride_ > frame.size())
+                return false;
+
+            for (auto &a : acc_)
+                std::fill(a.begin(), a.end(), 0);
+            binBandCsi2p(data + static_cast<size_t>(band) * PREVIEW_BIN * stride_, stride_, blocks_, acc);
+
+            // 16 pixels B et R, 32 pixels G par bloc 8x8
+            uint8_t *out = rgb_.data() + static_cast<size_t>(band) * blocks_ * 3;
+            for (unsigned b = 0; b < blocks_; b++) {
+                uint32_t sb = (acc_[0][b] & 0xFFFF) + (acc_[0][b] >> 16);
+                uint32_t sg = (acc_[1][b] & 0xFFFF) + (acc_[1][b] >> 16) +
+                              (acc_[2][b] & 0xFFFF) + (acc_[2][b] >> 16);
+                uint32_t sr = (acc_[3][b] & 0xFFFF) + (acc_[3][b] >> 16);
+                out[b * 3 + 0] = clamp8(sr / 16.0f * gainR_);
+                out[b * 3 + 1] = static_cast<uint8_t>(sg / 32);
+                out[b * 3 + 2] = clamp8(sb / 16.0f * gainB_);
+            }
+        }
+        return true;
+    }
+
+    static uint8_t clamp8(float v) { return static_cast<uint8_t>(std::min(v, 255.0f)); }
+
+    bool encode(const std::string &path) {
+        Rgb8Writer out;
+        if (!out.open(path, blocks_, bands_, 80))
+            return false;
+        bool ok = out.writeRows(rgb_.data(), bands_);
+        ok = out.close() && ok;
+        if (!ok)
+            unlink(path.c_str()); // support plein ou en erreur : pas d'aperçu tronqué
+        return ok;
+    }
+
+    std::string dir_;
+    unsigned stride_ = 0, blocks_ = 0, bands_ = 0;
+    float gainR_ = 1.0f, gainB_ = 1.0f;
+    std::vector<uint32_t> acc_[4];
+    std::vector<uint8_t> rgb_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    FrameHandle pending_;
+    std::string name_;
+    bool busy_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> skipped_{0};
+    std::atomic<uint64_t> abandoned_{0};
+};
+
+// Extension du fichier d'aperçu selon l'encodeur disponible
+inline const char *previewExtension()
+{
+    return rgb8Extension();
+}
@@ -0,0 +1,172 @@
+// Lecture au sol des paires .raw / .raw.info écrites par raw_writer.h
+//
+// Le .raw est mappé en mémoire (seules les lignes utilisées sont lues depuis le disque)
+// et dépaqueté ligne par ligne : aucun outil de conversion n'a besoin de l'image entière.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct RawInfo {
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned stride = 0;
+    std::string format;                       // ex. SBGGR10_CSI2P
+    std::map<std::string, std::string> values; // toutes les clés du .info
+
+    bool csi2p() const { return format.find("CSI2P") != std::string::npos; }
+
+    // Motif Bayer : SBGGR10_CSI2P -> BGGR
+    std::string pattern() const {
+        if (format.size() >= 5 && format[0] == 'S')
+            return format.substr(1, 4);
+        return "BGGR";
+    }
+
+    std::string get(const std::string &key, const std::string &def = std::string()) const {
+        auto it = values.find(key);
+        return it == values.end() ? def : it->second;
+    }
+};
+
+inline bool readRawInfo(const std::string &path, RawInfo &info)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    RawInfo loaded;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t eq = line.find('=');
+        if (eq != std::string::npos)
+            loaded.values[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+    try {
+        loaded.width = std::stoul(loaded.get("width", "0"));
+        loaded.height = std::stoul(loaded.get("height", "0"));
+        loaded.stride = std::stoul(loaded.get("stride", loaded.get("width", "0")));
+    } catch (const std::exception &) {
+        return false;
+    }
+    loaded.format = loaded.get("format", "UNKNOWN");
+    if (loaded.width == 0 || loaded.height == 0)
+        return false;
+    info = loaded;
+    return true;
+}
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        size_ = st.st_size;
+        void *mem = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mem == MAP_FAILED) {
+            size_ = 0;
+            return false;
+        }
+        // Lecture séquentielle : le noyau peut lire en avance agressivement
+        madvise(mem, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const uint8_t *>(mem);
+        return true;
+    }
+
+    void close() {
+        if (data_)
+            munmap(const_cast<uint8_t *>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Dépaquette une ligne 10-bit CSI2P (4 pixels dans 5 octets) vers des valeurs 10-bit
+inline void unpackCsi2pRow(const uint8_t *src, unsigned width, uint16_t *dst)
+{
+    unsigned groups = width / 4;
+    for (unsigned g = 0; g < groups; g++) {
+        const uint8_t *s = src + g * 5;
+        uint8_t low = s[4];
+        dst[0] = static_cast<uint16_t>(s[0] << 2 | (low & 0x3));
+        dst[1] = static_cast<uint16_t>(s[1] << 2 | ((low >> 2) & 0x3));
+        dst[2] = static_cast<uint16_t>(s[2] << 2 | ((low >> 4) & 0x3));
+        dst[3] = static_cast<uint16_t>(s[3] << 2 | ((low >> 6) & 0x3));
+        dst += 4;
+    }
+    const uint8_t *s = src + groups * 5;
+    for (unsigned k = 0; k < width % 4; k++)
+        dst[k] = static_cast<uint16_t>(s[k] << 2 | ((s[4] >> (2 * k)) & 0x3));
+}
+
+// Ligne y de l'image en valeurs 16-bit (10-bit << 6, comme convert.py), quel que soit le format
+inline bool readRawRow16(const RawInfo &info, const MappedFile &raw, unsigned y, uint16_t *dst)
+{
+    if (info.csi2p()) {
+        if (static_cast<size_t>(y + 1) * info.stride > raw.size())
+            return false;
+        unpackCsi2pRow(raw.data() + static_cast<size_t>(y) * info.stride, info.width, dst);
+        for (unsigned x = 0; x < info.width; x++)
+            dst[x] <<= 6;
+        return true;
+    }
+    size_t pixels = static_cast<size_t>(info.width) * info.height;
+    if (raw.size() == pixels * 2) {
+        memcpy(dst, raw.data() + static_cast<size_t>(y) * info.width * 2, info.width * 2);
+        return true;
+    }
+    if (raw.size() == pixels) {
+        const uint8_t *src = raw.data() + static_cast<size_t>(y) * info.width;
+        for (unsigned x = 0; x < info.width; x++)
+            dst[x] = static_cast<uint16_t>(src[x] << 8);
+        return true;
+    }
+    return false;
+}
+
+// Position (ligne, colonne) de R, G1, G2 et B dans un quad 2x2
+struct BayerLayout {
+    int r[2], g1[2], g2[2], b[2];
+};
+
+inline BayerLayout bayerLayout(const std::string &pattern)
+{
+    if (pattern == "RGGB")
+        return {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    if (pattern == "GRBG")
+        return {{0, 1}, {0, 0}, {1, 1}, {1, 0}};
+    if (pattern == "GBRG")
+        return {{1, 0}, {0, 0}, {1, 1}, {0, 1}};
+    return {{1, 1}, {0, 1}, {1, 0}, {0, 0}}; // BGGR
+}
@@ -0,0 +1,134 @@
+// Écriture d'une image RAW Bayer (.raw) et de ses métadonnées (.raw.info)
+//
+// Le .raw est écrit directement depuis le buffer fourni (typiquement le mapping
+// du buffer caméra). Le .info permet la reconstruction au sol (convert.py).
+// L'écriture suit le protocole journalisé de frame_journal.h : un .raw visible
+// est toujours complet.
+// Les descripteurs sont confiés au DurabilityTracker, qui décide quand les
+// données doivent atteindre le support. `extraInfo` (lignes "clé=valeur") est
+// ajouté au .info, par exemple les métriques de qualité de frame_metrics.h ; la somme de
+// contrôle calculée est rendue dans `checksumOut` (index de session).
+// Aucune allocation ni iostream par image : chemins et .info sont formatés dans des
+// tampons fixes (text_buffer.h), le format est relevé une fois par session.
+
+#pragma once
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <libcamera/libcamera.h>
+
+#include "durability.h"
+#include "frame_journal.h"
+#include "text_buffer.h"
+
+inline bool writeAll(int fd, const void *data, size_t size)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Format de l'image, relevé une fois par session (pixelFormat.toString() alloue)
+struct RawFrameFormat {
+    unsigned width = 0;
+    unsigned height = 0;
+    unsigned stride = 0;
+    char format[32] = {};
+};
+
+inline RawFrameFormat rawFrameFormat(const libcamera::StreamConfiguration &streamConfig)
+{
+    RawFrameFormat f;
+    f.width = streamConfig.size.width;
+    f.height = streamConfig.size.height;
+    f.stride = streamConfig.stride;
+    snprintf(f.format, sizeof(f.format), "%s", streamConfig.pixelFormat.toString().c_str());
+    return f;
+}
+
+// Chemin critique de la capture : aucune allocation, chemins et .info dans des tampons fixes
+inline bool writeRawFrame(const char *rawpath, const uint8_t *data, size_t size, const RawFrameFormat &format,
+                          DurabilityTracker &durability, FrameJournal &journal,
+                          const char *extraInfo = "", uint64_t *checksumOut = nullptr)
+{
+    // Étape 1 : données sous un nom temporaire, sans reste d'un ancien fichier
+    FixedText<PATH_MAX> partpath;
+    partpath.add(rawpath).add(".part");
+    if (!partpath.ok())
+        return false;
+    int fd_out = open(partpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd_out < 0) {
+        fprintf(stderr, "Erreur: Impossible d'ouvrir %s\n", partpath.c_str());
+        return false;
+    }
+
+    uint64_t checksum = frameChecksum(data, size);
+    if (checksumOut)
+        *checksumOut = checksum;
+    if (!writeAll(fd_out, data, size)) {
+        fprintf(stderr, "Erreur: Échec de l'écriture.\n");
+        close(fd_out);
+        unlink(partpath.c_str());
+        return false;
+    }
+    durability.fileWritten(fd_out);
+
+    // Étape 2 : .info avec les métadonnées pour reconstruction ultérieure
+    FixedText<PATH_MAX> infopath;
+    infopath.add(rawpath).add(".info");
+    FixedText<4096> info;
+    info.line("width", format.width);
+    info.line("height", format.height);
+    info.line("format", format.format);
+    info.line("stride", format.stride);
+    info.line("length", static_cast<unsigned long long>(size));
+    info.add("checksum=").addHex(checksum).add('\n');
+    info.add(extraInfo);
+
+    int fd_info = open(infopath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd_info < 0 || !writeAll(fd_info, info.c_str(), info.size())) {
+        fprintf(stderr, "Erreur: Impossible d'écrire %s\n", infopath.c_str());
+        if (fd_info >= 0)
+            close(fd_info);
+        durability.frameDone();
+        return false;
+    }
+    durability.fileWritten(fd_info);
+
+    // Étapes 3 et 4 : enregistrement de validation puis nom définitif
+    const char *slash = strrchr(rawpath, '/');
+    const char *name = slash ? slash + 1 : rawpath;
+    bool ok = journal.commit(name, size, checksum) &&
+              rename(partpath.c_str(), rawpath) == 0;
+    if (!ok)
+        fprintf(stderr, "Erreur: Impossible de valider %s\n", rawpath);
+    durability.frameDone();
+
+    return ok;
+}
+
+inline bool writeRawFrame(const std::string &rawpath, const uint8_t *data, size_t size,
+                          const libcamera::StreamConfiguration &streamConfig,
+                          DurabilityTracker &durability, FrameJournal &journal,
+                          const std::string &extraInfo = std::string(), uint64_t *checksumOut = nullptr)
+{
+    return writeRawFrame(rawpath.c_str(), data, size, rawFrameFormat(streamConfig), durability, journal,
+                         extraInfo.c_str(), checksumOut);
+}
@@ -0,0 +1,245 @@
+// Index binaire de session : retrouver une image par son impulsion sans lister le dossier
+//
+// "session_AAAAMMJJ_HHMMSS.idx" accompagne le CSV de session_log.h. Après un en-tête de
+// 128 octets, l'image de l'impulsion N occupe l'enregistrement N-1 (128 octets) : la
+// recherche par impulsion est un simple calcul d'offset, une impulsion perdue laisse un
+// enregistrement vide (trou du fichier). Les enregistrements sont écrits une seule fois,
+// par pwrite, dans l'ordre où les images sont validées.
+//
+// Le fichier peut être lu pendant la capture : SessionIndexReader le mappe en mémoire
+// (refresh() suit sa croissance) et n'accepte que les enregistrements dont la somme est
+// bonne, un enregistrement en cours d'écriture étant simplement ignoré.
+// Ce fichier n'utilise pas libcamera : les outils au sol peuvent l'inclure.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_journal.h"
+
+struct SessionIndexHeader {
+    uint32_t magic;       // 'NATX'
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t entrySize;
+    int64_t startTime;    // heure de début (time_t)
+    uint8_t reserved[104];
+};
+static_assert(sizeof(SessionIndexHeader) == 128, "en-tête d'index de taille fixe");
+
+struct SessionIndexEntry {
+    uint32_t magic;       // 'NATI' : enregistrement écrit
+    uint32_t pulse;
+    uint32_t clk;         // seconde PPS
+    uint32_t tick;
+    uint32_t ppsTick;
+    uint32_t sequence;
+    uint64_t sensorTimestamp;
+    uint64_t size;
+    uint64_t checksum;    // somme du .raw (frame_journal.h)
+    uint16_t target;      // cible de storage_targets.h
+    uint16_t flags;
+    uint32_t reserved;
+    char name[64];        // nom du .raw, relatif au dossier de la cible
+    uint64_t entrySum;    // somme de l'enregistrement lui-même
+};
+static_assert(sizeof(SessionIndexEntry) == 128, "enregistrement d'index de taille fixe");
+
+static const uint32_t SESSION_INDEX_MAGIC = 0x5854414E; // "NATX"
+static const uint32_t SESSION_ENTRY_MAGIC = 0x4954414E; // "NATI"
+static const uint16_t ENTRY_METRICS = 1;  // métriques calculées
+static const uint16_t ENTRY_FLAGGED = 2;  // image signalée (surexposée, floue...)
+static const uint16_t ENTRY_HOLDOVER = 4; // PPS absent : seconde extrapolée (pps_clock.h)
+static const uint16_t ENTRY_REVOKED = 8;  // impulsion parasite révoquée après le déclenchement
+
+inline uint64_t entrySum(const SessionIndexEntry &e)
+{
+    return frameChecksum(reinterpret_cast<const uint8_t *>(&e), offsetof(SessionIndexEntry, entrySum));
+}
+
+class SessionIndex {
+public:
+    ~SessionIndex() { close(); }
+
+    static constexpr int MAX_COPIES = 4;
+
+    // Une copie par chemin (à côté de chaque copie du CSV) ; vrai si au moins une a été créée
+    bool open(const std::vector<std::string> &paths) {
+        close();
+        std::lock_guard<std::mutex> lock(mtx_);
+        path_.clear();
+        SessionIndexHeader h = {};
+        h.magic = SESSION_INDEX_MAGIC;
+        h.version = 1;
+        h.headerSize = sizeof(SessionIndexHeader);
+        h.entrySize = sizeof(SessionIndexEntry);
+        h.startTime = time(nullptr);
+        for (const std::string &path : paths) {
+            if (count_ == MAX_COPIES)
+                break;
+            int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                continue;
+            if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+                ::close(fd);
+                continue;
+            }
+            if (path_.empty())
+                path_ = path;
+            fds_[count_++] = fd;
+        }
+        return count_ > 0;
+    }
+
+    // Sans verrou : chaque impulsion a son propre emplacement, et les copies ne changent
+    // qu'entre deux sessions (files d'écriture vides). Vrai si au moins une copie est à jour
+    bool record(SessionIndexEntry e) {
+        if (count_ == 0 || e.pulse == 0)
+            return false;
+        e.magic = SESSION_ENTRY_MAGIC;
+        e.name[sizeof(e.name) - 1] = '\0';
+        e.entrySum = entrySum(e);
+        off_t at = sizeof(SessionIndexHeader) + static_cast<off_t>(e.pulse - 1) * sizeof(SessionIndexEntry);
+        bool written = false;
+        for (int i = 0; i < count_; i++)
+            written |= pwrite(fds_[i], &e, sizeof(e), at) == sizeof(e);
+        return written;
+    }
+
+    // Rend les index durables (barrière d'une cible, voir SessionLog::flush)
+    void flush() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (int i = 0; i < count_; i++)
+            fdatasync(fds_[i]);
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (int i = 0; i < count_; i++) {
+            fdatasync(fds_[i]);
+            ::close(fds_[i]);
+        }
+        count_ = 0;
+    }
+
+    // Première copie
+    const std::string &path() const { return path_; }
+
+private:
+    std::mutex mtx_;
+    int fds_[MAX_COPIES];
+    int count_ = 0;
+    std::string path_;
+};
+
+class SessionIndexReader {
+public:
+    SessionIndexReader() = default;
+    SessionIndexReader(const SessionIndexReader &) = delete;
+    SessionIndexReader &operator=(const SessionIndexReader &) = delete;
+    ~SessionIndexReader() { close(); }
+
+    bool open(const std::string &path) {
+        close();
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0)
+            return false;
+        SessionIndexHeader h;
+        if (pread(fd_, &h, sizeof(h), 0) != sizeof(h) || h.magic != SESSION_INDEX_MAGIC ||
+            h.entrySize != sizeof(SessionIndexEntry) || h.headerSize != sizeof(SessionIndexHeader)) {
+            close();
+            return false;
+        }
+        header_ = h;
+        return refresh();
+    }
+
+    // Remappe le fichier s'il a grandi (capture en cours)
+    bool refresh() {
+        struct stat st;
+        if (fd_ < 0 || fstat(fd_, &st) != 0)
+            return false;
+        size_t size = static_cast<size_t>(st.st_size);
+        if (size == size_ && map_)
+            return true;
+        if (map_)
+            munmap(const_cast<uint8_t *>(map_), size_);
+        map_ = nullptr;
+        size_ = 0;
+        void *mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+        if (mem == MAP_FAILED)
+            return false;
+        map_ = static_cast<const uint8_t *>(mem);
+        size_ = size;
+        return true;
+    }
+
+    void close() {
+        if (map_)
+            munmap(const_cast<uint8_t *>(map_), size_);
+        map_ = nullptr;
+        size_ = 0;
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+    // Nombre d'emplacements (dernière impulsion écrite), trous compris
+    size_t slots() const {
+        return size_ > sizeof(SessionIndexHeader) ? (size_ - sizeof(SessionIndexHeader)) / sizeof(SessionIndexEntry) : 0;
+    }
+
+    // Temps constant ; nullptr si l'impulsion n'a pas (encore) d'image valide
+    const SessionIndexEntry *find(uint32_t pulse) const {
+        if (pulse == 0 || pulse > slots())
+            return nullptr;
+        const SessionIndexEntry *e = entries() + (pulse - 1);
+        if (e->magic != SESSION_ENTRY_MAGIC || e->pulse != pulse || e->entrySum != entrySum(*e))
+            return nullptr;
+        return e;
+    }
+
+    // Première image prise pendant la seconde PPS `clk` (ou après) : recherche dichotomique,
+    // les secondes croissant avec les impulsions ; les trous sont sautés
+    const SessionIndexEntry *findSecond(uint32_t clk) const {
+        size_t lo = 0, hi = slots();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            size_t probe = mid;
+            const SessionIndexEntry *e = nullptr;
+            while (probe < hi && !(e = find(static_cast<uint32_t>(probe + 1))))
+                probe++;
+            if (!e || e->clk >= clk)
+                hi = mid;
+            else
+                lo = probe + 1;
+        }
+        for (size_t p = lo; p < slots(); p++)
+            if (const SessionIndexEntry *e = find(static_cast<uint32_t>(p + 1)))
+                return e;
+        return nullptr;
+    }
+
+    const SessionIndexHeader &header() const { return header_; }
+
+private:
+    const SessionIndexEntry *entries() const {
+        return reinterpret_cast<const SessionIndexEntry *>(map_ + sizeof(SessionIndexHeader));
+    }
+
+    int fd_ = -1;
+    const uint8_t *map_ = nullptr;
+    size_t size_ = 0;
+    SessionIndexHeader header_ = {};
+};
@@ -0,0 +1,122 @@
+// Index de session : une ligne CSV par image écrite, avec la cible qui la contient
+//
+// Avec plusieurs supports, les images d'une même session sont réparties entre la
+// carte SD et la clé USB ; cet index permet de les retrouver (et de les réassembler
+// dans l'ordre des impulsions) sans parcourir tous les dossiers. Une copie est écrite
+// sur chaque cible.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "frame_handle.h"
+#include "frame_metrics.h"
+
+class SessionLog {
+public:
+    static constexpr int MAX_COPIES = 4;
+
+    ~SessionLog() { close(); }
+
+    // Crée "session_AAAAMMJJ_HHMMSS.csv" dans chaque dossier : une copie par cible, l'index
+    // survit à la perte d'un support. Vrai si au moins une copie a pu être créée
+    bool open(const std::vector<std::string> &directories) {
+        close();
+        char stamp[32];
+        time_t now = time(nullptr);
+        strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now));
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        path_.clear();
+        for (const std::string &directory : directories) {
+            if (count_ == MAX_COPIES)
+                break;
+            std::string dir = directory;
+            if (!dir.empty() && dir.back() != '/')
+                dir += '/';
+            Copy &copy = copies_[count_];
+            copy.path = dir + "session_" + stamp + ".csv";
+            copy.file = fopen(copy.path.c_str(), "w");
+            if (!copy.file)
+                continue;
+            setvbuf(copy.file, copy.buffer, _IOFBF, sizeof(copy.buffer)); // pas d'allocation à la première image
+            fprintf(copy.file, "impulsion,clk,tick,sequence,timestamp_capteur,cible,dossier,fichier,octets,"
+                               "metriques,luminosite,satures,sombres,nettete,alerte\n");
+            if (path_.empty())
+                path_ = copy.path;
+            count_++;
+        }
+        return count_ > 0;
+    }
+
+    void record(const FrameLease &frame, int target, const std::string &dir,
+                const char *filename, size_t size, const FrameMetrics &metrics,
+                const char *alert) {
+        char line[1024];
+        int n = snprintf(line, sizeof(line), "%d,%d,%u,%u,%llu,%d,%s,%s,%zu,", frame.pulse, frame.clk, frame.tick,
+                         frame.sequence, static_cast<unsigned long long>(frame.sensorTimestamp), target,
+                         dir.c_str(), filename, size);
+        if (n < 0 || n >= static_cast<int>(sizeof(line)))
+            return;
+        if (metrics.valid)
+            snprintf(line + n, sizeof(line) - n, "%s,%.1f,%.4f,%.4f,%.1f,%s\n",
+                     metrics.complete ? "complete" : "partielle", metrics.mean, metrics.clipped,
+                     metrics.dark, metrics.sharpness, alert);
+        else
+            snprintf(line + n, sizeof(line) - n, "sautee,,,,,\n");
+
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (int i = 0; i < count_; i++)
+            fputs(line, copies_[i].file);
+    }
+
+    // Rend l'index durable ; appelé après chaque barrière d'une cible (StorageTargets::onBarrier),
+    // y compris celles faites en cours de session par les threads d'écriture
+    void flush() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (int i = 0; i < count_; i++) {
+            if (fflush(copies_[i].file) == 0)
+                fdatasync(fileno(copies_[i].file));
+        }
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (int i = 0; i < count_; i++) {
+            fclose(copies_[i].file);
+            copies_[i].file = nullptr;
+        }
+        count_ = 0;
+    }
+
+    // Première copie (dossier de la première cible disponible)
+    const std::string &path() const { return path_; }
+
+    // Chemins de toutes les copies, extension ".csv" remplacée par `extension`
+    // (index binaire écrit à côté de chaque copie)
+    std::vector<std::string> paths(const char *extension) const {
+        std::vector<std::string> result;
+        for (int i = 0; i < count_; i++)
+            result.push_back(copies_[i].path.substr(0, copies_[i].path.size() - 4) + extension);
+        return result;
+    }
+
+private:
+    struct Copy {
+        FILE *file = nullptr;
+        std::string path;
+        char buffer[BUFSIZ];
+    };
+
+    std::mutex mtx_;
+    Copy copies_[MAX_COPIES];
+    int count_ = 0;
+    std::string path_;
+};
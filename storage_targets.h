@@ -0,0 +1,313 @@
+// Écriture sur plusieurs supports (carte SD, clé USB...) avec répartition et bascule
+//
+// Chaque cible a son propre thread d'écriture, sa file d'images prêtées, son journal
+// et sa politique de durabilité : les débits des supports s'additionnent. Les images
+// sont réparties à tour de rôle (rr) ou vers la file la moins chargée (queue).
+// Une cible pleine ou en erreur est retirée de la répartition et l'image en cours
+// est renvoyée vers une autre cible : pas de perte quand la clé se remplit en vol.
+
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/statvfs.h>
+
+#include "async_log.h"
+#include "durability.h"
+#include "frame_handle.h"
+#include "frame_journal.h"
+
+enum class StripePolicy { RoundRobin, QueueDepth };
+
+inline bool parseStripePolicy(const std::string &name, StripePolicy &policy)
+{
+    if (name == "rr")
+        policy = StripePolicy::RoundRobin;
+    else if (name == "queue")
+        policy = StripePolicy::QueueDepth;
+    else
+        return false;
+    return true;
+}
+
+// File circulaire d'images de taille fixe, allouée au démarrage : une image n'est
+// jamais dans deux files à la fois, la capacité du pool de buffers suffit
+class FrameQueue {
+public:
+    void reserve(size_t capacity) {
+        slots_.clear();
+        slots_.resize(capacity);
+        head_ = count_ = 0;
+    }
+
+    bool push(FrameHandle &&frame) {
+        if (count_ == slots_.size())
+            return false;
+        slots_[(head_ + count_) % slots_.size()] = std::move(frame);
+        count_++;
+        return true;
+    }
+
+    FrameHandle pop() {
+        FrameHandle frame = std::move(slots_[head_]);
+        head_ = (head_ + 1) % slots_.size();
+        count_--;
+        return frame;
+    }
+
+    bool empty() const { return count_ == 0; }
+
+private:
+    std::vector<FrameHandle> slots_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+};
+
+struct StorageTarget {
+    int id = 0;
+    std::string dir; // se termine par '/'
+    FrameJournal journal;
+    DurabilityTracker durability;
+
+    FrameQueue queue;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop = false;
+    std::atomic<bool> closed{false}; // thread terminé : plus aucune image acceptée
+    std::thread thread;
+
+    std::atomic<bool> healthy{true};
+    std::atomic<int> depth{0};
+    std::atomic<uint64_t> freeBytes{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> errors{0};
+    int consecutiveErrors = 0;
+};
+
+class StorageTargets {
+public:
+    // Écrit une image sur une cible ; renvoie false (errno positionné) en cas d'échec
+    using WriteFn = std::function<bool(const FrameHandle &, StorageTarget &)>;
+
+    static constexpr int MAX_CONSECUTIVE_ERRORS = 3;
+
+    ~StorageTargets() {
+        stop();
+        // Les index de session peuvent être détruits avant nous
+        for (auto &target : targets_)
+            target->durability.onBarrier = nullptr;
+    }
+
+    // Ajoute une cible : récupération après coupure, journal et durabilité
+    bool add(const std::string &directory, const DurabilityPolicy &policy) {
+        auto target = std::make_unique<StorageTarget>();
+        target->id = static_cast<int>(targets_.size());
+        target->dir = directory;
+        if (target->dir.empty() || target->dir.back() != '/')
+            target->dir += '/';
+
+        RecoveryReport recovery = FrameJournal::recover(target->dir, unsyncedFrameBound(policy));
+        std::cout << "Cible " << target->id << " (" << target->dir << ") récupération: "
+                  << recovery.verified << " images valides, " << recovery.repaired << " réparées, "
+                  << recovery.quarantined << " déplacées dans recuperation/, " << recovery.adopted
+                  << " antérieures au journal" << std::endl;
+
+        if (!target->journal.open(target->dir)) {
+            std::cerr << "Erreur: impossible d'ouvrir le journal de " << target->dir << std::endl;
+            return false;
+        }
+        target->durability.configure(policy, target->dir);
+        target->durability.setJournal(target->journal.fd());
+        // Les index de session suivent chaque barrière, pas seulement celle de fin de session
+        target->durability.onBarrier = [this] {
+            if (onBarrier)
+                onBarrier();
+        };
+        targets_.push_back(std::move(target));
+        return true;
+    }
+
+    // `capacity` : nombre d'images pouvant être prêtées en même temps (taille des files)
+    void start(WriteFn write, size_t frameSize, size_t capacity) {
+        write_ = std::move(write);
+        // Marge : une cible est "pleine" quand il ne reste plus de place pour 2 images
+        reserve_ = 2 * static_cast<uint64_t>(frameSize);
+        for (auto &target : targets_) {
+            updateFreeSpace(*target);
+            target->queue.reserve(capacity);
+            StorageTarget *t = target.get();
+            t->thread = std::thread([this, t] { run(*t); });
+        }
+    }
+
+    // Confie une image à une cible saine ; false si aucune cible n'est disponible
+    bool dispatch(FrameHandle frame, int exclude = -1) {
+        StorageTarget *target = pick(exclude);
+        if (!target) {
+            lost_++;
+            return false;
+        }
+        {
+            // Cible arrêtée entre le choix et le dépôt (bascule pendant stop()) : l'image
+            // est relâchée ici, sinon elle ne reviendrait jamais au prêteur
+            std::lock_guard<std::mutex> lock(target->mtx);
+            if (target->closed.load() || !target->queue.push(std::move(frame))) {
+                lost_++;
+                return false;
+            }
+            target->depth++;
+        }
+        target->cv.notify_one();
+        return true;
+    }
+
+    // Rend durables les images de toutes les cibles (fin de session), puis l'index
+    void barrier() {
+        for (auto &target : targets_)
+            target->durability.barrier();
+        if (onBarrier)
+            onBarrier();
+    }
+
+    // Vide les files puis arrête les threads d'écriture
+    void stop() {
+        for (auto &target : targets_) {
+            {
+                std::lock_guard<std::mutex> lock(target->mtx);
+                target->stop = true;
+            }
+            target->cv.notify_one();
+        }
+        for (auto &target : targets_) {
+            if (target->thread.joinable())
+                target->thread.join();
+        }
+    }
+
+    void resetStats() {
+        lost_ = 0;
+        for (auto &target : targets_) {
+            target->written = target->bytes = target->errors = 0;
+            target->durability.resetStats();
+        }
+    }
+
+    size_t queued() const {
+        size_t total = 0;
+        for (auto &target : targets_)
+            total += target->depth.load();
+        return total;
+    }
+
+    uint64_t lost() const { return lost_.load(); }
+    size_t size() const { return targets_.size(); }
+    StorageTarget &operator[](size_t i) { return *targets_[i]; }
+    const std::deque<std::unique_ptr<StorageTarget>> &targets() const { return targets_; }
+
+private:
+    bool usable(const StorageTarget &t) const {
+        return t.healthy.load() && t.freeBytes.load() >= reserve_;
+    }
+
+    StorageTarget *pick(int exclude) {
+        std::lock_guard<std::mutex> lock(pickMtx_);
+        StorageTarget *best = nullptr;
+        size_t n = targets_.size();
+        for (size_t k = 0; k < n; k++) {
+            StorageTarget &t = *targets_[(next_ + k) % n];
+            if (t.id == exclude || !usable(t) || t.closed.load())
+                continue;
+            if (policy == StripePolicy::RoundRobin) {
+                best = &t;
+                break;
+            }
+            if (!best || t.depth.load() < best->depth.load())
+                best = &t;
+        }
+        if (best)
+            next_ = (best->id + 1) % n;
+        return best;
+    }
+
+    void updateFreeSpace(StorageTarget &t) {
+        struct statvfs vfs;
+        if (statvfs(t.dir.c_str(), &vfs) == 0)
+            t.freeBytes = static_cast<uint64_t>(vfs.f_bavail) * vfs.f_frsize;
+        else
+            t.freeBytes = 0;
+    }
+
+    void run(StorageTarget &t) {
+        if (threadInit)
+            threadInit();
+        while (true) {
+            FrameHandle frame;
+            {
+                std::unique_lock<std::mutex> lock(t.mtx);
+                // Réveil périodique : la barrière de durabilité en temps doit passer même sans image
+                while (!t.stop && t.queue.empty()) {
+                    lock.unlock();
+                    t.durability.poll();
+                    lock.lock();
+                    t.cv.wait_for(lock, std::chrono::milliseconds(100),
+                                  [&t] { return t.stop || !t.queue.empty(); });
+                }
+                if (t.queue.empty()) {
+                    t.closed = true;
+                    lock.unlock();
+                    t.durability.barrier();
+                    return;
+                }
+                frame = t.queue.pop();
+            }
+            t.depth--;
+
+            bool ok = write_(frame, t);
+            int err = errno;
+            updateFreeSpace(t);
+            if (ok) {
+                t.written++;
+                t.bytes += frame.size();
+                t.consecutiveErrors = 0;
+                continue;
+            }
+
+            // Bascule : cible pleine ou défaillante retirée, image renvoyée ailleurs
+            t.errors++;
+            t.consecutiveErrors++;
+            if (err == ENOSPC || err == EIO || err == EROFS || !usable(t) ||
+                t.consecutiveErrors >= MAX_CONSECUTIVE_ERRORS) {
+                if (t.healthy.exchange(false))
+                    LOG_ERROR("Cible {} ({}) retirée: {}", t.id, t.dir.c_str(), strerror(err));
+            }
+            if (!dispatch(std::move(frame), t.id))
+                LOG_ERROR("Erreur: aucune cible disponible, image perdue");
+        }
+    }
+
+public:
+    StripePolicy policy = StripePolicy::RoundRobin;
+    std::function<void()> threadInit; // au démarrage de chaque thread d'écriture
+    std::function<void()> onBarrier;  // après chaque barrière d'une cible (index de session)
+
+private:
+    std::deque<std::unique_ptr<StorageTarget>> targets_;
+    WriteFn write_;
+    uint64_t reserve_ = 0;
+    std::mutex pickMtx_;
+    size_t next_ = 0;
+    std::atomic<uint64_t> lost_{0};
+};
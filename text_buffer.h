@@ -0,0 +1,121 @@
+// Texte formaté dans un tampon de taille fixe, sans allocation ni iostream
+//
+// Utilisé sur le chemin critique de la capture (noms de fichiers, chemins, .info) :
+// tout tient dans des tableaux sur la pile ou dans le bail de l'image. Un texte trop
+// long est tronqué et marqué (ok() == false) au lieu d'allouer.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+class TextBuffer {
+public:
+    TextBuffer(char *buf, size_t capacity) : buf_(buf), cap_(capacity) { clear(); }
+    TextBuffer(const TextBuffer &) = delete;
+    TextBuffer &operator=(const TextBuffer &) = delete;
+
+    void clear() {
+        len_ = 0;
+        overflow_ = false;
+        buf_[0] = '\0';
+    }
+
+    TextBuffer &add(const char *s, size_t n) {
+        size_t room = cap_ - 1 - len_;
+        if (n > room) {
+            n = room;
+            overflow_ = true;
+        }
+        memcpy(buf_ + len_, s, n);
+        len_ += n;
+        buf_[len_] = '\0';
+        return *this;
+    }
+
+    TextBuffer &add(const char *s) { return add(s, strlen(s)); }
+    TextBuffer &add(const std::string &s) { return add(s.data(), s.size()); }
+    TextBuffer &add(char c) { return add(&c, 1); }
+
+    // Entier non signé complété par des zéros à gauche jusqu'à `width` chiffres
+    TextBuffer &addUInt(uint64_t v, int width = 0) {
+        char tmp[24];
+        int n = 0;
+        do {
+            tmp[n++] = static_cast<char>('0' + v % 10);
+            v /= 10;
+        } while (v);
+        while (n < width && n < static_cast<int>(sizeof(tmp)))
+            tmp[n++] = '0';
+        char out[24];
+        for (int i = 0; i < n; i++)
+            out[i] = tmp[n - 1 - i];
+        return add(out, n);
+    }
+
+    TextBuffer &addInt(int64_t v, int width = 0) {
+        if (v < 0) {
+            add('-');
+            return addUInt(static_cast<uint64_t>(-(v + 1)) + 1, width);
+        }
+        return addUInt(static_cast<uint64_t>(v), width);
+    }
+
+    TextBuffer &addHex(uint64_t v) {
+        static const char digits[] = "0123456789abcdef";
+        char out[16];
+        int n = 0;
+        do {
+            out[15 - n++] = digits[v & 0xF];
+            v >>= 4;
+        } while (v);
+        return add(out + 16 - n, n);
+    }
+
+    // Nombre à virgule, au format %g (snprintf n'alloue pas pour ces largeurs)
+    TextBuffer &addFloat(double v) {
+        char tmp[32];
+        int n = snprintf(tmp, sizeof(tmp), "%g", v);
+        return add(tmp, n > 0 ? static_cast<size_t>(n) : 0);
+    }
+
+    // Ligne "clé=valeur\n" du .info
+    template <typename T>
+    TextBuffer &line(const char *key, T value) {
+        add(key).add('=');
+        addValue(value);
+        return add('\n');
+    }
+
+    const char *c_str() const { return buf_; }
+    size_t size() const { return len_; }
+    bool ok() const { return !overflow_; }
+
+private:
+    void addValue(const char *v) { add(v); }
+    void addValue(double v) { addFloat(v); }
+    void addValue(float v) { addFloat(v); }
+    void addValue(int v) { addInt(v); }
+    void addValue(long v) { addInt(v); }
+    void addValue(long long v) { addInt(v); }
+    void addValue(unsigned v) { addUInt(v); }
+    void addValue(unsigned long v) { addUInt(v); }
+    void addValue(unsigned long long v) { addUInt(v); }
+
+    char *buf_;
+    size_t cap_;
+    size_t len_ = 0;
+    bool overflow_ = false;
+};
+
+template <size_t N>
+class FixedText : public TextBuffer {
+public:
+    FixedText() : TextBuffer(storage_, N) {}
+
+private:
+    char storage_[N];
+};
@@ -0,0 +1,268 @@
+// Profil d'ordonnancement des threads de capture (cœurs, priorité temps réel, nice)
+//
+// Sur le Pi Zero 2 W (4 cœurs), le thread de pigpio, celui de libcamera, la boucle de
+// déclenchement et les écritures se disputent les cœurs avec le writeback du noyau.
+// Chaque rôle peut être attaché à des cœurs choisis, avec :
+//   - fifo=P : SCHED_FIFO, priorité bornée à THREAD_FIFO_MAX (sous les IRQ threadées) ;
+//   - nice=N : SCHED_OTHER avec une gentillesse (écriture, compression) ;
+//   - idle   : SCHED_IDLE (n'utilise que le temps CPU laissé libre).
+// Le profil "default" ne change rien (comportement historique), "pinned" sépare le
+// déclenchement (cœur 3) et la complétion (cœur 2) des écritures (cœurs 0-1) et
+// verrouille la mémoire (mlockall). Chaque thread applique son rôle lui-même.
+//
+// Mémoire verrouillée : sans précaution, mlockall(MCL_CURRENT | MCL_FUTURE) épinglerait la
+// pile entière de chaque thread (8 Mo, la limite de pile par défaut), soit ~100 Mo pour la
+// douzaine de threads du programme et de libcamera sur les 512 Mo du Pi Zero 2 W. Les piles
+// sont donc réduites à THREAD_STACK_SIZE (avant la création des threads) et seules les pages
+// effectivement touchées sont verrouillées (MCL_ONFAULT) ; chaque thread prétouche
+// THREAD_STACK_PREFAULT octets de pile en prenant son rôle. Empreinte : le pool de copies,
+// le tas, le code et les pages de pile utilisées, quelques Mo au-delà de --pool-mo.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+enum class ThreadRole { Trigger, Completion, Writer, Preview, Background, Count };
+
+static const int THREAD_FIFO_MAX = 49; // les IRQ threadées du noyau tournent en FIFO 50
+static const size_t THREAD_STACK_SIZE = 512 * 1024;
+static const size_t THREAD_STACK_PREFAULT = 64 * 1024;
+
+struct RoleSettings {
+    unsigned cpus = 0;       // masque de cœurs, 0 = tous
+    int policy = SCHED_OTHER;
+    int priority = 0;        // SCHED_FIFO seulement
+    int nice = 0;            // SCHED_OTHER seulement
+    bool set = false;        // false = le thread garde ce qu'il a hérité
+};
+
+struct ThreadProfile {
+    std::string name = "default";
+    RoleSettings roles[static_cast<int>(ThreadRole::Count)];
+    bool lockMemory = false;
+
+    RoleSettings &operator[](ThreadRole role) { return roles[static_cast<int>(role)]; }
+    const RoleSettings &operator[](ThreadRole role) const { return roles[static_cast<int>(role)]; }
+};
+
+inline const char *threadRoleName(ThreadRole role)
+{
+    static const char *names[] = {"trigger", "completion", "writer", "preview", "background"};
+    return names[static_cast<int>(role)];
+}
+
+inline bool parseThreadRole(const std::string &name, ThreadRole &role)
+{
+    for (int i = 0; i < static_cast<int>(ThreadRole::Count); i++) {
+        if (name == threadRoleName(static_cast<ThreadRole>(i))) {
+            role = static_cast<ThreadRole>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// "3", "0-1", "0,2" -> masque
+inline bool parseCpuList(const std::string &list, unsigned &mask)
+{
+    mask = 0;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        std::string item = list.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        int first, last;
+        char extra;
+        if (sscanf(item.c_str(), "%d-%d%c", &first, &last, &extra) == 2) {
+        } else if (sscanf(item.c_str(), "%d%c", &first, &extra) == 1) {
+            last = first;
+        } else {
+            return false;
+        }
+        if (first < 0 || last < first || last >= 32)
+            return false;
+        for (int c = first; c <= last; c++)
+            mask |= 1u << c;
+        if (end == std::string::npos)
+            break;
+        pos = end + 1;
+    }
+    return mask != 0;
+}
+
+inline bool loadThreadProfile(const std::string &name, ThreadProfile &profile)
+{
+    profile = ThreadProfile();
+    profile.name = name;
+    // Étage d'aperçus : toujours en SCHED_IDLE (preview.h)
+    profile[ThreadRole::Preview] = {0, SCHED_IDLE, 0, 0, true};
+    if (name == "default")
+        return true;
+    if (name != "pinned")
+        return false;
+    profile[ThreadRole::Trigger] = {1u << 3, SCHED_FIFO, 40, 0, true};
+    profile[ThreadRole::Completion] = {1u << 2, SCHED_FIFO, 30, 0, true};
+    profile[ThreadRole::Writer] = {0x3, SCHED_OTHER, 0, 5, true};
+    profile[ThreadRole::Preview] = {0x3, SCHED_IDLE, 0, 0, true};
+    profile[ThreadRole::Background] = {0x1, SCHED_OTHER, 0, 10, true};
+    profile.lockMemory = true;
+    return true;
+}
+
+// Surcharge d'un rôle : "rôle:cœurs[:fifo=P|:nice=N|:idle]", ex. "writer:0-1:nice=5"
+inline bool parseRoleOverride(const std::string &spec, ThreadProfile &profile)
+{
+    size_t a = spec.find(':');
+    if (a == std::string::npos)
+        return false;
+    ThreadRole role;
+    if (!parseThreadRole(spec.substr(0, a), role))
+        return false;
+    size_t b = spec.find(':', a + 1);
+    RoleSettings s;
+    std::string cpus = spec.substr(a + 1, b == std::string::npos ? std::string::npos : b - a - 1);
+    if (cpus != "*" && !parseCpuList(cpus, s.cpus))
+        return false;
+    if (b != std::string::npos) {
+        std::string sched = spec.substr(b + 1);
+        if (sched.rfind("fifo=", 0) == 0) {
+            s.policy = SCHED_FIFO;
+            char extra;
+            if (sscanf(sched.c_str() + 5, "%d%c", &s.priority, &extra) != 1)
+                return false;
+        } else if (sched.rfind("nice=", 0) == 0) {
+            char extra;
+            if (sscanf(sched.c_str() + 5, "%d%c", &s.nice, &extra) != 1)
+                return false;
+        } else if (sched == "idle") {
+            s.policy = SCHED_IDLE;
+        } else {
+            return false;
+        }
+    }
+    s.set = true;
+    profile[role] = s;
+    return true;
+}
+
+// Applique le rôle au thread appelant ; les refus (pas root, cœur absent) sont signalés
+// dans `error` et le thread continue avec l'ordonnancement par défaut
+// Touche le haut de la pile du thread : ces pages sont en RAM (et verrouillées) avant la capture
+__attribute__((noinline)) inline void prefaultStack()
+{
+    volatile char touch[THREAD_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(touch); i += 4096)
+        touch[i] = 0;
+}
+
+inline bool applyThreadRole(const ThreadProfile &profile, ThreadRole role, std::string *error = nullptr)
+{
+    if (profile.lockMemory)
+        prefaultStack();
+    const RoleSettings &s = profile[role];
+    if (!s.set)
+        return true;
+    bool ok = true;
+    auto fail = [&](const char *what) {
+        ok = false;
+        if (error)
+            *error += std::string(error->empty() ? "" : ", ") + what + ": " + strerror(errno);
+    };
+
+    if (s.cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c = 0; c < 32; c++)
+            if (s.cpus & (1u << c))
+                CPU_SET(c, &set);
+        if ((errno = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) != 0)
+            fail("affinité");
+    }
+
+    sched_param param = {};
+    if (s.policy == SCHED_FIFO)
+        param.sched_priority = std::clamp(s.priority, 1, THREAD_FIFO_MAX);
+    if ((errno = pthread_setschedparam(pthread_self(), s.policy, &param)) != 0)
+        fail(s.policy == SCHED_FIFO ? "SCHED_FIFO" : "politique");
+    if (s.policy == SCHED_OTHER &&
+        setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), s.nice) != 0)
+        fail("nice");
+    return ok;
+}
+
+// Piles des threads créés ensuite (std::thread, libcamera, journal) : à appeler avant
+// d'ouvrir la caméra quand la mémoire sera verrouillée
+inline bool limitThreadStacks(std::string *error = nullptr)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    int err = pthread_attr_setstacksize(&attr, THREAD_STACK_SIZE);
+    if (err == 0)
+        err = pthread_setattr_default_np(&attr);
+    pthread_attr_destroy(&attr);
+    if (err != 0 && error)
+        *error = std::string("pile des threads: ") + strerror(err);
+    return err == 0;
+}
+
+// Verrouille la mémoire du programme, y compris les allocations futures, page par page
+// au premier accès (MCL_ONFAULT, noyau 4.4+) : les piles ne sont pas épinglées en entier
+inline bool lockProcessMemory(std::string *error = nullptr)
+{
+#ifdef MCL_ONFAULT
+    if (mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT) == 0)
+        return true;
+    if (errno != EINVAL) {
+        if (error)
+            *error = std::string("mlockall: ") + strerror(errno);
+        return false;
+    }
+#endif
+    // Noyau plus ancien : tout est verrouillé, piles comprises (bornées par limitThreadStacks)
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0)
+        return true;
+    if (error)
+        *error = std::string("mlockall: ") + strerror(errno);
+    return false;
+}
+
+inline std::string describeThreadProfile(const ThreadProfile &profile)
+{
+    std::string out = profile.name;
+    for (int i = 0; i < static_cast<int>(ThreadRole::Count); i++) {
+        const RoleSettings &s = profile.roles[i];
+        if (!s.set)
+            continue;
+        out += std::string(" ") + threadRoleName(static_cast<ThreadRole>(i)) + "=";
+        if (s.cpus) {
+            bool first = true;
+            for (int c = 0; c < 32; c++)
+                if (s.cpus & (1u << c)) {
+                    out += (first ? "" : ",") + std::to_string(c);
+                    first = false;
+                }
+        } else {
+            out += "*";
+        }
+        if (s.policy == SCHED_FIFO)
+            out += ":fifo=" + std::to_string(std::clamp(s.priority, 1, THREAD_FIFO_MAX));
+        else if (s.policy == SCHED_IDLE)
+            out += ":idle";
+        else if (s.nice)
+            out += ":nice=" + std::to_string(s.nice);
+    }
+    if (profile.lockMemory)
+        out += " mlock";
+    return out;
+}
@@ -0,0 +1,433 @@
+// Encodeur TIFF par bandes (strips) avec compression parallèle
+//
+// Les bandes sont produites et compressées par plusieurs threads ; chaque thread
+// réserve sa place en fin de fichier sous verrou puis écrit avec pwrite, sans
+// attendre les autres : l'ordre des bandes sur le disque n'a pas d'importance,
+// seuls les offsets de l'IFD comptent. La mémoire utilisée est d'une bande
+// (brute + compressée) par thread.
+//
+// Compressions : aucune, LZW, Deflate (zlib), Zstd (-DHAVE_ZSTD -lzstd), avec
+// prédicteur horizontal, ou JPEG sans perte (DNG, lossless_jpeg.h).
+// Des tags supplémentaires peuvent être ajoutés (DNG).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "lossless_jpeg.h"
+
+enum class TiffCompression : uint16_t {
+    None = 1,
+    Lzw = 5,
+    LosslessJpeg = 7,
+    Deflate = 8,
+    Zstd = 50000,
+};
+
+inline bool parseTiffCompression(const std::string &name, TiffCompression &c)
+{
+    if (name == "none")
+        c = TiffCompression::None;
+    else if (name == "lzw")
+        c = TiffCompression::Lzw;
+    else if (name == "deflate")
+        c = TiffCompression::Deflate;
+    else if (name == "ljpeg")
+        c = TiffCompression::LosslessJpeg;
+#ifdef HAVE_ZSTD
+    else if (name == "zstd")
+        c = TiffCompression::Zstd;
+#endif
+    else
+        return false;
+    return true;
+}
+
+// Types TIFF utilisés
+enum TiffType : uint16_t {
+    TIFF_BYTE = 1,
+    TIFF_ASCII = 2,
+    TIFF_SHORT = 3,
+    TIFF_LONG = 4,
+    TIFF_RATIONAL = 5,
+    TIFF_SRATIONAL = 10,
+};
+
+// Encodeur LZW au format TIFF (codes MSB en premier, changement de largeur anticipé comme libtiff)
+class LzwEncoder {
+public:
+    void encode(const uint8_t *src, size_t size, std::vector<uint8_t> &out) {
+        out.clear();
+        out.reserve(size / 2 + 16);
+        bitBuf_ = 0;
+        bitCount_ = 0;
+        reset();
+        put(out, CLEAR);
+        if (size == 0) {
+            put(out, EOI);
+            flush(out);
+            return;
+        }
+
+        int prefix = src[0];
+        for (size_t i = 1; i < size; i++) {
+            uint8_t c = src[i];
+            uint32_t key = static_cast<uint32_t>(prefix) << 8 | c;
+            int code = find(key);
+            if (code >= 0) {
+                prefix = code;
+                continue;
+            }
+            put(out, prefix);
+            if (next_ == MAX_CODE - 1) {
+                put(out, CLEAR);
+                reset();
+            } else {
+                insert(key, next_++);
+                if (next_ > (1 << width_) - 1)
+                    width_++;
+            }
+            prefix = c;
+        }
+        put(out, prefix);
+        next_++;
+        if (next_ == MAX_CODE - 1) {
+            put(out, CLEAR);
+            width_ = 9;
+        } else if (next_ > (1 << width_) - 1) {
+            width_++;
+        }
+        put(out, EOI);
+        flush(out);
+    }
+
+private:
+    static constexpr int CLEAR = 256;
+    static constexpr int EOI = 257;
+    static constexpr int MAX_CODE = 4095;
+    static constexpr int HASH_SIZE = 9973; // premier > 2 * 4096
+
+    void reset() {
+        width_ = 9;
+        next_ = 258;
+        std::fill(std::begin(keys_), std::end(keys_), 0xFFFFFFFFu);
+    }
+
+    int find(uint32_t key) const {
+        size_t h = (key * 2654435761u) % HASH_SIZE;
+        while (keys_[h] != 0xFFFFFFFFu) {
+            if (keys_[h] == key)
+                return codes_[h];
+            h = h + 1 == HASH_SIZE ? 0 : h + 1;
+        }
+        return -1;
+    }
+
+    void insert(uint32_t key, int code) {
+        size_t h = (key * 2654435761u) % HASH_SIZE;
+        while (keys_[h] != 0xFFFFFFFFu)
+            h = h + 1 == HASH_SIZE ? 0 : h + 1;
+        keys_[h] = key;
+        codes_[h] = static_cast<uint16_t>(code);
+    }
+
+    void put(std::vector<uint8_t> &out, int code) {
+        bitBuf_ = bitBuf_ << width_ | static_cast<uint32_t>(code);
+        bitCount_ += width_;
+        while (bitCount_ >= 8) {
+            bitCount_ -= 8;
+            out.push_back(static_cast<uint8_t>(bitBuf_ >> bitCount_));
+        }
+        bitBuf_ &= (1u << bitCount_) - 1;
+    }
+
+    void flush(std::vector<uint8_t> &out) {
+        if (bitCount_ > 0)
+            out.push_back(static_cast<uint8_t>(bitBuf_ << (8 - bitCount_)));
+        bitCount_ = 0;
+    }
+
+    uint32_t keys_[HASH_SIZE];
+    uint16_t codes_[HASH_SIZE];
+    int width_ = 9;
+    int next_ = 258;
+    uint32_t bitBuf_ = 0;
+    int bitCount_ = 0;
+};
+
+class TiffWriter {
+public:
+    // Remplit les lignes [y0, y0 + rows) d'une bande, échantillons 16-bit entrelacés
+    using FillFn = std::function<bool(unsigned y0, unsigned rows, uint16_t *dst)>;
+
+    struct Image {
+        unsigned width = 0;
+        unsigned height = 0;
+        unsigned samples = 3;          // 3 = RGB, 1 = CFA / niveaux de gris
+        uint16_t photometric = 2;      // 2 = RGB, 32803 = CFA
+        unsigned rowsPerStrip = 16;
+        TiffCompression compression = TiffCompression::Deflate;
+        bool predictor = true;
+        int level = 6;                 // niveau Deflate / Zstd
+    };
+
+    TiffWriter() = default;
+    TiffWriter(const TiffWriter &) = delete;
+    TiffWriter &operator=(const TiffWriter &) = delete;
+    ~TiffWriter() { if (fd_ >= 0) ::close(fd_); }
+
+    bool open(const std::string &path, const Image &image) {
+        image_ = image;
+        if (image_.rowsPerStrip == 0 || image_.rowsPerStrip > image_.height)
+            image_.rowsPerStrip = image_.height;
+        tags_.clear();
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fd_ < 0)
+            return false;
+        end_ = 8; // en-tête écrit à la fin, une fois l'offset de l'IFD connu
+        return true;
+    }
+
+    // Tag supplémentaire (DNG, métadonnées...) ; `data` en petit-boutiste, déjà au bon type
+    void addTag(uint16_t tag, uint16_t type, uint32_t count, const void *data, size_t bytes) {
+        Tag t;
+        t.tag = tag;
+        t.type = type;
+        t.count = count;
+        t.data.assign(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + bytes);
+        tags_.push_back(std::move(t));
+    }
+    void addShort(uint16_t tag, uint16_t v) { addTag(tag, TIFF_SHORT, 1, &v, 2); }
+    void addLong(uint16_t tag, uint32_t v) { addTag(tag, TIFF_LONG, 1, &v, 4); }
+    void addAscii(uint16_t tag, const std::string &s) { addTag(tag, TIFF_ASCII, s.size() + 1, s.c_str(), s.size() + 1); }
+
+    // Produit, compresse et écrit toutes les bandes avec `threads` threads
+    bool writeStrips(const FillFn &fill, unsigned threads) {
+        unsigned strips = (image_.height + image_.rowsPerStrip - 1) / image_.rowsPerStrip;
+        offsets_.assign(strips, 0);
+        counts_.assign(strips, 0);
+        std::atomic<unsigned> nextStrip{0};
+        std::atomic<bool> failed{false};
+
+        auto worker = [&] {
+            std::vector<uint16_t> raw(static_cast<size_t>(image_.rowsPerStrip) * image_.width * image_.samples);
+            std::vector<uint8_t> packed;
+            LzwEncoder lzw;
+            LosslessJpegEncoder ljpeg;
+            while (!failed) {
+                unsigned s = nextStrip++;
+                if (s >= strips)
+                    break;
+                unsigned y0 = s * image_.rowsPerStrip;
+                unsigned rows = std::min(image_.rowsPerStrip, image_.height - y0);
+                if (!fill(y0, rows, raw.data())) {
+                    failed = true;
+                    break;
+                }
+                size_t values = static_cast<size_t>(rows) * image_.width * image_.samples;
+                if (usesPredictor())
+                    applyPredictor(raw.data(), rows);
+                if (!compress(raw.data(), rows, values, packed, lzw, ljpeg)) {
+                    failed = true;
+                    break;
+                }
+
+                off_t offset;
+                {
+                    std::lock_guard<std::mutex> lock(mtx_);
+                    offset = end_;
+                    end_ += packed.size() + (packed.size() & 1); // bandes alignées sur 2 octets
+                }
+                if (pwrite(fd_, packed.data(), packed.size(), offset) != static_cast<ssize_t>(packed.size())) {
+                    failed = true;
+                    break;
+                }
+                offsets_[s] = static_cast<uint32_t>(offset);
+                counts_[s] = static_cast<uint32_t>(packed.size());
+            }
+        };
+
+        if (threads < 1)
+            threads = 1;
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool)
+            t.join();
+        return !failed;
+    }
+
+    // Écrit l'IFD et l'en-tête, puis ferme le fichier
+    bool close() {
+        std::vector<Tag> all;
+        auto shortTag = [&](uint16_t tag, uint16_t v) { all.push_back(makeTag(tag, TIFF_SHORT, 1, &v, 2)); };
+        auto longTag = [&](uint16_t tag, uint32_t v) { all.push_back(makeTag(tag, TIFF_LONG, 1, &v, 4)); };
+
+        longTag(256, image_.width);
+        longTag(257, image_.height);
+        std::vector<uint16_t> bits(image_.samples, 16);
+        all.push_back(makeTag(258, TIFF_SHORT, bits.size(), bits.data(), bits.size() * 2));
+        shortTag(259, static_cast<uint16_t>(image_.compression));
+        shortTag(262, image_.photometric);
+        all.push_back(makeTag(273, TIFF_LONG, offsets_.size(), offsets_.data(), offsets_.size() * 4));
+        shortTag(277, static_cast<uint16_t>(image_.samples));
+        longTag(278, image_.rowsPerStrip);
+        all.push_back(makeTag(279, TIFF_LONG, counts_.size(), counts_.data(), counts_.size() * 4));
+        shortTag(284, 1);
+        if (usesPredictor())
+            shortTag(317, 2);
+        for (const Tag &t : tags_)
+            all.push_back(t);
+        std::sort(all.begin(), all.end(), [](const Tag &a, const Tag &b) { return a.tag < b.tag; });
+
+        // Valeurs de plus de 4 octets placées avant l'IFD
+        std::vector<uint8_t> block;
+        off_t base = end_;
+        std::vector<uint32_t> valueOffsets(all.size(), 0);
+        for (size_t i = 0; i < all.size(); i++) {
+            if (all[i].data.size() <= 4)
+                continue;
+            valueOffsets[i] = static_cast<uint32_t>(base + block.size());
+            block.insert(block.end(), all[i].data.begin(), all[i].data.end());
+            if (block.size() & 1)
+                block.push_back(0);
+        }
+        uint32_t ifdOffset = static_cast<uint32_t>(base + block.size());
+
+        appendLe16(block, static_cast<uint16_t>(all.size()));
+        for (size_t i = 0; i < all.size(); i++) {
+            appendLe16(block, all[i].tag);
+            appendLe16(block, all[i].type);
+            appendLe32(block, all[i].count);
+            if (all[i].data.size() <= 4) {
+                uint8_t inl[4] = {0, 0, 0, 0};
+                memcpy(inl, all[i].data.data(), all[i].data.size());
+                block.insert(block.end(), inl, inl + 4);
+            } else {
+                appendLe32(block, valueOffsets[i]);
+            }
+        }
+        appendLe32(block, 0); // pas d'IFD suivant
+
+        uint8_t header[8] = {'I', 'I', 42, 0};
+        memcpy(header + 4, &ifdOffset, 4);
+        bool ok = pwrite(fd_, block.data(), block.size(), base) == static_cast<ssize_t>(block.size()) &&
+                  pwrite(fd_, header, 8, 0) == 8;
+        ok = ::close(fd_) == 0 && ok;
+        fd_ = -1;
+        return ok;
+    }
+
+private:
+    struct Tag {
+        uint16_t tag = 0;
+        uint16_t type = 0;
+        uint32_t count = 0;
+        std::vector<uint8_t> data;
+    };
+
+    static Tag makeTag(uint16_t tag, uint16_t type, uint32_t count, const void *data, size_t bytes) {
+        Tag t;
+        t.tag = tag;
+        t.type = type;
+        t.count = count;
+        t.data.assign(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + bytes);
+        return t;
+    }
+
+    static void appendLe16(std::vector<uint8_t> &v, uint16_t x) {
+        v.push_back(x & 0xFF);
+        v.push_back(x >> 8);
+    }
+    static void appendLe32(std::vector<uint8_t> &v, uint32_t x) {
+        for (int i = 0; i < 4; i++)
+            v.push_back((x >> (8 * i)) & 0xFF);
+    }
+
+    // Le JPEG sans perte a son propre prédicteur
+    bool usesPredictor() const {
+        return image_.predictor && image_.compression != TiffCompression::None &&
+               image_.compression != TiffCompression::LosslessJpeg;
+    }
+
+    // Différences horizontales entre échantillons du même canal (modulo 2^16)
+    void applyPredictor(uint16_t *data, unsigned rows) const {
+        unsigned n = image_.width * image_.samples;
+        for (unsigned r = 0; r < rows; r++) {
+            uint16_t *row = data + static_cast<size_t>(r) * n;
+            for (unsigned i = n; i-- > image_.samples;)
+                row[i] = static_cast<uint16_t>(row[i] - row[i - image_.samples]);
+        }
+    }
+
+    bool compress(const uint16_t *values, unsigned rows, size_t count, std::vector<uint8_t> &out,
+                  LzwEncoder &lzw, LosslessJpegEncoder &ljpeg) const {
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(values);
+        size_t size = count * 2;
+        switch (image_.compression) {
+        case TiffCompression::None:
+            out.assign(src, src + size);
+            return true;
+        case TiffCompression::Lzw:
+            lzw.encode(src, size, out);
+            return true;
+        case TiffCompression::LosslessJpeg:
+            // Mosaïque (1 échantillon) : 2 composantes entrelacées de largeur W/2
+            if (image_.samples == 1) {
+                if (image_.width % 2)
+                    return false;
+                ljpeg.encode(values, image_.width / 2, rows, 2, 16, out);
+            } else {
+                ljpeg.encode(values, image_.width, rows, image_.samples, 16, out);
+            }
+            return true;
+        case TiffCompression::Deflate: {
+            uLongf len = compressBound(size);
+            out.resize(len);
+            if (compress2(out.data(), &len, src, size, image_.level) != Z_OK)
+                return false;
+            out.resize(len);
+            return true;
+        }
+        case TiffCompression::Zstd:
+#ifdef HAVE_ZSTD
+        {
+            out.resize(ZSTD_compressBound(size));
+            size_t len = ZSTD_compress(out.data(), out.size(), src, size, image_.level);
+            if (ZSTD_isError(len))
+                return false;
+            out.resize(len);
+            return true;
+        }
+#else
+            return false;
+#endif
+        }
+        return false;
+    }
+
+    Image image_;
+    int fd_ = -1;
+    std::mutex mtx_;
+    off_t end_ = 8;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> counts_;
+    std::vector<Tag> tags_;
+};
@@ -0,0 +1,138 @@
+// Source des fronts d'impulsion (GPIO 17) et de clock externe PPS (GPIO 27)
+//
+// Le programme de capture ne dépend que de cette interface : chaque changement de
+// niveau est remis au callback avec sa ligne, son niveau et son tick (µs, 32 bits
+// rebouclant comme gpioTick()). tick() lit la même horloge, pour horodater un
+// déclenchement dans la même base que les fronts. Avec setSettleTimeout(), une ligne
+// restée sans front pendant ce délai est signalée par le niveau TRIGGER_TIMEOUT : le
+// filtre anti-parasites peut alors trancher sans attendre le front suivant.
+//   - pigpio (pigpio_trigger.h) : échantillonnage DMA, root nécessaire ;
+//   - gpiod  (gpiod_trigger.h)  : périphérique caractère du noyau, fronts horodatés
+//     par le noyau, sans root (groupe gpio), compilé avec -DHAVE_LIBGPIOD -lgpiod ;
+//   - mock   (ici)              : fronts injectés ou générés, sans matériel.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <time.h>
+
+enum class TriggerLine { Pulse, Clock };
+
+// Niveau remis au callback quand la ligne n'a pas changé depuis le délai de garde
+// (comme PI_TIMEOUT de pigpio) ; le tick est l'heure de l'échéance
+static const int TRIGGER_TIMEOUT = 2;
+
+using TriggerEdgeFn = void (*)(TriggerLine line, int level, uint32_t tick);
+
+struct TriggerPins {
+    unsigned pulse = 17;
+    unsigned clock = 27;
+    std::string chip = "/dev/gpiochip0"; // gpiod seulement
+};
+
+class TriggerSource {
+public:
+    virtual ~TriggerSource() = default;
+
+    // Prépare les lignes (entrées, tirage vers le bas) sans encore remettre de front
+    virtual bool open(const TriggerPins &pins) = 0;
+    // Les fronts arrivent sur un thread de la source à partir d'ici
+    virtual bool start(TriggerEdgeFn fn) = 0;
+    virtual void close() = 0;
+
+    virtual uint32_t tick() = 0;
+    virtual const char *name() const = 0;
+
+    // Délai de garde en µs (0 = aucun), à fixer avant start()
+    void setSettleTimeout(uint32_t us) { settleUs_ = us; }
+
+protected:
+    uint32_t settleUs_ = 0;
+};
+
+// Horloge monotone en µs sur 32 bits (base des sources gpiod et mock)
+inline uint32_t monotonicTickUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint32_t>(static_cast<uint64_t>(ts.tv_sec) * 1000000u + ts.tv_nsec / 1000);
+}
+
+// Source simulée : fronts injectés un par un (inject), ou générés par un thread
+// (impulsions toutes les pulsePeriodMs, PPS toutes les secondes, largeur widthUs) ;
+// le délai de garde suit chaque front généré si le front suivant vient plus tard
+class MockTrigger : public TriggerSource {
+public:
+    explicit MockTrigger(unsigned pulsePeriodMs = 0, unsigned widthUs = 1000)
+        : pulsePeriodMs_(pulsePeriodMs), widthUs_(widthUs) {}
+    ~MockTrigger() override { close(); }
+
+    bool open(const TriggerPins &) override { return true; }
+
+    bool start(TriggerEdgeFn fn) override {
+        fn_ = fn;
+        if (pulsePeriodMs_ == 0)
+            return true;
+        stop_ = false;
+        thread_ = std::thread([this] { run(); });
+        return true;
+    }
+
+    void close() override {
+        stop_ = true;
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    // Front donné tel quel au callback, sur le thread appelant
+    void inject(TriggerLine line, int level, uint32_t tick) {
+        if (fn_)
+            fn_(line, level, tick);
+    }
+
+    uint32_t tick() override { return monotonicTickUs(); }
+    const char *name() const override { return "mock"; }
+
+private:
+    void run() {
+        using namespace std::chrono;
+        auto origin = steady_clock::now();
+        uint64_t nextPulseUs = pulsePeriodMs_ * 1000ull, nextClockUs = 1000000;
+        while (!stop_) {
+            uint64_t nextUs = std::min(nextPulseUs, nextClockUs);
+            std::this_thread::sleep_until(origin + microseconds(nextUs));
+            if (stop_)
+                break;
+            TriggerLine line = nextUs == nextClockUs ? TriggerLine::Clock : TriggerLine::Pulse;
+            inject(line, 1, tick());
+            if (settleUs_ && settleUs_ < widthUs_) {
+                std::this_thread::sleep_for(microseconds(settleUs_));
+                inject(line, TRIGGER_TIMEOUT, tick());
+                std::this_thread::sleep_for(microseconds(widthUs_ - settleUs_));
+            } else {
+                std::this_thread::sleep_for(microseconds(widthUs_));
+            }
+            inject(line, 0, tick());
+            if (settleUs_) {
+                std::this_thread::sleep_for(microseconds(settleUs_));
+                inject(line, TRIGGER_TIMEOUT, tick());
+            }
+            if (line == TriggerLine::Clock)
+                nextClockUs += 1000000;
+            else
+                nextPulseUs += pulsePeriodMs_ * 1000ull;
+        }
+    }
+
+    unsigned pulsePeriodMs_;
+    unsigned widthUs_;
+    TriggerEdgeFn fn_ = nullptr;
+    std::atomic<bool> stop_{false};
+    std::thread thread_;
+};